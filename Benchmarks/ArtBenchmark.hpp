@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "ArtIndex.hpp"
+#include "BPTree.hpp"
+
+using std::vector;
+using std::string;
+
+/**
+ * @brief The adaptive radix tree index against the B+ tree on a sequential and a random key set: the time to insert
+ * every key, to look every key up in a random order and to read ranges of RANGE_KEYS keys
+*/
+class ArtBenchmark
+{
+private:
+	ArtBenchmark();
+
+	static const int RANGE_KEYS = 1000;
+	static const int RANGES = 1000;
+
+	/**
+	 * @return how many milliseconds the function runs
+	*/
+	static double measure(const std::function<void()>& function)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		function();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/**
+	 * @brief Measure both indexes on one key set and print a line per operation
+	 * @param name - name of the key set
+	 * @param keys - distinct keys in the order they are inserted
+	*/
+	static void compare(const string& name, const vector<int>& keys)
+	{
+		std::mt19937 random(7);
+		vector<int> lookups(keys);
+		std::shuffle(lookups.begin(), lookups.end(), random);
+		vector<int> sorted(keys);
+		std::sort(sorted.begin(), sorted.end());
+		vector<size_t> ranges;
+		std::uniform_int_distribution<size_t> pick(0, sorted.size() - RANGE_KEYS);
+		for (int i = 0; i < RANGES; i++)
+			ranges.push_back(pick(random));
+
+		ArtIndex art;
+		BPTree tree;
+		size_t artFound = 0, treeFound = 0, artRead = 0, treeRead = 0;
+		RecordPtr ptr;
+		double artInsert = measure([&]() { for (int key : keys) art.insert(TypeWrapper(key), RecordPtr(key, 0)); });
+		double treeInsert = measure([&]() { for (int key : keys) tree.insert({ TypeWrapper(key), RecordPtr(key, 0) }); });
+		double artFind = measure([&]() { for (int key : lookups) artFound += art.find(TypeWrapper(key), ptr); });
+		double treeFind = measure([&]() { for (int key : lookups) treeFound += tree.find(TypeWrapper(key), ptr); });
+		double artRange = measure([&]()
+			{
+				for (size_t first : ranges)
+				{
+					TypeWrapper lower(sorted[first]), upper(sorted[first + RANGE_KEYS - 1]);
+					artRead += art.getRecordPtrsInRange(&lower, true, &upper, true).size();
+				}
+			});
+		double treeRange = measure([&]()
+			{
+				for (size_t first : ranges)
+				{
+					TypeWrapper lower(sorted[first]), upper(sorted[first + RANGE_KEYS - 1]);
+					treeRead += tree.getRecordPtrsInRange(&lower, true, &upper, true).size();
+				}
+			});
+
+		if (artFound != keys.size() || treeFound != keys.size() || artRead != treeRead)
+			std::cerr << "The indexes don't agree on the " << name << " keys" << std::endl;
+
+		std::cout << name << " keys (" << keys.size() << ") | ART ms | B+ tree ms" << std::endl;
+		std::cout << "insert | " << artInsert << " | " << treeInsert << std::endl;
+		std::cout << "find | " << artFind << " | " << treeFind << std::endl;
+		std::cout << RANGES << " ranges of " << RANGE_KEYS << " keys | " << artRange << " | " << treeRange << std::endl;
+	}
+
+public:
+	/**
+	 * @brief Compare the indexes on the keys 0 ... count - 1 inserted in order and on count random keys inserted in a random order
+	 * @param count - number of keys, at least RANGE_KEYS
+	*/
+	static void run(int count)
+	{
+		vector<int> sequential(count);
+		std::iota(sequential.begin(), sequential.end(), 0);
+		compare("sequential", sequential);
+
+		std::mt19937 random(42);
+		vector<int> scattered(count);
+		for (int& key : scattered)
+			key = (int)random();
+
+		std::sort(scattered.begin(), scattered.end());
+		scattered.erase(std::unique(scattered.begin(), scattered.end()), scattered.end());
+		std::shuffle(scattered.begin(), scattered.end(), random);
+		compare("random", scattered);
+	}
+};
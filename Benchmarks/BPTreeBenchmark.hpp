@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "BPTree.hpp"
+
+using std::vector;
+
+/**
+ * @brief Read scalability of the B+ tree: reader threads look up random keys of a filled tree for a fixed time,
+ * once alone and once next to a thread inserting new keys all the time, for 1, 2, 4 ... readers
+*/
+class BPTreeBenchmark
+{
+private:
+	BPTreeBenchmark();
+
+	typedef std::chrono::steady_clock Clock;
+
+	/**
+	 * @brief Run the readers (and the inserter) for the given time
+	 * @param tree - tree holding the keys [0, keys)
+	 * @param keys - number of keys the readers look up
+	 * @param readers - number of reader threads
+	 * @param nextKey - the next key the inserter adds, nullptr for no inserter
+	 * @param duration - how long the threads run
+	 * @param inserted - set to the number of keys the inserter added
+	 * @return the number of lookups done by all readers
+	*/
+	static size_t measure(BPTree& tree, int keys, size_t readers, std::atomic<int>* nextKey, std::chrono::milliseconds duration, size_t& inserted)
+	{
+		std::atomic<bool> isRunning(true);
+		std::atomic<size_t> lookups(0);
+		vector<std::thread> threads;
+		for (size_t t = 0; t < readers; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					std::mt19937 random((unsigned)t + 1);
+					std::uniform_int_distribution<int> pick(0, keys - 1);
+					size_t done = 0, found = 0;
+					RecordPtr ptr;
+					while (isRunning.load(std::memory_order_relaxed))
+					{
+						for (int i = 0; i < 64; i++)
+							found += tree.find(TypeWrapper(pick(random)), ptr);
+
+						done += 64;
+					}
+
+					if (found != done)
+						std::cerr << "A reader missed " << done - found << " keys" << std::endl;
+
+					lookups += done;
+				});
+		}
+
+		inserted = 0;
+		if (nextKey)
+		{
+			threads.emplace_back([&]()
+				{
+					while (isRunning.load(std::memory_order_relaxed))
+					{
+						int key = (*nextKey)++;
+						tree.insert({ TypeWrapper(key), RecordPtr(key, 0) });
+						inserted++;
+					}
+				});
+		}
+
+		std::this_thread::sleep_for(duration);
+		isRunning = false;
+		for (std::thread& thread : threads)
+			thread.join();
+
+		return lookups;
+	}
+
+public:
+	/**
+	 * @brief Print the lookups per second for 1, 2, 4 ... maxReaders readers, without and with a concurrent inserter
+	 * @param keys - number of keys in the tree
+	 * @param maxReaders - the most reader threads measured
+	 * @param duration - how long every measurement runs
+	*/
+	static void run(int keys, size_t maxReaders, std::chrono::milliseconds duration)
+	{
+		BPTree tree;
+		for (int key = 0; key < keys; key++)
+			tree.insert({ TypeWrapper(key), RecordPtr(key, 0) });
+
+		std::atomic<int> nextKey(keys);
+		double seconds = duration.count() / 1000.0;
+		std::cout << "B+ tree with " << keys << " keys, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+		std::cout << "readers | lookups/s | lookups/s with an inserter | inserts/s" << std::endl;
+		for (size_t readers = 1; readers <= maxReaders; readers *= 2)
+		{
+			size_t inserted = 0;
+			size_t alone = measure(tree, keys, readers, nullptr, duration, inserted);
+			size_t withInserter = measure(tree, keys, readers, &nextKey, duration, inserted);
+			std::cout << readers << " | " << (size_t)(alone / seconds) << " | " << (size_t)(withInserter / seconds)
+				<< " | " << (size_t)(inserted / seconds) << std::endl;
+		}
+	}
+};
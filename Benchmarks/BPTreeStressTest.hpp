@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BPTree.hpp"
+
+using std::vector;
+using std::string;
+
+/**
+ * @brief Concurrency stress test of the B+ tree, meant to be built with ThreadSanitizer or AddressSanitizer.
+ * The tree starts with the even keys. Inserters add the odd keys, a remover drops the multiples of 4 and readers
+ * look up and scan the keys that are 2 modulo 4, which are there all the time. Every key points to RecordPtr(key, 0),
+ * so a reader can check the pointers it gets. At the end the tree has to hold exactly the keys that weren't removed
+*/
+class BPTreeStressTest
+{
+private:
+	BPTreeStressTest();
+
+	/**
+	 * @brief Report a failed check, only the first one is printed
+	 * @param message - what went wrong
+	 * @param failures - number of failures so far
+	*/
+	static void fail(const string& message, std::atomic<size_t>& failures)
+	{
+		if (failures++ == 0)
+			std::cerr << message << std::endl;
+	}
+
+public:
+	/**
+	 * @brief Run the test
+	 * @param keys - keys are in [0, keys), keys has to be a multiple of 4
+	 * @param inserters - number of inserter threads, they share the odd keys
+	 * @param readers - number of reader threads
+	 * @return True if every check passed
+	*/
+	static bool run(int keys, size_t inserters, size_t readers)
+	{
+		BPTree tree;
+		for (int key = 0; key < keys; key += 2)
+			tree.insert({ TypeWrapper(key), RecordPtr(key, 0) });
+
+		std::atomic<size_t> failures(0);
+		std::atomic<size_t> writersLeft(inserters + 1);
+		vector<std::thread> threads;
+		for (size_t t = 0; t < inserters; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					for (int key = 1 + 2 * (int)t; key < keys; key += 2 * (int)inserters)
+						tree.insert({ TypeWrapper(key), RecordPtr(key, 0) });
+
+					writersLeft--;
+				});
+		}
+
+		threads.emplace_back([&]()
+			{
+				for (int key = 0; key < keys; key += 4)
+					tree.remove(TypeWrapper(key));
+
+				writersLeft--;
+			});
+
+		for (size_t t = 0; t < readers; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					std::mt19937 random((unsigned)t + 1);
+					std::uniform_int_distribution<int> pick(0, keys / 4 - 1);
+					while (writersLeft > 0)
+					{
+						int key = pick(random) * 4 + 2;
+						RecordPtr ptr;
+						if (!tree.find(TypeWrapper(key), ptr) || ptr.getPage() != key)
+							fail("Lookup of " + std::to_string(key) + " failed", failures);
+
+						// The keys 2 modulo 4 of the range have to be there, in ascending order with the right pointers
+						int upper = key + 400;
+						TypeWrapper lowerKey(key), upperKey(upper);
+						int previous = key - 1, expected = key;
+						tree.forEachInRange(&lowerKey, true, &upperKey, false, [&](const data& entry)
+							{
+								int current = entry.second.getPage();
+								if (current <= previous)
+									fail("A range scan isn't ascending at " + std::to_string(current), failures);
+
+								if (current % 4 == 2)
+								{
+									if (current != expected)
+										fail("A range scan skipped " + std::to_string(expected), failures);
+
+									expected = current + 4;
+								}
+
+								previous = current;
+							});
+
+						if (expected < upper && expected < keys)
+							fail("A range scan ended before " + std::to_string(expected), failures);
+					}
+				});
+		}
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		int expected = 1;
+		tree.forEachInRange(nullptr, false, nullptr, false, [&](const data& entry)
+			{
+				while (expected % 4 == 0)
+					expected++;
+
+				if (entry.second.getPage() != expected)
+					fail("The tree holds " + std::to_string(entry.second.getPage()) + " instead of " + std::to_string(expected), failures);
+
+				expected = entry.second.getPage() + 1;
+			});
+
+		if (tree.size() != (size_t)(keys - keys / 4))
+			fail("The tree holds " + std::to_string(tree.size()) + " keys instead of " + std::to_string(keys - keys / 4), failures);
+
+		return failures == 0;
+	}
+};
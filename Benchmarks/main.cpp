@@ -0,0 +1,39 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "BPTreeBenchmark.hpp"
+#include "BPTreeStressTest.hpp"
+#include "ArtBenchmark.hpp"
+
+/**
+ * Benchmarks [readers|stress|art] [threads]
+ *   readers - lookups per second of the B+ tree for up to {threads} readers, with and without a concurrent inserter
+ *   stress  - concurrency stress test of the B+ tree with {threads} inserters and readers, exits with 1 if it fails
+ *   art     - insert, find and range scan times of the adaptive radix tree index and of the B+ tree, on sequential and random keys
+ * Without arguments everything is run, {threads} defaults to the number of hardware threads
+*/
+int main(int argc, char** argv)
+{
+	const char* what = argc > 1 ? argv[1] : "all";
+	size_t threads = argc > 2 ? (size_t)std::stoul(argv[2]) : std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+
+	bool isAll = strcmp(what, "all") == 0;
+	if (isAll || strcmp(what, "readers") == 0)
+		BPTreeBenchmark::run(1000000, threads, std::chrono::milliseconds(1000));
+
+	if (isAll || strcmp(what, "stress") == 0)
+	{
+		bool passed = BPTreeStressTest::run(200000, threads < 2 ? 2 : threads, threads < 2 ? 2 : threads);
+		std::cout << "B+ tree stress test " << (passed ? "passed" : "failed") << std::endl;
+		if (!passed)
+			return 1;
+	}
+
+	if (isAll || strcmp(what, "art") == 0)
+		ArtBenchmark::run(1000000);
+
+	return 0;
+}
@@ -0,0 +1,283 @@
+#pragma once
+#include<string>
+#include<vector>
+#include<sstream>
+#include<limits>
+#include<cmath>
+#include<algorithm>
+#include "TypeWrapper.hpp"
+#include "StringHelper.hpp"
+#include "AggregateFunction.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * @brief Descriptor of an aggregate function applied on a column, i.e. SUM(grade), COUNT(*) or PERCENTILE(grade, 0.9)
+*/
+class Aggregate
+{
+public:
+	Aggregate() : fFunction(AggregateFunction::COUNT), fColumn("*"), fFraction(0) {}
+
+	Aggregate(AggregateFunction function, const string& column, double fraction = 0) : fFunction(function), fColumn(column), fFraction(fraction) {}
+
+	/**
+	 * @brief Parse an item of the selected columns list
+	 * @param item - the item, i.e. "AVG(grade)" or "PERCENTILE(grade, 0.99)", the function name is case insensitive.
+	 * MEDIAN(grade) is the same as PERCENTILE(grade, 0.5)
+	 * @param aggregate - set to the parsed aggregate
+	 * @return True if the item is an aggregate function, false if it is a plain column
+	*/
+	static bool tryParse(const string& item, Aggregate& aggregate)
+	{
+		size_t open = item.find('(');
+		if (open == string::npos || item.back() != ')')
+			return false;
+
+		string name = sh::toUpper(item.substr(0, open));
+		string column = item.substr(open + 1, item.size() - open - 2);
+		sh::trim(name);
+		sh::trim(column);
+
+		AggregateFunction function;
+		if (name == "COUNT")
+			function = AggregateFunction::COUNT;
+		else if (name == "SUM")
+			function = AggregateFunction::SUM;
+		else if (name == "AVG")
+			function = AggregateFunction::AVG;
+		else if (name == "MIN")
+			function = AggregateFunction::MIN;
+		else if (name == "MAX")
+			function = AggregateFunction::MAX;
+		else if (name == "PERCENTILE" || name == "MEDIAN")
+			function = AggregateFunction::PERCENTILE;
+		else
+			return false;
+
+		double fraction = 0.5;
+		if (name == "PERCENTILE")
+		{
+			size_t comma = column.rfind(',');
+			string value = comma == string::npos ? "" : column.substr(comma + 1);
+			sh::trim(value);
+			if (!sh::isStringDouble(value) && !sh::isStringInteger(value))
+				throw std::invalid_argument("PERCENTILE needs a column and a fraction between 0 and 1, i.e. PERCENTILE(grade, 0.9)");
+
+			fraction = std::stod(value);
+			if (fraction < 0 || fraction > 1)
+				throw std::invalid_argument("The fraction of " + item + " has to be between 0 and 1");
+
+			column = column.substr(0, comma);
+			sh::trim(column);
+		}
+
+		if (column.empty() || (column == "*" && function != AggregateFunction::COUNT))
+			throw std::invalid_argument("Invalid argument of aggregate function " + item);
+
+		aggregate = Aggregate(function, column, fraction);
+		return true;
+	}
+
+	AggregateFunction getFunction() const { return fFunction; }
+
+	const string& getColumn() const { return fColumn; }
+
+	/**
+	 * @return the fraction of a PERCENTILE, 0.5 for MEDIAN
+	*/
+	double getFraction() const { return fFraction; }
+
+	/**
+	 * @brief The position of a PERCENTILE's value among the sorted values of the column (nearest rank):
+	 * the smallest value such that at least the given fraction of the values are smaller than or equal to it
+	 * @param count - the number of values, at least 1
+	 * @return the position, 0 is the smallest value
+	*/
+	size_t getPercentilePosition(size_t count) const
+	{
+		size_t rank = (size_t)std::ceil(fFraction * count);
+		return rank == 0 ? 0 : std::min(rank, count) - 1;
+	}
+
+	/**
+	 * @return True for COUNT(*), which counts records instead of values of a column
+	*/
+	bool isCountAll() const { return fColumn == "*"; }
+
+	/**
+	 * @return the aggregate as it is written in a query, used as the name of its column in the answer
+	*/
+	string getName() const
+	{
+		static const char* names[] = { "COUNT", "SUM", "AVG", "MIN", "MAX", "PERCENTILE" };
+		if (fFunction == AggregateFunction::PERCENTILE)
+		{
+			std::ostringstream fraction;
+			fraction << fFraction;
+			return string(names[(int)fFunction]) + "(" + fColumn + ", " + fraction.str() + ")";
+		}
+
+		return string(names[(int)fFunction]) + "(" + fColumn + ")";
+	}
+
+private:
+	AggregateFunction fFunction;
+	string fColumn;
+	double fFraction;
+};
+
+/**
+ * @brief Running state of an aggregate over a group of records. Partial states built by different workers
+ * are combined with merge, so every worker can aggregate its own pages without sharing anything
+*/
+class AggregateState
+{
+public:
+	AggregateState() : fCount(0), fSum(0), fIntegerSum(0) {}
+
+	/**
+	 * @brief Add a value of the aggregated column, null values are skipped
+	 * @param value - the value
+	 * @param isKept - if True the value is also kept, a PERCENTILE is picked from all values of the group
+	*/
+	void add(const TypeWrapper& value, bool isKept = false)
+	{
+		if (value.getContent() == nullptr)
+			return;
+
+		if (isKept)
+			fValues.push_back(value);
+
+		fCount++;
+		accumulate(value);
+		if (fMin.getContent() == nullptr || value < fMin)
+			fMin = value;
+		if (fMax.getContent() == nullptr || value > fMax)
+			fMax = value;
+	}
+
+	/**
+	 * @brief Count a record, used by COUNT(*)
+	*/
+	void addRecord() { fCount++; }
+
+	/**
+	 * @brief Combine the state of another part of the same group into this one
+	 * @param other - the state of the other part
+	*/
+	void merge(const AggregateState& other)
+	{
+		fCount += other.fCount;
+		fSum += other.fSum;
+		fIntegerSum += other.fIntegerSum;
+		fValues.insert(fValues.end(), other.fValues.begin(), other.fValues.end());
+		if (other.fMin.getContent() != nullptr && (fMin.getContent() == nullptr || other.fMin < fMin))
+			fMin = other.fMin;
+		if (other.fMax.getContent() != nullptr && (fMax.getContent() == nullptr || other.fMax > fMax))
+			fMax = other.fMax;
+	}
+
+	/**
+	 * @param aggregate - the aggregate that was computed
+	 * @param columnType - type of the aggregated column
+	 * @return the value of the aggregate, empty for MIN/MAX/SUM/AVG/PERCENTILE of no values
+	*/
+	TypeWrapper result(const Aggregate& aggregate, const string& columnType)
+	{
+		switch (aggregate.getFunction())
+		{
+		case AggregateFunction::COUNT:
+			return TypeWrapper((int)fCount);
+		case AggregateFunction::MIN:
+			return fMin;
+		case AggregateFunction::MAX:
+			return fMax;
+		case AggregateFunction::PERCENTILE:
+		{
+			if (fValues.empty())
+				return TypeWrapper();
+
+			auto nth = fValues.begin() + aggregate.getPercentilePosition(fValues.size());
+			std::nth_element(fValues.begin(), nth, fValues.end());
+			return *nth;
+		}
+		default:
+			break;
+		}
+
+		if (fCount == 0)
+			return TypeWrapper();
+
+		if (aggregate.getFunction() == AggregateFunction::AVG)
+			return TypeWrapper(fSum / fCount);
+
+		// Integer sums stay integers as long as they fit
+		if (columnType == "Integer" && fIntegerSum >= std::numeric_limits<int>::min() && fIntegerSum <= std::numeric_limits<int>::max())
+			return TypeWrapper((int)fIntegerSum);
+
+		return TypeWrapper(fSum);
+	}
+
+private:
+	size_t fCount;
+	double fSum;
+	long long fIntegerSum;
+	TypeWrapper fMin;
+	TypeWrapper fMax;
+	vector<TypeWrapper> fValues;
+
+	void accumulate(const TypeWrapper& value)
+	{
+		const Object* content = value.getContent();
+		if (typeid(*content) == typeid(IntegerObject))
+		{
+			int number = static_cast<const IntegerObject*>(content)->getValue();
+			fIntegerSum += number;
+			fSum += number;
+		}
+		else if (typeid(*content) == typeid(DoubleObject))
+		{
+			fSum += static_cast<const DoubleObject*>(content)->getValue();
+		}
+	}
+};
+
+/**
+ * @brief Hash of the values of the GROUP BY columns of a record, combined like the parts of a composite key. Null values hash to 0
+*/
+class GroupKeyHash
+{
+public:
+	size_t operator()(const vector<TypeWrapper>& key) const
+	{
+		size_t seed = key.size();
+		for (const TypeWrapper& value : key)
+			seed = CompositeObject::combineHash(seed, value.getContent() ? value.hash() : 0);
+
+		return seed;
+	}
+};
+
+/**
+ * @brief Equality of the values of the GROUP BY columns of two records, null values are equal to each other only
+*/
+class GroupKeyEqual
+{
+public:
+	bool operator()(const vector<TypeWrapper>& a, const vector<TypeWrapper>& b) const
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			bool isNullA = a[i].getContent() == nullptr, isNullB = b[i].getContent() == nullptr;
+			if (isNullA != isNullB || (!isNullA && !(a[i] == b[i])))
+				return false;
+		}
+
+		return true;
+	}
+};
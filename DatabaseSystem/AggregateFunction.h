@@ -0,0 +1,10 @@
+#pragma once
+enum class AggregateFunction
+{
+	COUNT,
+	SUM,
+	AVG,
+	MIN,
+	MAX,
+	PERCENTILE
+};
@@ -0,0 +1,912 @@
+#pragma once
+#include<vector>
+#include<memory>
+#include<new>
+#include<algorithm>
+#include<cstdint>
+#include<cstring>
+#include<functional>
+#include<typeinfo>
+#include<stdexcept>
+#include "RecordPtr.hpp"
+#include "TypeWrapper.hpp"
+#include "IntegerObject.hpp"
+#include "NodePool.hpp"
+#include "Query.hpp"
+
+using std::vector;
+
+#define ART_KEY_BYTES 4
+
+/**
+ * @brief Descriptor of a unique adaptive radix tree (ART) index from Integer key to record pointer.
+ * A key is turned into 4 bytes that sort like the numbers (the sign bit flipped, most significant byte first)
+ * and the tree branches on one byte per level, so a lookup makes at most 4 steps and never compares keys.
+ * Inner nodes grow and shrink between 4 kinds by the number of their children: Node4 and Node16 keep sorted arrays
+ * of key bytes next to the children, Node48 maps every byte to one of 48 children, Node256 has a child for every byte.
+ * A chain of nodes with a single child is collapsed into the prefix of the node below it, and a key that doesn't share
+ * its next bytes with any other one is kept in a leaf right away instead of at the bottom level.
+ * The keys are visited in order, so the index answers ranges and ORDER BY like a B+ tree.
+ * The nodes are blocks of a NodePool per kind. Not thread-safe, like HashIndex
+*/
+class ArtIndex
+{
+public:
+	ArtIndex() : fRoot(nullptr), fSize(0) {}
+
+	/**
+	 * @brief Reading constructor, the keys are stored in ascending order
+	 * @param in - input stream
+	*/
+	ArtIndex(istream& in) : ArtIndex()
+	{
+		size_t count = 0;
+		in.read((char*)&count, sizeof(count));
+		for (size_t i = 0; i < count; i++)
+		{
+			int key = 0;
+			in.read((char*)&key, sizeof(key));
+			RecordPtr ptr(in);
+			insertKey(normalize(key), ptr);
+		}
+	}
+
+	ArtIndex(const ArtIndex& other) : ArtIndex()
+	{
+		fRoot = copy(other.fRoot);
+		fSize = other.fSize;
+	}
+
+	ArtIndex& operator=(const ArtIndex& other)
+	{
+		if (this != &other)
+		{
+			ArtIndex copied(other);
+			swap(copied);
+		}
+
+		return *this;
+	}
+
+	ArtIndex(ArtIndex&& other) noexcept : ArtIndex()
+	{
+		swap(other);
+	}
+
+	ArtIndex& operator=(ArtIndex&& other) noexcept
+	{
+		if (this != &other)
+			swap(other);
+
+		return *this;
+	}
+
+	/**
+	 * @brief Write the keys with their pointers in ascending key order
+	 * @param out - output stream
+	*/
+	void write(ostream& out) const
+	{
+		out.write((char*)&fSize, sizeof(fSize));
+		scan(fRoot, 0, 0, UINT32_MAX, true, true, false, [&](const Leaf* leaf)
+			{
+				int key = denormalize(leaf->fKey);
+				out.write((char*)&key, sizeof(key));
+				leaf->fPtr.write(out);
+				return true;
+			});
+	}
+
+	/**
+	 * @brief Insert a key with the pointer to its record
+	 * @param key - an Integer
+	 * @return False if the key is already in the index (nothing is inserted), True otherwise
+	*/
+	bool insert(const TypeWrapper& key, const RecordPtr& ptr)
+	{
+		int value = 0;
+		if (!toInteger(key, value))
+			throw std::invalid_argument("An ART index holds only Integer keys");
+
+		return insertKey(normalize(value), ptr);
+	}
+
+	/**
+	 * @brief Look up a key
+	 * @param key - key to be searched for
+	 * @param ptr - set to the pointer of the key's record if the key is found
+	 * @return True if the key is in the index, false otherwise
+	*/
+	bool find(const TypeWrapper& key, RecordPtr& ptr) const
+	{
+		int value = 0;
+		if (!toInteger(key, value))
+			return false;
+
+		uint32_t normalized = normalize(value);
+		const Node* node = fRoot;
+		size_t depth = 0;
+		while (node != nullptr && node->fType != LEAF)
+		{
+			if (matchPrefix(node, normalized, depth) < node->fPrefixLength)
+				return false;
+
+			depth += node->fPrefixLength;
+			Node* const* child = findChild(node, byteAt(normalized, depth));
+			node = child ? *child : nullptr;
+			depth++;
+		}
+
+		if (node == nullptr || static_cast<const Leaf*>(node)->fKey != normalized)
+			return false;
+
+		ptr = static_cast<const Leaf*>(node)->fPtr;
+		return true;
+	}
+
+	bool contains(const TypeWrapper& key) const
+	{
+		RecordPtr ptr;
+		return find(key, ptr);
+	}
+
+	/**
+	 * @brief Remove a key, nodes left with too few children shrink to a smaller kind
+	 * @param key - key to be removed
+	*/
+	void remove(const TypeWrapper& key)
+	{
+		int value = 0;
+		if (toInteger(key, value) && removeKey(fRoot, normalize(value), 0))
+			fSize--;
+	}
+
+	/**
+	 * @brief Remove a batch of keys
+	 * @param keys - keys to be removed, keys that are not in the index are skipped
+	*/
+	void remove(const vector<TypeWrapper>& keys)
+	{
+		for (const TypeWrapper& key : keys)
+			remove(key);
+	}
+
+	/**
+	 * @brief Get the pointers of all keys satisfying {key} {op} {value}, in ascending key order
+	 * @param op - comparison operator
+	 * @param value - value the keys are compared against
+	 * @return array of record pointers that satisfy the criteria
+	*/
+	vector<RecordPtr> getRecordPtrs(Operator op, const TypeWrapper& value) const
+	{
+		vector<RecordPtr> answer;
+		switch (op)
+		{
+		case Operator::EQUAL:
+			return getRecordPtrsInRange(&value, true, &value, true);
+		case Operator::NOT_EQUAL:
+			answer = getRecordPtrsInRange(nullptr, false, &value, false);
+			for (const RecordPtr& ptr : getRecordPtrsInRange(&value, false, nullptr, false))
+				answer.push_back(ptr);
+
+			return answer;
+		case Operator::GREATER_THAN:
+		case Operator::GREATER_THAN_OR_EQUAL:
+			return getRecordPtrsInRange(&value, op == Operator::GREATER_THAN_OR_EQUAL, nullptr, false);
+		case Operator::LESS_THAN:
+		case Operator::LESS_THAN_OR_EQUAL:
+			return getRecordPtrsInRange(nullptr, false, &value, op == Operator::LESS_THAN_OR_EQUAL);
+		default:
+			return answer;
+		}
+	}
+
+	/**
+	 * @brief Get the pointers of all keys between two bounds, in ascending key order
+	 * @param lower - lower bound, nullptr for none
+	 * @param lowerInclusive - whether a key equal to the lower bound is included
+	 * @param upper - upper bound, nullptr for none
+	 * @param upperInclusive - whether a key equal to the upper bound is included
+	 * @param limit - the most pointers to return
+	 * @return pointers to the records in ascending key order
+	*/
+	vector<RecordPtr> getRecordPtrsInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		size_t limit = SIZE_MAX) const
+	{
+		vector<RecordPtr> answer;
+		if (limit == 0)
+			return answer;
+
+		scanRange(lower, lowerInclusive, upper, upperInclusive, false, [&](const Leaf* leaf)
+			{
+				answer.push_back(leaf->fPtr);
+				return answer.size() < limit;
+			});
+
+		return answer;
+	}
+
+	/**
+	 * @brief Get the pointers of the keys between two bounds in descending key order, see getRecordPtrsInRange
+	*/
+	vector<RecordPtr> getRecordPtrsInRangeReverse(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		size_t limit = SIZE_MAX) const
+	{
+		vector<RecordPtr> answer;
+		if (limit == 0)
+			return answer;
+
+		scanRange(lower, lowerInclusive, upper, upperInclusive, true, [&](const Leaf* leaf)
+			{
+				answer.push_back(leaf->fPtr);
+				return answer.size() < limit;
+			});
+
+		return answer;
+	}
+
+	/**
+	 * @brief Visit every key-pointer pair between two bounds in ascending key order. Only the subtrees
+	 * on the paths of the two bounds are checked against them, the ones in between are visited whole
+	 * @param visit - function called with every key and pointer in the range, returns false to stop the scan
+	*/
+	void forEachInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<bool(const TypeWrapper&, const RecordPtr&)>& visit) const
+	{
+		scanRange(lower, lowerInclusive, upper, upperInclusive, false, [&](const Leaf* leaf)
+			{
+				return visit(TypeWrapper(denormalize(leaf->fKey)), leaf->fPtr);
+			});
+	}
+
+	/**
+	 * @brief Visit every key-pointer pair between two bounds in descending key order, see forEachInRange
+	*/
+	void forEachInRangeReverse(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<bool(const TypeWrapper&, const RecordPtr&)>& visit) const
+	{
+		scanRange(lower, lowerInclusive, upper, upperInclusive, true, [&](const Leaf* leaf)
+			{
+				return visit(TypeWrapper(denormalize(leaf->fKey)), leaf->fPtr);
+			});
+	}
+
+	size_t size() const { return fSize; }
+
+private:
+	enum NodeType : unsigned char { LEAF, NODE4, NODE16, NODE48, NODE256, NODE_TYPES };
+
+	/**
+	 * @brief Header of every node. The prefix holds the key bytes all keys below an inner node share
+	 * after the byte that led to the node, they are skipped when descending
+	*/
+	struct Node
+	{
+		NodeType fType;
+		unsigned char fPrefixLength;
+		unsigned short fCount; // children of an inner node
+		unsigned char fPrefix[ART_KEY_BYTES];
+	};
+
+	struct Leaf : Node
+	{
+		uint32_t fKey; // the whole normalized key, a leaf may sit above the bottom level
+		RecordPtr fPtr;
+	};
+
+	struct Node4 : Node
+	{
+		unsigned char fKeys[4];
+		Node* fChildren[4];
+	};
+
+	struct Node16 : Node
+	{
+		unsigned char fKeys[16];
+		Node* fChildren[16];
+	};
+
+	struct Node48 : Node
+	{
+		unsigned char fSlots[256]; // position of the byte's child + 1, 0 if it has none
+		Node* fChildren[48];
+	};
+
+	struct Node256 : Node
+	{
+		Node* fChildren[256];
+	};
+
+	Node* fRoot;
+	size_t fSize;
+	std::unique_ptr<NodePool> fPools[NODE_TYPES];
+
+	void swap(ArtIndex& other)
+	{
+		std::swap(fRoot, other.fRoot);
+		std::swap(fSize, other.fSize);
+		for (size_t i = 0; i < NODE_TYPES; i++)
+			std::swap(fPools[i], other.fPools[i]);
+	}
+
+	/**
+	 * @brief Flip the sign bit, so the unsigned keys compare like the numbers
+	*/
+	static uint32_t normalize(int value) { return (uint32_t)value ^ 0x80000000u; }
+
+	static int denormalize(uint32_t key) { return (int)(key ^ 0x80000000u); }
+
+	/**
+	 * @return the byte of a normalized key at a depth, 0 is the most significant one
+	*/
+	static unsigned char byteAt(uint32_t key, size_t depth) { return (unsigned char)(key >> (8 * (ART_KEY_BYTES - 1 - depth))); }
+
+	static bool toInteger(const TypeWrapper& key, int& value)
+	{
+		const Object* content = key.getContent();
+		if (content == nullptr || typeid(*content) != typeid(IntegerObject))
+			return false;
+
+		value = static_cast<const IntegerObject*>(content)->getValue();
+		return true;
+	}
+
+	template<class T>
+	T* create(NodeType type)
+	{
+		std::unique_ptr<NodePool>& pool = fPools[type];
+		if (!pool)
+			pool.reset(new NodePool(sizeof(T)));
+
+		T* node = new (pool->allocate()) T();
+		node->fType = type;
+		return node;
+	}
+
+	/**
+	 * @brief Give the block of a node back to its pool, the nodes are trivially destructible
+	*/
+	void destroy(Node* node)
+	{
+		fPools[node->fType]->deallocate(node);
+	}
+
+	Leaf* createLeaf(uint32_t key, const RecordPtr& ptr)
+	{
+		Leaf* leaf = create<Leaf>(LEAF);
+		leaf->fKey = key;
+		leaf->fPtr = ptr;
+		return leaf;
+	}
+
+	/**
+	 * @brief Copy a subtree into the pools of this index
+	*/
+	Node* copy(const Node* node)
+	{
+		if (node == nullptr)
+			return nullptr;
+
+		Node* copied = nullptr;
+		size_t children = 0;
+		switch (node->fType)
+		{
+		case LEAF:
+			return copyNode(static_cast<const Leaf*>(node));
+		case NODE4:
+			copied = copyNode(static_cast<const Node4*>(node));
+			children = node->fCount;
+			break;
+		case NODE16:
+			copied = copyNode(static_cast<const Node16*>(node));
+			children = node->fCount;
+			break;
+		case NODE48:
+			copied = copyNode(static_cast<const Node48*>(node));
+			children = 48;
+			break;
+		default:
+			copied = copyNode(static_cast<const Node256*>(node));
+			children = 256;
+			break;
+		}
+
+		Node** copiedChildren = getChildren(copied);
+		for (size_t i = 0; i < children; i++)
+			copiedChildren[i] = copy(copiedChildren[i]);
+
+		return copied;
+	}
+
+	template<class T>
+	T* copyNode(const T* node)
+	{
+		T* copied = create<T>(node->fType);
+		*copied = *node;
+		return copied;
+	}
+
+	/**
+	 * @return the array of children of an inner node, a Node4 and a Node16 keep theirs in the order of their key bytes
+	*/
+	static Node** getChildren(Node* node)
+	{
+		switch (node->fType)
+		{
+		case NODE4:
+			return static_cast<Node4*>(node)->fChildren;
+		case NODE16:
+			return static_cast<Node16*>(node)->fChildren;
+		case NODE48:
+			return static_cast<Node48*>(node)->fChildren;
+		default:
+			return static_cast<Node256*>(node)->fChildren;
+		}
+	}
+
+	static Node* const* getChildren(const Node* node)
+	{
+		return getChildren(const_cast<Node*>(node));
+	}
+
+	static void copyHeader(Node* to, const Node* from)
+	{
+		to->fCount = from->fCount;
+		to->fPrefixLength = from->fPrefixLength;
+		memcpy(to->fPrefix, from->fPrefix, ART_KEY_BYTES);
+	}
+
+	/**
+	 * @return the number of leading prefix bytes of a node that are equal to the key's bytes from the depth on
+	*/
+	static size_t matchPrefix(const Node* node, uint32_t key, size_t depth)
+	{
+		size_t i = 0;
+		while (i < node->fPrefixLength && node->fPrefix[i] == byteAt(key, depth + i))
+			i++;
+
+		return i;
+	}
+
+	/**
+	 * @return the slot holding the child for a byte, nullptr if the node has none
+	*/
+	static Node* const* findChild(const Node* node, unsigned char byte)
+	{
+		switch (node->fType)
+		{
+		case NODE4:
+		{
+			const Node4* n = static_cast<const Node4*>(node);
+			for (size_t i = 0; i < n->fCount; i++)
+				if (n->fKeys[i] == byte)
+					return &n->fChildren[i];
+
+			return nullptr;
+		}
+		case NODE16:
+		{
+			const Node16* n = static_cast<const Node16*>(node);
+			const unsigned char* it = std::lower_bound(n->fKeys, n->fKeys + n->fCount, byte);
+			return it != n->fKeys + n->fCount && *it == byte ? &n->fChildren[it - n->fKeys] : nullptr;
+		}
+		case NODE48:
+		{
+			const Node48* n = static_cast<const Node48*>(node);
+			return n->fSlots[byte] ? &n->fChildren[n->fSlots[byte] - 1] : nullptr;
+		}
+		default:
+		{
+			const Node256* n = static_cast<const Node256*>(node);
+			return n->fChildren[byte] ? &n->fChildren[byte] : nullptr;
+		}
+		}
+	}
+
+	static Node** findChild(Node* node, unsigned char byte)
+	{
+		return const_cast<Node**>(findChild(static_cast<const Node*>(node), byte));
+	}
+
+	bool insertKey(uint32_t key, const RecordPtr& ptr)
+	{
+		if (!insertKey(fRoot, key, ptr, 0))
+			return false;
+
+		fSize++;
+		return true;
+	}
+
+	/**
+	 * @brief Insert a key below the node in a slot, the slot is updated when the node is replaced
+	 * @param depth - the number of key bytes consumed above the node
+	*/
+	bool insertKey(Node*& slot, uint32_t key, const RecordPtr& ptr, size_t depth)
+	{
+		Node* node = slot;
+		if (node == nullptr)
+		{
+			slot = createLeaf(key, ptr);
+			return true;
+		}
+
+		if (node->fType == LEAF)
+		{
+			uint32_t other = static_cast<Leaf*>(node)->fKey;
+			if (other == key)
+				return false;
+
+			// Both keys go below a new node at the first byte they differ in, the bytes they share become its prefix
+			Node4* split = create<Node4>(NODE4);
+			while (byteAt(other, depth) == byteAt(key, depth))
+				split->fPrefix[split->fPrefixLength++] = byteAt(key, depth++);
+
+			slot = split;
+			addChild(slot, byteAt(other, depth), node);
+			addChild(slot, byteAt(key, depth), createLeaf(key, ptr));
+			return true;
+		}
+
+		size_t matched = matchPrefix(node, key, depth);
+		if (matched < node->fPrefixLength)
+		{
+			// The key leaves the prefix, a new node takes the matched part and the old node keeps the rest
+			Node4* split = create<Node4>(NODE4);
+			split->fPrefixLength = (unsigned char)matched;
+			memcpy(split->fPrefix, node->fPrefix, matched);
+
+			unsigned char byte = node->fPrefix[matched];
+			node->fPrefixLength -= (unsigned char)(matched + 1);
+			memmove(node->fPrefix, node->fPrefix + matched + 1, node->fPrefixLength);
+
+			slot = split;
+			addChild(slot, byte, node);
+			addChild(slot, byteAt(key, depth + matched), createLeaf(key, ptr));
+			return true;
+		}
+
+		depth += node->fPrefixLength;
+		Node** child = findChild(node, byteAt(key, depth));
+		if (child != nullptr)
+			return insertKey(*child, key, ptr, depth + 1);
+
+		addChild(slot, byteAt(key, depth), createLeaf(key, ptr));
+		return true;
+	}
+
+	/**
+	 * @brief Add a child for a byte the node doesn't have one for, a full node is replaced by a bigger kind
+	*/
+	void addChild(Node*& slot, unsigned char byte, Node* child)
+	{
+		Node* node = slot;
+		switch (node->fType)
+		{
+		case NODE4:
+		{
+			Node4* n = static_cast<Node4*>(node);
+			if (n->fCount < 4)
+			{
+				insertSorted(n->fKeys, n->fChildren, n->fCount, byte, child);
+				return;
+			}
+
+			Node16* grown = create<Node16>(NODE16);
+			copyHeader(grown, n);
+			memcpy(grown->fKeys, n->fKeys, sizeof(n->fKeys));
+			memcpy(grown->fChildren, n->fChildren, sizeof(n->fChildren));
+			slot = grown;
+			destroy(n);
+			insertSorted(grown->fKeys, grown->fChildren, grown->fCount, byte, child);
+			return;
+		}
+		case NODE16:
+		{
+			Node16* n = static_cast<Node16*>(node);
+			if (n->fCount < 16)
+			{
+				insertSorted(n->fKeys, n->fChildren, n->fCount, byte, child);
+				return;
+			}
+
+			Node48* grown = create<Node48>(NODE48);
+			copyHeader(grown, n);
+			for (size_t i = 0; i < n->fCount; i++)
+			{
+				grown->fSlots[n->fKeys[i]] = (unsigned char)(i + 1);
+				grown->fChildren[i] = n->fChildren[i];
+			}
+
+			slot = grown;
+			destroy(n);
+			addChild(slot, byte, child);
+			return;
+		}
+		case NODE48:
+		{
+			Node48* n = static_cast<Node48*>(node);
+			if (n->fCount < 48)
+			{
+				// Removed children leave holes, the first free position is taken
+				size_t pos = 0;
+				while (n->fChildren[pos] != nullptr)
+					pos++;
+
+				n->fChildren[pos] = child;
+				n->fSlots[byte] = (unsigned char)(pos + 1);
+				n->fCount++;
+				return;
+			}
+
+			Node256* grown = create<Node256>(NODE256);
+			copyHeader(grown, n);
+			for (size_t b = 0; b < 256; b++)
+				if (n->fSlots[b])
+					grown->fChildren[b] = n->fChildren[n->fSlots[b] - 1];
+
+			slot = grown;
+			destroy(n);
+			addChild(slot, byte, child);
+			return;
+		}
+		default:
+		{
+			Node256* n = static_cast<Node256*>(node);
+			n->fChildren[byte] = child;
+			n->fCount++;
+			return;
+		}
+		}
+	}
+
+	static void insertSorted(unsigned char* keys, Node** children, unsigned short& count, unsigned char byte, Node* child)
+	{
+		size_t pos = std::lower_bound(keys, keys + count, byte) - keys;
+		memmove(keys + pos + 1, keys + pos, count - pos);
+		memmove(children + pos + 1, children + pos, (count - pos) * sizeof(Node*));
+		keys[pos] = byte;
+		children[pos] = child;
+		count++;
+	}
+
+	static void eraseSorted(unsigned char* keys, Node** children, unsigned short& count, size_t pos)
+	{
+		memmove(keys + pos, keys + pos + 1, count - pos - 1);
+		memmove(children + pos, children + pos + 1, (count - pos - 1) * sizeof(Node*));
+		count--;
+	}
+
+	/**
+	 * @brief Remove a key below the node in a slot, the slot is updated when the node shrinks or goes away
+	 * @return True if the key was found
+	*/
+	bool removeKey(Node*& slot, uint32_t key, size_t depth)
+	{
+		Node* node = slot;
+		if (node == nullptr)
+			return false;
+
+		if (node->fType == LEAF)
+		{
+			if (static_cast<Leaf*>(node)->fKey != key)
+				return false;
+
+			destroy(node);
+			slot = nullptr;
+			return true;
+		}
+
+		if (matchPrefix(node, key, depth) < node->fPrefixLength)
+			return false;
+
+		depth += node->fPrefixLength;
+		unsigned char byte = byteAt(key, depth);
+		Node** child = findChild(node, byte);
+		if (child == nullptr || !removeKey(*child, key, depth + 1))
+			return false;
+
+		if (*child == nullptr)
+			removeChild(slot, byte);
+
+		return true;
+	}
+
+	/**
+	 * @brief Remove the child of a byte. A node left with few children is replaced by a smaller kind (a bit below the size
+	 * it grows at, so a key inserted and removed at the border doesn't rebuild the node every time), a Node4 with
+	 * a single child is replaced by that child
+	*/
+	void removeChild(Node*& slot, unsigned char byte)
+	{
+		Node* node = slot;
+		switch (node->fType)
+		{
+		case NODE4:
+		{
+			Node4* n = static_cast<Node4*>(node);
+			eraseSorted(n->fKeys, n->fChildren, n->fCount, std::find(n->fKeys, n->fKeys + n->fCount, byte) - n->fKeys);
+			if (n->fCount > 1)
+				return;
+
+			// The node's prefix and the byte of the remaining child go in front of the child's own prefix
+			Node* only = n->fChildren[0];
+			if (only->fType != LEAF)
+			{
+				unsigned char prefix[ART_KEY_BYTES];
+				size_t length = n->fPrefixLength;
+				memcpy(prefix, n->fPrefix, length);
+				prefix[length++] = n->fKeys[0];
+				memcpy(prefix + length, only->fPrefix, only->fPrefixLength);
+				only->fPrefixLength = (unsigned char)(length + only->fPrefixLength);
+				memcpy(only->fPrefix, prefix, only->fPrefixLength);
+			}
+
+			slot = only;
+			destroy(n);
+			return;
+		}
+		case NODE16:
+		{
+			Node16* n = static_cast<Node16*>(node);
+			eraseSorted(n->fKeys, n->fChildren, n->fCount, std::lower_bound(n->fKeys, n->fKeys + n->fCount, byte) - n->fKeys);
+			if (n->fCount > 3)
+				return;
+
+			Node4* shrunk = create<Node4>(NODE4);
+			copyHeader(shrunk, n);
+			memcpy(shrunk->fKeys, n->fKeys, n->fCount);
+			memcpy(shrunk->fChildren, n->fChildren, n->fCount * sizeof(Node*));
+			slot = shrunk;
+			destroy(n);
+			return;
+		}
+		case NODE48:
+		{
+			Node48* n = static_cast<Node48*>(node);
+			n->fChildren[n->fSlots[byte] - 1] = nullptr;
+			n->fSlots[byte] = 0;
+			n->fCount--;
+			if (n->fCount > 12)
+				return;
+
+			Node16* shrunk = create<Node16>(NODE16);
+			copyHeader(shrunk, n);
+			shrunk->fCount = 0;
+			for (size_t b = 0; b < 256; b++)
+				if (n->fSlots[b])
+				{
+					shrunk->fKeys[shrunk->fCount] = (unsigned char)b;
+					shrunk->fChildren[shrunk->fCount++] = n->fChildren[n->fSlots[b] - 1];
+				}
+
+			slot = shrunk;
+			destroy(n);
+			return;
+		}
+		default:
+		{
+			Node256* n = static_cast<Node256*>(node);
+			n->fChildren[byte] = nullptr;
+			n->fCount--;
+			if (n->fCount > 40)
+				return;
+
+			Node48* shrunk = create<Node48>(NODE48);
+			copyHeader(shrunk, n);
+			shrunk->fCount = 0;
+			for (size_t b = 0; b < 256; b++)
+				if (n->fChildren[b])
+				{
+					shrunk->fChildren[shrunk->fCount] = n->fChildren[b];
+					shrunk->fSlots[b] = (unsigned char)++shrunk->fCount;
+				}
+
+			slot = shrunk;
+			destroy(n);
+			return;
+		}
+		}
+	}
+
+	/**
+	 * @brief Visit the leaves between two bounds, see scan. A bound that isn't an Integer gives an empty range, like in BPTree
+	*/
+	void scanRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive, bool isReverse,
+		const std::function<bool(const Leaf*)>& visit) const
+	{
+		uint32_t first = 0, last = UINT32_MAX;
+		int value = 0;
+		if (lower)
+		{
+			if (!toInteger(*lower, value) || (!lowerInclusive && normalize(value) == UINT32_MAX))
+				return;
+
+			first = normalize(value) + (lowerInclusive ? 0 : 1);
+		}
+
+		if (upper)
+		{
+			if (!toInteger(*upper, value) || (!upperInclusive && normalize(value) == 0))
+				return;
+
+			last = normalize(value) - (upperInclusive ? 0 : 1);
+		}
+
+		if (first > last)
+			return;
+
+		scan(fRoot, 0, first, last, true, true, isReverse, visit);
+	}
+
+	/**
+	 * @brief Visit the leaves below a node with keys in [first, last]. While the bytes on the way down equal the bytes
+	 * of a bound, the next byte is checked against that bound, the children after that are wholly inside the range
+	 * @param onFirst - whether the path so far equals the bytes of first
+	 * @param onLast - whether the path so far equals the bytes of last
+	 * @return False if visit stopped the scan
+	*/
+	static bool scan(const Node* node, size_t depth, uint32_t first, uint32_t last, bool onFirst, bool onLast, bool isReverse,
+		const std::function<bool(const Leaf*)>& visit)
+	{
+		if (node == nullptr)
+			return true;
+
+		if (node->fType == LEAF)
+		{
+			const Leaf* leaf = static_cast<const Leaf*>(node);
+			return leaf->fKey < first || leaf->fKey > last || visit(leaf);
+		}
+
+		for (size_t i = 0; i < node->fPrefixLength; i++, depth++)
+		{
+			unsigned char byte = node->fPrefix[i];
+			if ((onFirst && byte < byteAt(first, depth)) || (onLast && byte > byteAt(last, depth)))
+				return true;
+
+			onFirst = onFirst && byte == byteAt(first, depth);
+			onLast = onLast && byte == byteAt(last, depth);
+		}
+
+		unsigned char from = onFirst ? byteAt(first, depth) : 0, to = onLast ? byteAt(last, depth) : 255;
+		auto visitChild = [&](unsigned char byte, const Node* child)
+		{
+			return scan(child, depth + 1, first, last, onFirst && byte == from, onLast && byte == to, isReverse, visit);
+		};
+
+		switch (node->fType)
+		{
+		case NODE4:
+		case NODE16:
+		{
+			const unsigned char* keys = node->fType == NODE4 ? static_cast<const Node4*>(node)->fKeys : static_cast<const Node16*>(node)->fKeys;
+			Node* const* children = getChildren(node);
+			for (size_t i = 0; i < node->fCount; i++)
+			{
+				size_t pos = isReverse ? node->fCount - 1 - i : i;
+				if (keys[pos] >= from && keys[pos] <= to && !visitChild(keys[pos], children[pos]))
+					return false;
+			}
+
+			return true;
+		}
+		case NODE48:
+		{
+			const Node48* n = static_cast<const Node48*>(node);
+			for (int b = isReverse ? to : from; b >= from && b <= to; b += isReverse ? -1 : 1)
+				if (n->fSlots[b] && !visitChild((unsigned char)b, n->fChildren[n->fSlots[b] - 1]))
+					return false;
+
+			return true;
+		}
+		default:
+		{
+			const Node256* n = static_cast<const Node256*>(node);
+			for (int b = isReverse ? to : from; b >= from && b <= to; b += isReverse ? -1 : 1)
+				if (n->fChildren[b] && !visitChild((unsigned char)b, n->fChildren[b]))
+					return false;
+
+			return true;
+		}
+		}
+	}
+};
@@ -2,33 +2,220 @@
 #include <iostream>
 #include<vector>
 #include<set>
+#include<memory>
+#include<algorithm>
+#include<functional>
+#include<sstream>
+#include<atomic>
+#include<mutex>
+#include<shared_mutex>
+#include<new>
+#include<climits>
 #include "RecordPtr.hpp"
 #include "TypeWrapper.hpp"
 #include "Query.hpp"
+#include "TableSpace.hpp"
+#include "NodePool.hpp"
 
 using std::set;
 using std::pair;
 using std::vector;
+using std::stringstream;
+using std::shared_ptr;
+using std::mutex;
+using std::shared_mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::shared_lock;
 using data = pair<TypeWrapper, RecordPtr>;
 
 #define DEFAULT_ORDER 5
+#define INDEX_FRAME_SIZE 512
+#define INDEX_CACHE_NODES 4096
+
+/**
+ * @brief Reader-writer latch of the B+ tree. A writer closes the gate while it waits for the readers to leave,
+ * so the readers coming after it wait too and a steady stream of readers can't starve it
+*/
+class Latch
+{
+public:
+	void lock()
+	{
+		lock_guard<mutex> gate(fGate);
+		fLatch.lock();
+	}
+
+	void unlock() { fLatch.unlock(); }
+
+	void lock_shared()
+	{
+		lock_guard<mutex> gate(fGate);
+		fLatch.lock_shared();
+	}
+
+	void unlock_shared() { fLatch.unlock_shared(); }
+
+private:
+	mutex fGate;
+	shared_mutex fLatch;
+};
+
+/**
+ * @brief Array of fixed capacity over memory it doesn't own, with the part of the vector interface the nodes use.
+ * The items are constructed when they are added and destroyed when they are removed
+*/
+template<typename T>
+class NodeArray
+{
+public:
+	NodeArray(T* items, size_t capacity) : fItems(items), fSize(0), fCapacity(capacity) {}
+
+	NodeArray(const NodeArray& other) = delete;
+	NodeArray& operator=(const NodeArray& other) = delete;
+
+	~NodeArray() { clear(); }
+
+	size_t size() const { return fSize; }
+	bool empty() const { return fSize == 0; }
+
+	T& operator[](size_t index) { return fItems[index]; }
+	const T& operator[](size_t index) const { return fItems[index]; }
+
+	T* begin() { return fItems; }
+	T* end() { return fItems + fSize; }
+	const T* begin() const { return fItems; }
+	const T* end() const { return fItems + fSize; }
+
+	T& front() { return fItems[0]; }
+	T& back() { return fItems[fSize - 1]; }
+
+	void push_back(const T& item)
+	{
+		if (fSize == fCapacity)
+			throw std::logic_error("Node is full");
+
+		new (fItems + fSize) T(item);
+		fSize++;
+	}
+
+	void pop_back()
+	{
+		fItems[--fSize].~T();
+	}
+
+	T* insert(T* position, const T& item)
+	{
+		size_t index = position - fItems;
+		T copy(item); // item may be one of the shifted items
+		push_back(copy);
+		std::rotate(fItems + index, fItems + fSize - 1, fItems + fSize);
+		return fItems + index;
+	}
+
+	template<typename It>
+	T* insert(T* position, It first, It last)
+	{
+		size_t index = position - fItems;
+		size_t oldSize = fSize;
+		for (; first != last; ++first)
+			push_back(*first);
 
-// BP node
+		std::rotate(fItems + index, fItems + oldSize, fItems + fSize);
+		return fItems + index;
+	}
+
+	T* erase(T* position)
+	{
+		std::move(position + 1, end(), position);
+		pop_back();
+		return position;
+	}
+
+	void clear()
+	{
+		while (fSize > 0)
+			pop_back();
+	}
+
+	template<typename It>
+	void assign(It first, It last)
+	{
+		clear();
+		for (; first != last; ++first)
+			push_back(*first);
+	}
+
+private:
+	T* fItems;
+	size_t fSize;
+	size_t fCapacity;
+};
+
+/**
+ * @brief BP node. A node and its arrays of keys and children are a single block of a NodePool:
+ * [Node][fOrder + 1 keys][fOrder + 1 children], so a node is one allocation and its keys are next to its header.
+ * Nodes are made by create and freed by destroy
+*/
 class Node {
 public:
 	bool fIsLeaf;
 	int fOrder;
-	vector<data> fKeys;
-	vector<Node*> ptr;
+	NodeArray<data> fKeys;
+	NodeArray<size_t> ptr; // ids of the children, the slot after the last key of a leaf holds the next leaf. 0 is no node
+	size_t fPrev; // id of the previous leaf, 0 for the first leaf and for internal nodes
+	std::atomic<size_t> fCount; // number of keys in the node's subtree
+	size_t fId; // id of the node, also its frame in the index file
+	bool fIsDirty; // changed since it was last written to the index file
+	unsigned long long fLastUse;
+	size_t fResidentSlot;
+	Latch fLatch; // held shared while the node is read, exclusively while an insertion changes it
+	unsigned long long fEpoch; // epoch of the tree in which the node was last changed, see BPTree::getSnapshot
+	Node* fOlder; // the version of the node before that change, kept while a snapshot may read it
+	unsigned long long fRetiredAt; // epoch in which the node was removed from the tree while a snapshot could still read it, 0 if it wasn't
 	//friend class BPTree;
 
 public:
-	Node(int order, bool isLeaf) : fIsLeaf(isLeaf), fOrder(order)
+	/**
+	 * @return size of the block of a node of the given order
+	*/
+	static size_t getBlockSize(int order)
 	{
-		for (size_t i = 0; i < order + 1; i++)
-			ptr.push_back(nullptr);
+		return getChildrenOffset(order) + sizeof(size_t) * (order + 1);
+	}
+
+	static Node* create(NodePool& pool, int order, bool isLeaf)
+	{
+		return new (pool.allocate()) Node(order, isLeaf);
+	}
+
+	/**
+	 * @brief Copy a node into a block of the given pool, the pool's blocks must fit the node's order
+	*/
+	static Node* create(NodePool& pool, const Node& other)
+	{
+		Node* node = create(pool, other.fOrder, other.fIsLeaf);
+		node->fKeys.assign(other.fKeys.begin(), other.fKeys.end());
+		std::copy(other.ptr.begin(), other.ptr.end(), node->ptr.begin());
+		node->fPrev = other.fPrev;
+		node->fCount = other.fCount.load();
+		node->fId = other.fId;
+		node->fIsDirty = other.fIsDirty;
+		node->fLastUse = other.fLastUse;
+		node->fResidentSlot = other.fResidentSlot;
+		node->fEpoch = other.fEpoch;
+		return node;
+	}
+
+	static void destroy(NodePool& pool, Node* node)
+	{
+		node->~Node();
+		pool.deallocate(node);
 	}
 
+	Node(const Node& other) = delete;
+	Node& operator=(const Node& other) = delete;
+
 	int keyIndex(const TypeWrapper& key)
 	{
 		for (int i = 0; i < fKeys.size(); i++)
@@ -37,29 +224,61 @@ public:
 
 		return -1;
 	}
+
+private:
+	Node(int order, bool isLeaf) : fIsLeaf(isLeaf), fOrder(order),
+		fKeys((data*)((char*)this + getKeysOffset()), order + 1), ptr((size_t*)((char*)this + getChildrenOffset(order)), order + 1),
+		fPrev(0), fCount(0), fId(0), fIsDirty(true), fLastUse(0), fResidentSlot(0), fEpoch(0), fOlder(nullptr), fRetiredAt(0)
+	{
+		for (size_t i = 0; i < order + 1; i++)
+			ptr.push_back(0);
+	}
+
+	static size_t getKeysOffset()
+	{
+		return NodePool::roundUp(sizeof(Node), alignof(data));
+	}
+
+	static size_t getChildrenOffset(int order)
+	{
+		return NodePool::roundUp(getKeysOffset() + sizeof(data) * (order + 1), alignof(size_t));
+	}
 };
 
-// BP tree
+/**
+ * @brief B+ tree. Nodes refer to each other by id and are reached through a table of the resident nodes, so a tree
+ * kept in an index file (see flush) doesn't have to be in memory as a whole: a node that isn't resident is read from
+ * its frame when it is first needed, and once more than INDEX_CACHE_NODES nodes are resident the least recently used
+ * ones are evicted (a changed node is written to its frame first). Eviction happens only when a public operation starts,
+ * so the nodes an operation works with stay in memory until it returns. A tree without a file keeps all of its nodes.
+ *
+ * Lookups, scans and insertions can run on several threads at once. They share the structure latch and go down the tree
+ * with latch crabbing: the child is latched before the latch of its parent is released. Readers latch the nodes shared.
+ * An insertion latches them exclusively and keeps the latches of the nodes a split may still reach, i.e. it releases
+ * all of them once it latches a node with room for one more key. Removals, flushes and evictions rebalance or drop nodes
+ * anywhere in the tree, so they hold the structure latch exclusively and run alone. Copying, moving and destroying
+ * a tree must not overlap with other operations on it.
+*/
 class BPTree {
 public:
-	BPTree() : root(nullptr), fOrder(DEFAULT_ORDER), fSize(0) {}
+	BPTree() : root(nullptr), fOrder(DEFAULT_ORDER), fSize(0), fNextId(1), fFreeHead(0), fClock(0), fIsFileCurrent(false), fEpoch(1) {}
 
-	BPTree(int order) : root(nullptr), fOrder(order), fSize(0) {}
+	BPTree(int order) : root(nullptr), fOrder(order), fSize(0), fNextId(1), fFreeHead(0), fClock(0), fIsFileCurrent(false), fEpoch(1) {}
 
-	BPTree(const BPTree& other)
+	/**
+	 * @brief Copies the resident nodes, a tree kept in an index file shares the file with its copy
+	*/
+	BPTree(const BPTree& other) : BPTree()
 	{
-		this->root = copy(other.root);
-		this->fOrder = other.fOrder;
-		this->fSize = other.fSize;
+		copy(other);
 	}
 
 	BPTree& operator=(const BPTree& other)
 	{
 		if (this != &other)
 		{
-			clear(root);
-			if (other.fSize != 0)
-				root = copy(other.root);
+			clear();
+			copy(other);
 		}
 
 		return *this;
@@ -67,77 +286,108 @@ public:
 
 	BPTree(BPTree&& other) noexcept : BPTree()
 	{
-		std::swap(fOrder, other.fOrder);
-		std::swap(fSize, other.fSize);
-		std::swap(root, other.root);
+		swap(other);
 	}
 
 	BPTree& operator=(BPTree&& other) noexcept
 	{
 		if (this != &other)
-		{
-			std::swap(fOrder, other.fOrder);
-			std::swap(fSize, other.fSize);
-			std::swap(root, other.root);
-		}
+			swap(other);
 
 		return *this;
 	}
 
-	BPTree(ifstream& in)
+	BPTree(istream& in) : BPTree()
 	{
-		root = nullptr;
+		size_t tmpSize = 0;
 		in.read((char*)&fOrder, sizeof(fOrder));
-		in.read((char*)&fSize, sizeof(fSize));
-		size_t tmpSize = fSize;
+		in.read((char*)&tmpSize, sizeof(tmpSize));
 		for (size_t i = 0; i < tmpSize; i++)
 			this->insert({ TypeWrapper(in), RecordPtr(in) });
 
 		fSize = tmpSize;
 	}
 
-	~BPTree() { clear(root); fSize = 0; }
+	/**
+	 * @brief Open the tree kept in an index file, see flush. Only the root is read, the other nodes are read when needed
+	 * @param file - the index file
+	 * @param lsn - set to the LSN stored with the tree
+	*/
+	BPTree(const shared_ptr<TableSpace>& file, unsigned long long& lsn) : BPTree()
+	{
+		fFile = file;
+		stringstream header(fFile->readFrame(0));
+		size_t rootId = 0, size = 0;
+		header.read((char*)&lsn, sizeof(lsn));
+		header.read((char*)&fOrder, sizeof(fOrder));
+		header.read((char*)&size, sizeof(size));
+		header.read((char*)&rootId, sizeof(rootId));
+		header.read((char*)&fNextId, sizeof(fNextId));
+		header.read((char*)&fFreeHead, sizeof(fFreeHead));
+		unsigned int format = 0;
+		header.read((char*)&format, sizeof(format));
+		if (!header || format != INDEX_FILE_FORMAT || fNextId > (size_t)fFile->getFramesCount() || rootId >= fNextId || fFreeHead >= fNextId)
+			throw std::logic_error("Index file " + fFile->getPath() + " is corrupted");
+
+		fSize = size;
+		fIsFileCurrent = true;
+		root = getNode(rootId);
+	}
 
-	RecordPtr getRecordAtIndex(const TypeWrapper& key)
+	~BPTree() { clear(); }
+
+	RecordPtr getRecordAtIndex(const TypeWrapper& key) const
 	{
-		Node* target = search(key);
-		return target->fKeys[target->keyIndex(key)].second;
+		RecordPtr ptr;
+		find(key, ptr);
+		return ptr;
 	}
 
 	/**
-	 * @brief Searches the tree for given key
+	 * @brief Searches the tree for given key. The node isn't latched once this returns, so it is only safe to use
+	 * while no insertion or removal runs next to it, see find
 	 * @param key - key to be searched for
 	 * @return the node containing the key, nullptr otherwise
 	*/
 	Node* search(const TypeWrapper& key)
 	{
-		if (root == nullptr)
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		Node* leaf = descendShared([&](Node* node) { return childIndex(node, key); });
+		if (!leaf)
 			return nullptr;
 
-		Node* cursor = root;
-		while (cursor->fIsLeaf == false)
-		{
-			for (int i = 0; i < cursor->fKeys.size(); i++)
-			{
-				if (key < cursor->fKeys[i].first)
-				{
-					cursor = cursor->ptr[i];
-					break;
-				}
-
-				if (i == cursor->fKeys.size() - 1)
-				{
-					cursor = cursor->ptr[i + 1];
-					break;
-				}
-			}
-		}
+		bool found = leaf->keyIndex(key) != -1;
+		leaf->fLatch.unlock_shared();
+		return found ? leaf : nullptr;
+	}
 
-		for (int i = 0; i < cursor->fKeys.size(); i++)
-			if (cursor->fKeys[i].first == key)
-				return cursor;
+	/**
+	 * @brief Look up a key
+	 * @param key - key to be searched for
+	 * @param ptr - set to the pointer of the key's record if the key is found
+	 * @return True if the key is in the tree, false otherwise
+	*/
+	bool find(const TypeWrapper& key, RecordPtr& ptr) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		Node* leaf = descendShared([&](Node* node) { return childIndex(node, key); });
+		if (!leaf)
+			return false;
+
+		int index = leaf->keyIndex(key);
+		if (index != -1)
+			ptr = leaf->fKeys[index].second;
+
+		leaf->fLatch.unlock_shared();
+		return index != -1;
+	}
 
-		return nullptr;
+	bool contains(const TypeWrapper& key) const
+	{
+		RecordPtr ptr;
+		return find(key, ptr);
 	}
 
 	/**
@@ -150,32 +400,47 @@ public:
 	*/
 	void insert(data kvp)
 	{
+		trim();
+		shared_lock<Latch> structureLock(fStructureLatch);
+		unique_lock<Latch> rootLock(fRootLatch);
 		if (root == nullptr)
 		{
-			root = new Node(fOrder, true);
+			root = createNode(true);
 			root->fKeys.push_back(kvp);
+			root->fCount = 1;
+			fSize++;
+			return;
 		}
-		else
+
+		// The latched nodes, from the topmost one a split may reach down to the leaf. Every node on the way
+		// counts the new key while it is latched, so an unlatched node's count always matches its children
+		vector<Node*> path;
+		Node* cursor = root;
+		cursor->fLatch.lock();
+		path.push_back(cursor);
+		try
 		{
-			Node* cursor = root;
-			Node* parent = nullptr;
-			while (cursor->fIsLeaf == false)
+			while (true)
 			{
-				parent = cursor;
-				for (int i = 0; i < cursor->fKeys.size(); i++)
+				prepareWrite(cursor);
+				cursor->fCount++;
+				markDirty(cursor);
+				if (cursor->fKeys.size() < fOrder)
 				{
-					if (kvp.first < cursor->fKeys[i].first)
-					{
-						cursor = cursor->ptr[i];
-						break;
-					}
+					for (size_t i = 0; i + 1 < path.size(); i++)
+						path[i]->fLatch.unlock();
 
-					if (i == cursor->fKeys.size() - 1)
-					{
-						cursor = cursor->ptr[i + 1];
-						break;
-					}
+					path.erase(path.begin(), path.end() - 1);
+					if (rootLock.owns_lock())
+						rootLock.unlock();
 				}
+
+				if (cursor->fIsLeaf)
+					break;
+
+				cursor = child(cursor, childIndex(cursor, kvp.first));
+				cursor->fLatch.lock();
+				path.push_back(cursor);
 			}
 
 			if (cursor->fKeys.size() < fOrder)
@@ -186,26 +451,39 @@ public:
 
 				cursor->fKeys.insert(cursor->fKeys.begin() + pos, kvp);
 				cursor->ptr[cursor->fKeys.size()] = cursor->ptr[cursor->fKeys.size() - 1];
-				cursor->ptr[cursor->fKeys.size() - 1] = nullptr;
+				cursor->ptr[cursor->fKeys.size() - 1] = 0;
 			}
 			else
 			{
 				Node* newLeaf = splitNode(cursor, kvp);
 
-				if (cursor == root)
+				// The topmost latched node never splits unless it is the root
+				if (cursor == path.front())
 				{
-					Node* newRoot = new Node(fOrder, false);
-					newRoot->fKeys.push_back(newLeaf->fKeys.front());
-					newRoot->ptr[0] = cursor;
-					newRoot->ptr[1] = newLeaf;
+					Node* newRoot = createNode(false);
+					newRoot->fKeys.push_back(getSeparator(cursor->fKeys.back(), newLeaf->fKeys.front()));
+					newRoot->ptr[0] = cursor->fId;
+					newRoot->ptr[1] = newLeaf->fId;
+					recount(newRoot);
 					root = newRoot;
 				}
 				else
 				{
-					insertInternal(newLeaf->fKeys[0], parent, newLeaf);
+					insertInternal(getSeparator(cursor->fKeys.back(), newLeaf->fKeys.front()), findParent(cursor, path), newLeaf, path);
 				}
 			}
 		}
+		catch (...)
+		{
+			for (Node* node : path)
+				node->fLatch.unlock();
+
+			throw;
+		}
+
+		for (Node* node : path)
+			node->fLatch.unlock();
+
 		fSize++;
 	}
 
@@ -222,150 +500,47 @@ public:
 	*/
 	void remove(const TypeWrapper& key)
 	{
-		if (!root)
-			return;
-
-		Node* cursor = root;
-		Node* parent = nullptr;
-		int leftSibling, rightSibling;
-		// find the leaf node containing the kvp
-		while (!cursor->fIsLeaf)
-		{
-			for (int i = 0; i < cursor->fKeys.size(); i++)
-			{
-				parent = cursor;
-				leftSibling = i - 1;
-				rightSibling = i + 1;
-				if (key < cursor->fKeys[i].first)
-				{
-					cursor = cursor->ptr[i];
-					break;
-				}
-
-				if (i == cursor->fKeys.size() - 1)
-				{
-					leftSibling = i;
-					rightSibling = i + 2;
-					cursor = cursor->ptr[i + 1];
-					break;
-				}
-			}
-		}
-
-		// in the node, find the kvp, if it exists
-		bool found = false;
-		int pos;
-		for (pos = 0; pos < cursor->fKeys.size(); pos++)
-		{
-			if (cursor->fKeys[pos].first == key)
-			{
-				found = true;
-				break;
-			}
-		}
-
-		if (!found)
-			return;
-
-		// erase the key from the node's keys
-		cursor->fKeys.erase(cursor->fKeys.begin() + pos);
-		fSize--;
+		trim();
+		unique_lock<Latch> lock(fStructureLatch);
+		removeKey(key);
+	}
 
-		// in case we are deleting the only element in the tree, just delete the tree itself
-		if (cursor == root)
+	/**
+	 * @brief Remove a batch of keys from the tree
+	 * @param keys - keys to be removed, keys that are not in the tree are skipped
+	*/
+	void remove(const vector<TypeWrapper>& keys)
+	{
+		trim();
+		unique_lock<Latch> lock(fStructureLatch);
+		if (fSize > 0 && keys.size() >= fSize && fSnapshots.empty())
 		{
-			for (int i = 0; i < fOrder + 1; i++)
-				cursor->ptr[i] = nullptr;
-
-			if (cursor->fKeys.size() == 0)
-			{
-				delete cursor;
-				root = nullptr;
-			}
-
-			return;
-		}
-
-		// adjust the child pointers after deleting the element
-		cursor->ptr[cursor->fKeys.size()] = cursor->ptr[cursor->fKeys.size() + 1];
-		cursor->ptr[cursor->fKeys.size() + 1] = nullptr;
+			// Removing every key of the tree, dropping the nodes is cheaper than rebalancing after each key.
+			// Not while a snapshot is open, it may still read the nodes. A key given more than once is counted once
+			vector<const TypeWrapper*> distinct;
+			for (const TypeWrapper& key : keys)
+				distinct.push_back(&key);
 
-		if (cursor->fKeys.size() >= (fOrder + 1) / 2 - 1 /*delete -1*/)
-		{
-			deleteIndex(key, parent);
-			return;
-		}
+			std::sort(distinct.begin(), distinct.end(), [](const TypeWrapper* a, const TypeWrapper* b) { return *a < *b; });
+			distinct.erase(std::unique(distinct.begin(), distinct.end(), [](const TypeWrapper* a, const TypeWrapper* b) { return *a == *b; }), distinct.end());
 
-		// Borrow
-		if (leftSibling >= 0)
-		{
-			Node* leftNode = parent->ptr[leftSibling];
-			if (leftNode->fKeys.size() >= (fOrder + 1) / 2 /*+ 1*/)
+			size_t found = 0;
+			for (const TypeWrapper* key : distinct)
 			{
-				// take the last element from left sibling and insert it in cursor's start + readjust pointer to point to next leaf
-				cursor->fKeys.insert(cursor->fKeys.begin(), leftNode->fKeys.back());
-				cursor->ptr[cursor->fKeys.size()] = cursor->ptr[cursor->fKeys.size() - 1];
-				cursor->ptr[cursor->fKeys.size() - 1] = nullptr;
-
-				// after inserting last el. from leftSibling in cursor, erase it from left sibl. and readjust pointers
-				leftNode->fKeys.erase(leftNode->fKeys.end() - 1);
-				leftNode->ptr[leftNode->fKeys.size()] = cursor;
-				leftNode->ptr[leftNode->fKeys.size() + 1] = nullptr;
-				parent->fKeys[leftSibling] = cursor->fKeys[0];
-				deleteIndex(key, parent);
-				return;
+				Node* leaf = findLeaf(*key);
+				if (leaf && leaf->keyIndex(*key) != -1)
+					found++;
 			}
-		}
 
-		//Borrow
-		if (rightSibling <= parent->fKeys.size())
-		{
-			Node* rightNode = parent->ptr[rightSibling];
-			if (rightNode->fKeys.size() >= (fOrder + 1) / 2 /*+ 1*/)
+			if (found == fSize)
 			{
-				// Borrow key from right sibling and readjust pointers
-				cursor->fKeys.push_back(rightNode->fKeys[0]);
-				cursor->ptr[cursor->fKeys.size()] = cursor->ptr[cursor->fKeys.size() - 1];
-				cursor->ptr[cursor->fKeys.size() - 1] = nullptr;
-
-				// Erase the borrowed element and readjust nodes
-				rightNode->fKeys.erase(rightNode->fKeys.begin());
-				rightNode->ptr[rightNode->fKeys.size()] = rightNode->ptr[rightNode->fKeys.size() + 1];
-				rightNode->ptr[rightNode->fKeys.size() + 1] = nullptr;
-				parent->fKeys[rightSibling - 1] = rightNode->fKeys[0]; // to fulfil the properties for b+tree, we take the smallest element
-																	   // from the right sibling and put it in the parent's keys
-				deleteIndex(key, parent);
+				clear();
 				return;
 			}
 		}
 
-		// Merges
-		if (leftSibling >= 0)
-		{
-			Node* leftNode = parent->ptr[leftSibling];
-			leftNode->ptr[leftNode->fKeys.size()] = nullptr;
-			for (int j = 0; j < cursor->fKeys.size(); j++)
-				leftNode->fKeys.push_back(cursor->fKeys[j]);
-
-			leftNode->ptr[leftNode->fKeys.size()] = cursor->ptr[cursor->fKeys.size()];
-			// Merging two leaf nodes
-			removeInternal(parent->fKeys[leftSibling].first, parent, cursor);
-			delete cursor;
-		}
-		else if (rightSibling <= parent->fKeys.size())
-		{
-			Node* rightNode = parent->ptr[rightSibling];
-			cursor->ptr[cursor->fKeys.size()] = nullptr;
-			for (int i = cursor->fKeys.size(), j = 0; j < rightNode->fKeys.size(); i++, j++)
-				cursor->fKeys.insert(cursor->fKeys.begin() + i, rightNode->fKeys[j]);
-
-			cursor->ptr[cursor->fKeys.size()] = rightNode->ptr[rightNode->fKeys.size()];
-			// Merging two leaf nodes
-			removeInternal(parent->fKeys[rightSibling - 1].first, parent, rightNode);
-			delete rightNode;
-		}
-
-		deleteIndex(key, parent);
+		for (const TypeWrapper& key : keys)
+			removeKey(key);
 	}
 
 	/**
@@ -374,22 +549,11 @@ public:
 	vector<RecordPtr> getAllRecordPtrsExcept(const TypeWrapper& except)
 	{
 		vector<RecordPtr> answer;
-		Node* cursor = root;
-		while (cursor && !cursor->fIsLeaf)
-			cursor = cursor->ptr[0];
-
-		while (cursor)
-		{
-			for (int i = 0; i < cursor->fKeys.size(); i++)
+		forEachInRange(nullptr, false, nullptr, false, [&](const data& entry)
 			{
-				if (cursor->fKeys[i].first == except)
-					continue;
-
-				answer.push_back(cursor->fKeys[i].second);
-			}
-
-			cursor = cursor->ptr[cursor->fKeys.size()];
-		}
+				if (!(entry.first == except))
+					answer.push_back(entry.second);
+			});
 
 		return answer;
 	}
@@ -399,141 +563,1415 @@ public:
 	*/
 	vector<RecordPtr> getRecordPtrsGreaterThan(const TypeWrapper& what, bool orEqual)
 	{
-		vector<RecordPtr> answer;
-		Node* cursor = root;
-		while (cursor && !cursor->fIsLeaf)
-		{
-			for (size_t i = 0; i < cursor->fKeys.size(); i++)
-			{
-				if (cursor->fKeys[i].first > what)
+		return getRecordPtrsInRange(&what, orEqual, nullptr, false);
+	}
+
+	/**
+	 * @brief  < or <=
+	*/
+	vector<RecordPtr> getRecordPtrsLessThan(const TypeWrapper& what, bool orEqual)
+	{
+		return getRecordPtrsInRange(nullptr, false, &what, orEqual);
+	}
+
+	/**
+	 * @brief Get the pointers of all keys between two bounds, in ascending key order. The search descends
+	 * to the first leaf that may hold a key not less than the lower bound and walks the leaves until
+	 * a key passes the upper bound. Bounds are compared with the keys' own operators, so a composite key
+	 * bound holding only a prefix of the columns covers every key starting with that prefix.
+	 * @param lower - lower bound, nullptr for none
+	 * @param lowerInclusive - whether keys equal to the lower bound are included
+	 * @param upper - upper bound, nullptr for none
+	 * @param upperInclusive - whether keys equal to the upper bound are included
+	 * @return array of record pointers of the keys in the range
+	*/
+	vector<RecordPtr> getRecordPtrsInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive)
+	{
+		vector<RecordPtr> answer;
+		forEachInRange(lower, lowerInclusive, upper, upperInclusive, [&](const data& entry) { answer.push_back(entry.second); });
+		return answer;
+	}
+
+	/**
+	 * @brief Visit every key-pointer pair between two bounds in ascending key order, see getRecordPtrsInRange.
+	 * The leaves are walked with latch crabbing, the visited leaf stays latched while visit runs, so visit must not use the tree
+	 * @param visit - function called with every pair in the range
+	*/
+	void forEachInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<void(const data&)>& visit)
+	{
+		TypeWrapper resumeAfter;
+		while (true)
+		{
+			trim();
+			shared_lock<Latch> lock(fStructureLatch);
+			const TypeWrapper* from = resumeAfter.getContent() ? &resumeAfter : lower;
+			Node* cursor = descendShared([&](Node* node)
+				{
+					// Keys left of a separator are smaller than it, so that subtree is skipped only if the separator is below the bound
+					size_t i = 0;
+					if (from)
+						while (i < node->fKeys.size() && node->fKeys[i].first < *from)
+							i++;
+
+					return i;
+				});
+
+			bool isPastResume = false;
+			while (cursor)
+			{
+				for (size_t i = 0; i < cursor->fKeys.size(); i++)
+				{
+					const TypeWrapper& key = cursor->fKeys[i].first;
+					if (upper && (key > *upper || (!upperInclusive && key == *upper)))
+					{
+						cursor->fLatch.unlock_shared();
+						return;
+					}
+
+					bool aboveLower = !lower || key > *lower || (lowerInclusive && key == *lower);
+					bool belowUpper = !upper || key < *upper || (upperInclusive && key == *upper);
+					bool notVisited = !resumeAfter.getContent() || key > resumeAfter;
+					isPastResume = isPastResume || notVisited;
+					if (aboveLower && belowUpper && notVisited)
+						visit(cursor->fKeys[i]);
+				}
+
+				// A long scan doesn't hold more than the cache: once it is full the scan lets go of the tree, so the leaves it
+				// left can be evicted, and goes on after the last key it has seen. It lets go only after it got past the
+				// previous stop, so it moves forward even if the descent alone fills the cache
+				if (isPastResume && isCacheFull())
+				{
+					resumeAfter = cursor->fKeys.back().first;
+					cursor->fLatch.unlock_shared();
+					break;
+				}
+
+				Node* next = getNode(cursor->ptr[cursor->fKeys.size()]);
+				if (next)
+					next->fLatch.lock_shared();
+
+				cursor->fLatch.unlock_shared();
+				cursor = next;
+			}
+
+			if (!cursor)
+				return;
+		}
+	}
+
+	/**
+	 * @brief Visit every key-pointer pair between two bounds in descending key order, see getRecordPtrsInRange.
+	 * The search descends to the last leaf that may hold a key not greater than the upper bound and walks the leaves
+	 * back through their links to the previous leaf. The visited leaf stays latched while visit runs, so visit must not use the tree
+	 * @param visit - function called with every pair in the range, returns false to stop the scan
+	*/
+	void forEachInRangeReverse(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<bool(const data&)>& visit)
+	{
+		TypeWrapper resumeBefore;
+		while (true)
+		{
+			trim();
+			shared_lock<Latch> lock(fStructureLatch);
+			const TypeWrapper* from = resumeBefore.getContent() ? &resumeBefore : upper;
+			Node* cursor = descendShared([&](Node* node)
+				{
+					// Keys right of a separator are not smaller than it, so that subtree is skipped only if the separator is above the bound
+					size_t i = 0;
+					while (i < node->fKeys.size() && !(from && *from < node->fKeys[i].first))
+						i++;
+
+					return i;
+				});
+
+			bool isPastResume = false;
+			while (cursor)
+			{
+				for (size_t i = cursor->fKeys.size(); i-- > 0;)
+				{
+					const TypeWrapper& key = cursor->fKeys[i].first;
+					if (lower && (key < *lower || (!lowerInclusive && key == *lower)))
+					{
+						cursor->fLatch.unlock_shared();
+						return;
+					}
+
+					bool belowUpper = !upper || key < *upper || (upperInclusive && key == *upper);
+					bool notVisited = !resumeBefore.getContent() || key < resumeBefore;
+					isPastResume = isPastResume || notVisited;
+					if (belowUpper && notVisited && !visit(cursor->fKeys[i]))
+					{
+						cursor->fLatch.unlock_shared();
+						return;
+					}
+				}
+
+				// An insertion latches a leaf and then the next one, so the previous leaf can't be latched while this one is held.
+				// The scan lets go of the leaf first and checks that the previous one still links to it, a split of the
+				// previous leaf may have put a new leaf in between. Then, or once the cache is full, it descends again
+				size_t id = cursor->fId, prevId = cursor->fPrev;
+				if (!cursor->fKeys.empty())
+					resumeBefore = cursor->fKeys.front().first;
+
+				cursor->fLatch.unlock_shared();
+				if (prevId == 0)
+					return;
+
+				if (isPastResume && isCacheFull())
+					break;
+
+				Node* prev = getNode(prevId);
+				prev->fLatch.lock_shared();
+				if (prev->ptr[prev->fKeys.size()] != id)
+				{
+					prev->fLatch.unlock_shared();
+					break;
+				}
+
+				cursor = prev;
+			}
+
+			if (!cursor)
+				return;
+		}
+	}
+
+	/**
+	 * @brief Read-only view of the tree as it was when the snapshot was taken, see getSnapshot. Closed when destroyed
+	*/
+	class Snapshot
+	{
+	public:
+		Snapshot(Snapshot&& other) noexcept : fTree(other.fTree), fEpoch(other.fEpoch), fRootId(other.fRootId), fSize(other.fSize)
+		{
+			other.fTree = nullptr;
+		}
+
+		Snapshot(const Snapshot& other) = delete;
+		Snapshot& operator=(const Snapshot& other) = delete;
+
+		~Snapshot()
+		{
+			if (fTree)
+				fTree->closeSnapshot(fEpoch);
+		}
+
+		/**
+		 * @return the number of keys the tree had when the snapshot was taken
+		*/
+		size_t size() const { return fSize; }
+
+		/**
+		 * @brief Visit every key-pointer pair of the snapshot between two bounds in ascending key order,
+		 * see BPTree::forEachInRange. Insertions and removals made meanwhile aren't seen
+		*/
+		void forEachInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+			const std::function<void(const data&)>& visit) const
+		{
+			fTree->forEachInSnapshot(*this, lower, lowerInclusive, upper, upperInclusive, visit);
+		}
+
+		/**
+		 * @brief Visit every key-pointer pair of the snapshot between two bounds in descending key order,
+		 * see BPTree::forEachInRangeReverse
+		 * @param visit - function called with every pair in the range, returns false to stop the scan
+		*/
+		void forEachInRangeReverse(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+			const std::function<bool(const data&)>& visit) const
+		{
+			fTree->forEachInSnapshotReverse(*this, lower, lowerInclusive, upper, upperInclusive, visit);
+		}
+
+		/**
+		 * @brief Get the pointers of the snapshot's keys between two bounds, in ascending key order
+		*/
+		vector<RecordPtr> getRecordPtrsInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive) const
+		{
+			vector<RecordPtr> answer;
+			forEachInRange(lower, lowerInclusive, upper, upperInclusive, [&](const data& entry) { answer.push_back(entry.second); });
+			return answer;
+		}
+
+	private:
+		friend class BPTree;
+
+		Snapshot(BPTree* tree, unsigned long long epoch, size_t rootId, size_t size) : fTree(tree), fEpoch(epoch), fRootId(rootId), fSize(size) {}
+
+		BPTree* fTree;
+		unsigned long long fEpoch;
+		size_t fRootId;
+		size_t fSize;
+	};
+
+	/**
+	 * @brief Take a snapshot of the tree, for long scans that have to see a single state of it. The tree is copy-on-write
+	 * while a snapshot is open: a node changed for the first time after the snapshot was taken keeps its previous version
+	 * for the snapshot and a removed node stays until no snapshot can read it, so insertions and removals go on while
+	 * the snapshot is read. Taking the snapshot waits for the running insertions, reading it blocks nothing but removals,
+	 * flushes and evictions working on the same node. The snapshot has to be closed before the tree is copied, moved or cleared
+	 * @return the snapshot
+	*/
+	Snapshot getSnapshot()
+	{
+		trim();
+		unique_lock<Latch> lock(fStructureLatch);
+		unsigned long long epoch = fEpoch++;
+		fSnapshots.insert(epoch);
+		return Snapshot(this, epoch, root ? root->fId : 0, fSize);
+	}
+
+	/**
+	 * @brief Count the keys between two bounds in O(log n), without visiting the leaves in between.
+	 * Every node knows the number of keys in its subtree, so the number of keys below a bound is summed up
+	 * during a single descent: all subtrees left of the followed child are counted whole
+	 * @param lower - lower bound, nullptr for none
+	 * @param lowerInclusive - whether keys equal to the lower bound are counted
+	 * @param upper - upper bound, nullptr for none
+	 * @param upperInclusive - whether keys equal to the upper bound are counted
+	 * @return the number of keys in the range
+	*/
+	size_t countInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		size_t begin, end;
+		getRankRange(lower, lowerInclusive, upper, upperInclusive, begin, end);
+		return end - begin;
+	}
+
+	/**
+	 * @brief Find the smallest key between two bounds in O(log n), see countInRange
+	 * @param entry - set to the key-pointer pair of the smallest key in the range, if there is one
+	 * @return True if the range holds a key, false otherwise
+	*/
+	bool getFirstInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive, data& entry) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		size_t begin, end;
+		getRankRange(lower, lowerInclusive, upper, upperInclusive, begin, end);
+		if (begin == end)
+			return false;
+
+		entry = getAtLatched(begin);
+		return true;
+	}
+
+	/**
+	 * @brief Find the greatest key between two bounds in O(log n), see countInRange
+	 * @param entry - set to the key-pointer pair of the greatest key in the range, if there is one
+	 * @return True if the range holds a key, false otherwise
+	*/
+	bool getLastInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive, data& entry) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		size_t begin, end;
+		getRankRange(lower, lowerInclusive, upper, upperInclusive, begin, end);
+		if (begin == end)
+			return false;
+
+		entry = getAtLatched(end - 1);
+		return true;
+	}
+
+	/**
+	 * @brief Find the key at a given position inside the range between two bounds in O(log n), see countInRange.
+	 * Used to skip the first records of a page of an ordered answer (OFFSET) and to pick percentiles without visiting the leaves
+	 * @param position - position of the key in the range, 0 is its smallest key (or its greatest if fromLast is True)
+	 * @param fromLast - if True the positions are counted from the greatest key down
+	 * @param entry - set to the key-pointer pair at the position, if the range holds that many keys
+	 * @return True if the range holds more than position keys, false otherwise
+	*/
+	bool getNthInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive, size_t position, bool fromLast,
+		data& entry) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		size_t begin, end;
+		getRankRange(lower, lowerInclusive, upper, upperInclusive, begin, end);
+		if (position >= end - begin)
+			return false;
+
+		entry = getAtLatched(fromLast ? end - 1 - position : begin + position);
+		return true;
+	}
+
+	/**
+	 * @param key - a key, not necessarily in the tree
+	 * @return the number of keys smaller than the given one, found in O(log n) like countInRange
+	*/
+	size_t rank(const TypeWrapper& key) const
+	{
+		return countInRange(nullptr, false, &key, false);
+	}
+
+	/**
+	 * @brief Get the key with the given position in ascending key order, found in O(log n) with the subtree counts
+	 * @param index - position of the key, 0 is the smallest key
+	 * @return the key-pointer pair at the position
+	*/
+	data getAt(size_t index) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		if (index >= fSize)
+			throw std::out_of_range("Index of key is out of the tree's range");
+
+		return getAtLatched(index);
+	}
+
+	/**
+	 * @brief By given query with primary key get all the records satisfying its criteria
+	 * @param query - data base query to check against tree's records
+	 * @return array of record pointers that satisfy the criteria
+	*/
+	vector<RecordPtr> getRecordsFromQuery(InternalQuery& query)
+	{
+		if (!query.isPrimaryKeyQuery())
+			throw invalid_argument("Cannot select/remove items from tree without primary index");
+
+		return getRecordPtrs(query.getOperator(), query.getValue());
+	}
+
+	/**
+	 * @brief Get the pointers of all keys satisfying {key} {op} {value}, in ascending key order
+	 * @param op - comparison operator
+	 * @param value - value the keys are compared against
+	 * @return array of record pointers that satisfy the criteria
+	*/
+	vector<RecordPtr> getRecordPtrs(Operator op, const TypeWrapper& value)
+	{
+		vector<RecordPtr> answer;
+		if (op == Operator::EQUAL)
+		{
+			RecordPtr ptr;
+			if (find(value, ptr))
+				answer.push_back(ptr);
+		}
+		else if (op == Operator::NOT_EQUAL)
+		{
+			answer = getAllRecordPtrsExcept(value);
+		}
+		else if (op == Operator::GREATER_THAN)
+		{
+			answer = getRecordPtrsGreaterThan(value, false);
+		}
+		else if (op == Operator::GREATER_THAN_OR_EQUAL)
+		{
+			answer = getRecordPtrsGreaterThan(value, true);
+		}
+		else if (op == Operator::LESS_THAN)
+		{
+			answer = getRecordPtrsLessThan(value, false);
+		}
+		else if (op == Operator::LESS_THAN_OR_EQUAL)
+		{
+			answer = getRecordPtrsLessThan(value, true);
+		}
+
+		return answer;
+	}
+
+	Node* getRoot()
+	{
+		return root;
+	}
+
+	size_t size() const { return this->fSize; }
+
+	/**
+	 * @brief Write the tree to file, just the elements in ascending order
+	 * @param out - output stream
+	*/
+	void write(ostream& out)
+	{
+		unique_lock<Latch> lock(fStructureLatch);
+		size_t size = fSize;
+		out.write((char*)&fOrder, sizeof(fOrder));
+		out.write((char*)&size, sizeof(size));
+		writeRec(root, out);
+	}
+
+	/**
+	 * @brief Write the nodes changed since the last flush to the index file, each node in its own frame, so a change
+	 * costs the few nodes it touched instead of the whole tree. A tree that isn't kept in the file yet is moved to it.
+	 * Frame 0 holds the header: [LSN][order][size][root's id][next unused id][first free frame][format]
+	 * Node frame layout: [kind][number of keys][keys with their pointers][next and previous leaf | children's ids and the subtree count]
+	 * A free frame holds the next free frame, so the free frames form a list.
+	 *
+	 * The nodes are written in place, so before the first frame is written after a flush (by a flush or by an eviction)
+	 * the header is marked as unfinished and synced, and it gets the LSN only after all nodes are on the disk.
+	 * A tree opened with another LSN than expected has been interrupted while writing and has to be rebuilt
+	 * @param file - the index file
+	 * @param lsn - LSN of the last change the tree holds
+	*/
+	void flush(const shared_ptr<TableSpace>& file, unsigned long long lsn)
+	{
+		unique_lock<Latch> structureLock(fStructureLatch);
+		if (fFile && fFile != file)
+			throw std::logic_error("The tree is kept in another index file than " + file->getPath());
+
+		if (!fFile)
+		{
+			// The nodes of a tree built in memory are all new, the frames already in the file are overwritten
+			lock_guard<mutex> cacheLock(fCacheLock);
+			fFile = file;
+			fFreeHead = 0;
+			fIsFileCurrent = true;
+		}
+
+		for (Node* node : fResident)
+			if (node->fIsDirty && node->fRetiredAt == 0)
+				writeNode(node);
+
+		for (size_t id : fFreeIds)
+		{
+			stringstream out;
+			char kind = FREE_FRAME;
+			out.write(&kind, sizeof(kind));
+			out.write((char*)&fFreeHead, sizeof(fFreeHead));
+			writeFrame(id, out.str());
+			fFreeHead = id;
+		}
+
+		fFreeIds.clear();
+		if (!fIsFileCurrent)
+			fFile->sync();
+
+		writeHeader(lsn);
+		fFile->sync();
+		fIsFileCurrent = true;
+	}
+
+	static constexpr unsigned long long UNFINISHED_LSN = ~0ull;
+
+private:
+	int fOrder;
+	std::atomic<size_t> fSize;
+	Node* root;
+	size_t fNextId;
+	vector<size_t> fFreeIds;
+	size_t fFreeHead;
+	shared_ptr<TableSpace> fFile;
+	mutable vector<Node*> fNodes; // resident nodes by id
+	mutable vector<Node*> fResident;
+	mutable unsigned long long fClock;
+	mutable bool fIsFileCurrent; // the file holds the tree of its header's LSN, nothing was written since
+	mutable std::unique_ptr<NodePool> fPool; // blocks of the nodes, made for fOrder when the first node is
+	mutable Latch fStructureLatch; // shared by lookups, scans and insertions, exclusive for everything else
+	mutable Latch fRootLatch; // guards the root pointer, the topmost latch of every descent
+	mutable mutex fCacheLock; // guards the resident nodes, the pool, the ids and the clock
+	mutable unsigned long long fEpoch; // nodes changed from now on are changed in this epoch, a snapshot starts a new one
+	mutable std::multiset<unsigned long long> fSnapshots; // epochs of the open snapshots
+	mutable vector<Node*> fVersioned; // nodes with older versions or retired, see prune
+
+	static constexpr char LEAF_FRAME = 'L';
+	static constexpr char INTERNAL_FRAME = 'I';
+	static constexpr char FREE_FRAME = 'F';
+	static constexpr char PREFIXED_LEAF_FRAME = 'l'; // nodes of string keys, each key stored without the prefix shared with the previous one
+	static constexpr char PREFIXED_INTERNAL_FRAME = 'i';
+	static constexpr unsigned int INDEX_FILE_FORMAT = 2; // changed with the frame layout, a file of another format is rebuilt
+
+	void swap(BPTree& other) noexcept
+	{
+		std::swap(fOrder, other.fOrder);
+		fSize = other.fSize.exchange(fSize);
+		std::swap(root, other.root);
+		std::swap(fNextId, other.fNextId);
+		std::swap(fFreeIds, other.fFreeIds);
+		std::swap(fFreeHead, other.fFreeHead);
+		std::swap(fFile, other.fFile);
+		std::swap(fNodes, other.fNodes);
+		std::swap(fResident, other.fResident);
+		std::swap(fPool, other.fPool);
+		std::swap(fEpoch, other.fEpoch);
+		std::swap(fSnapshots, other.fSnapshots);
+		std::swap(fVersioned, other.fVersioned);
+		std::swap(fClock, other.fClock);
+		std::swap(fIsFileCurrent, other.fIsFileCurrent);
+	}
+
+	void copy(const BPTree& other)
+	{
+		fOrder = other.fOrder;
+		fSize = other.fSize.load();
+		fNextId = other.fNextId;
+		fFreeIds = other.fFreeIds;
+		fFreeHead = other.fFreeHead;
+		fFile = other.fFile;
+		fIsFileCurrent = other.fIsFileCurrent;
+		fEpoch = other.fEpoch;
+		fNodes.assign(other.fNodes.size(), nullptr);
+		for (Node* node : other.fResident)
+			addResident(Node::create(getPool(), *node));
+
+		root = other.root ? fNodes[other.root->fId] : nullptr;
+	}
+
+	/**
+	 * @brief Delete every node held in memory and forget the nodes in the file, the tree is empty afterwards.
+	 * The blocks of the nodes aren't given back one by one, the pool frees all of its slabs at once
+	*/
+	void clear()
+	{
+		lock_guard<mutex> lock(fCacheLock);
+		for (Node* node : fResident)
+		{
+			for (Node* version = node->fOlder; version; )
+			{
+				Node* older = version->fOlder;
+				version->~Node();
+				version = older;
+			}
+
+			node->~Node();
+		}
+
+		fPool.reset();
+		fVersioned.clear();
+		fSnapshots.clear();
+		fResident.clear();
+		fNodes.clear();
+		fFreeIds.clear();
+		root = nullptr;
+		fSize = 0;
+		fNextId = 1;
+		fFreeHead = 0;
+	}
+
+	/**
+	 * @brief Get a node by its id, reading it from the index file if it isn't in memory
+	 * @param id - id of the node, 0 for none
+	 * @return the node, nullptr for id 0
+	*/
+	Node* getNode(size_t id) const
+	{
+		if (id == 0)
+			return nullptr;
+
+		lock_guard<mutex> lock(fCacheLock);
+		Node* node = id < fNodes.size() ? fNodes[id] : nullptr;
+		if (!node)
+			node = readNode(id);
+
+		node->fLastUse = ++fClock;
+		return node;
+	}
+
+	Node* child(Node* node, size_t index) const
+	{
+		return getNode(node->ptr[index]);
+	}
+
+	/**
+	 * @return the index of the child whose subtree holds the given key
+	*/
+	size_t childIndex(Node* node, const TypeWrapper& key) const
+	{
+		size_t i = 0;
+		while (i < node->fKeys.size() && !(key < node->fKeys[i].first))
+			i++;
+
+		return i;
+	}
+
+	/**
+	 * @brief Go down from the root to a leaf with latch crabbing, every node is latched shared before its parent is released.
+	 * The structure latch has to be held
+	 * @param next - gives the index of the child to follow in an internal node
+	 * @return the leaf, latched shared, nullptr for an empty tree
+	*/
+	Node* descendShared(const std::function<size_t(Node*)>& next) const
+	{
+		shared_lock<Latch> rootLock(fRootLatch);
+		Node* cursor = root;
+		if (!cursor)
+			return nullptr;
+
+		cursor->fLatch.lock_shared();
+		rootLock.unlock();
+		try
+		{
+			while (!cursor->fIsLeaf)
+			{
+				Node* nextNode = child(cursor, next(cursor));
+				nextNode->fLatch.lock_shared();
+				cursor->fLatch.unlock_shared();
+				cursor = nextNode;
+			}
+		}
+		catch (...)
+		{
+			cursor->fLatch.unlock_shared();
+			throw;
+		}
+
+		return cursor;
+	}
+
+	/**
+	 * @brief Go down from the root to the leaf where a key belongs, without latching. The structure latch has to be held exclusively
+	 * @return the leaf, nullptr for an empty tree
+	*/
+	Node* findLeaf(const TypeWrapper& key) const
+	{
+		Node* cursor = root;
+		while (cursor && !cursor->fIsLeaf)
+			cursor = child(cursor, childIndex(cursor, key));
+
+		return cursor;
+	}
+
+	void addResident(Node* node) const
+	{
+		if (node->fId >= fNodes.size())
+			fNodes.resize(node->fId + 1, nullptr);
+
+		fNodes[node->fId] = node;
+		node->fResidentSlot = fResident.size();
+		fResident.push_back(node);
+	}
+
+	void removeResident(Node* node) const
+	{
+		fNodes[node->fId] = nullptr;
+		fResident[node->fResidentSlot] = fResident.back();
+		fResident[node->fResidentSlot]->fResidentSlot = node->fResidentSlot;
+		fResident.pop_back();
+	}
+
+	/**
+	 * @brief Allocate a node, it is written to the index file on the next flush
+	*/
+	Node* createNode(bool isLeaf)
+	{
+		lock_guard<mutex> lock(fCacheLock);
+		Node* node = Node::create(getPool(), fOrder, isLeaf);
+		node->fId = allocateId();
+		node->fEpoch = fEpoch;
+		node->fLastUse = ++fClock;
+		addResident(node);
+		return node;
+	}
+
+	/**
+	 * @brief Mark a node whose keys or children changed, so it is written to the index file
+	*/
+	void markDirty(Node* node)
+	{
+		node->fIsDirty = true;
+	}
+
+	/**
+	 * @brief Link the leaf after a leaf that absorbed its neighbour back to it. The structure latch has to be held exclusively
+	*/
+	void relinkPrev(Node* leaf)
+	{
+		Node* next = getNode(leaf->ptr[leaf->fKeys.size()]);
+		if (!next)
+			return;
+
+		prepareWrite(next);
+		next->fPrev = leaf->fId;
+		markDirty(next);
+	}
+
+	/**
+	 * @brief Delete a node removed from the tree, its id is reused by a later node
+	*/
+	void release(Node* node, vector<Node*>& path)
+	{
+		if (!node)
+			return;
+
+		for (Node*& onPath : path)
+			if (onPath == node)
+				onPath = nullptr;
+
+		lock_guard<mutex> lock(fCacheLock);
+		if (node->fOlder || isSeenBySnapshot(node->fEpoch, ULLONG_MAX))
+		{
+			// An open snapshot may still read the node, it stays until prune finds no snapshot needs it
+			if (!node->fOlder)
+				fVersioned.push_back(node);
+
+			node->fRetiredAt = fEpoch;
+			return;
+		}
+
+		removeResident(node);
+		fFreeIds.push_back(node->fId);
+		Node::destroy(*fPool, node);
+	}
+
+	/**
+	 * @brief Called before a node of the tree is changed. If an open snapshot can see the node as it is,
+	 * that version is copied first and kept for the snapshot. The node has to be latched exclusively
+	 * or the structure latch held exclusively
+	*/
+	void prepareWrite(Node* node)
+	{
+		if (node->fEpoch == fEpoch)
+			return;
+
+		if (isSeenBySnapshot(node->fEpoch, ULLONG_MAX))
+		{
+			lock_guard<mutex> lock(fCacheLock);
+			Node* version = Node::create(getPool(), *node);
+			version->fOlder = node->fOlder;
+			if (!node->fOlder)
+				fVersioned.push_back(node);
+
+			node->fOlder = version;
+		}
+
+		node->fEpoch = fEpoch;
+	}
+
+	/**
+	 * @return whether a snapshot is open whose epoch lies in [from, until), i.e. it sees a version changed in epoch {from}
+	 * and replaced in epoch {until}
+	*/
+	bool isSeenBySnapshot(unsigned long long from, unsigned long long until) const
+	{
+		auto it = fSnapshots.lower_bound(from);
+		return it != fSnapshots.end() && *it < until;
+	}
+
+	/**
+	 * @brief Drop the versions of nodes and the retired nodes no open snapshot can see anymore, their ids are reused.
+	 * The structure latch has to be held exclusively
+	*/
+	void prune()
+	{
+		lock_guard<mutex> lock(fCacheLock);
+		vector<Node*> versioned;
+		for (Node* node : fVersioned)
+		{
+			// A version is seen by the snapshots taken after it was made and before the next newer version replaced it
+			bool isSeen = node->fRetiredAt == 0 || isSeenBySnapshot(node->fEpoch, node->fRetiredAt);
+			unsigned long long until = node->fEpoch;
+			Node* newer = node;
+			while (Node* version = newer->fOlder)
+			{
+				unsigned long long from = version->fEpoch;
+				if (isSeenBySnapshot(from, until))
+				{
+					newer = version;
+				}
+				else
+				{
+					newer->fOlder = version->fOlder;
+					Node::destroy(*fPool, version);
+				}
+
+				until = from;
+			}
+
+			if (!isSeen && !node->fOlder)
+			{
+				removeResident(node);
+				fFreeIds.push_back(node->fId);
+				Node::destroy(*fPool, node);
+			}
+			else if (node->fOlder || node->fRetiredAt != 0)
+			{
+				versioned.push_back(node);
+			}
+		}
+
+		fVersioned.swap(versioned);
+	}
+
+	void closeSnapshot(unsigned long long epoch)
+	{
+		unique_lock<Latch> lock(fStructureLatch);
+		fSnapshots.erase(fSnapshots.find(epoch));
+		prune();
+	}
+
+	/**
+	 * @brief Call a function with the version of a node a snapshot sees. The current version stays latched shared
+	 * while the function runs, older versions don't change. The structure latch has to be held
+	 * @param id - id of the node
+	 * @param epoch - epoch of the snapshot
+	 * @param read - the function
+	*/
+	void readVersion(size_t id, unsigned long long epoch, const std::function<void(const Node*)>& read) const
+	{
+		Node* node = getNode(id);
+		shared_lock<Latch> lock(node->fLatch);
+		const Node* version = node;
+		while (version && version->fEpoch > epoch)
+			version = version->fOlder;
+
+		if (!version)
+			throw std::logic_error("Node " + to_string(id) + " is not part of the snapshot");
+
+		read(version);
+	}
+
+	/**
+	 * @brief Scan a snapshot, see Snapshot::forEachInRange. Everything the snapshot reads stays as it is, so the scan can
+	 * let go of the tree between two leaves (once the cache is full, to let the leaves it left be evicted) and go on
+	 * from the next leaf
+	*/
+	void forEachInSnapshot(const Snapshot& snapshot, const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<void(const data&)>& visit) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		size_t id = snapshot.fRootId;
+		bool isLeaf = false;
+		while (id != 0 && !isLeaf)
+		{
+			readVersion(id, snapshot.fEpoch, [&](const Node* node)
+				{
+					isLeaf = node->fIsLeaf;
+					if (isLeaf)
+						return;
+
+					size_t i = 0;
+					if (lower)
+						while (i < node->fKeys.size() && node->fKeys[i].first < *lower)
+							i++;
+
+					id = node->ptr[i];
+				});
+		}
+
+		bool isDone = false;
+		while (id != 0 && !isDone)
+		{
+			readVersion(id, snapshot.fEpoch, [&](const Node* leaf)
+				{
+					for (const data& entry : leaf->fKeys)
+					{
+						const TypeWrapper& key = entry.first;
+						if (upper && (key > *upper || (!upperInclusive && key == *upper)))
+						{
+							isDone = true;
+							return;
+						}
+
+						bool aboveLower = !lower || key > *lower || (lowerInclusive && key == *lower);
+						bool belowUpper = !upper || key < *upper || (upperInclusive && key == *upper);
+						if (aboveLower && belowUpper)
+							visit(entry);
+					}
+
+					id = leaf->ptr[leaf->fKeys.size()];
+				});
+
+			if (id != 0 && !isDone && isCacheFull())
+			{
+				lock.unlock();
+				trim();
+				lock.lock();
+			}
+		}
+	}
+
+	/**
+	 * @brief Scan a snapshot backwards, see Snapshot::forEachInRangeReverse and forEachInSnapshot
+	*/
+	void forEachInSnapshotReverse(const Snapshot& snapshot, const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<bool(const data&)>& visit) const
+	{
+		trim();
+		shared_lock<Latch> lock(fStructureLatch);
+		size_t id = snapshot.fRootId;
+		bool isLeaf = false;
+		while (id != 0 && !isLeaf)
+		{
+			readVersion(id, snapshot.fEpoch, [&](const Node* node)
+				{
+					isLeaf = node->fIsLeaf;
+					if (isLeaf)
+						return;
+
+					size_t i = 0;
+					while (i < node->fKeys.size() && !(upper && *upper < node->fKeys[i].first))
+						i++;
+
+					id = node->ptr[i];
+				});
+		}
+
+		bool isDone = false;
+		while (id != 0 && !isDone)
+		{
+			readVersion(id, snapshot.fEpoch, [&](const Node* leaf)
+				{
+					for (size_t i = leaf->fKeys.size(); i-- > 0;)
+					{
+						const TypeWrapper& key = leaf->fKeys[i].first;
+						if (lower && (key < *lower || (!lowerInclusive && key == *lower)))
+						{
+							isDone = true;
+							return;
+						}
+
+						bool belowUpper = !upper || key < *upper || (upperInclusive && key == *upper);
+						if (belowUpper && !visit(leaf->fKeys[i]))
+						{
+							isDone = true;
+							return;
+						}
+					}
+
+					id = leaf->fPrev;
+				});
+
+			if (id != 0 && !isDone && isCacheFull())
+			{
+				lock.unlock();
+				trim();
+				lock.lock();
+			}
+		}
+	}
+
+	/**
+	 * @return the pool of the nodes, made on the first call after the tree was cleared. The cache lock has to be held
+	*/
+	NodePool& getPool() const
+	{
+		if (!fPool)
+			fPool.reset(new NodePool(Node::getBlockSize(fOrder)));
+
+		return *fPool;
+	}
+
+	size_t allocateId()
+	{
+		if (!fFreeIds.empty())
+		{
+			size_t id = fFreeIds.back();
+			fFreeIds.pop_back();
+			return id;
+		}
+
+		if (fFreeHead != 0)
+		{
+			size_t id = fFreeHead;
+			stringstream in(fFile->readFrame((int)id));
+			char kind = 0;
+			in.read(&kind, sizeof(kind));
+			in.read((char*)&fFreeHead, sizeof(fFreeHead));
+			if (!in || kind != FREE_FRAME || fFreeHead >= fNextId)
+				throw std::logic_error("Index file " + fFile->getPath() + " is corrupted");
+
+			return id;
+		}
+
+		return fNextId++;
+	}
+
+	/**
+	 * @return whether more than INDEX_CACHE_NODES nodes are in memory and some of them can be evicted
+	*/
+	bool isCacheFull() const
+	{
+		lock_guard<mutex> lock(fCacheLock);
+		return fFile && fResident.size() > INDEX_CACHE_NODES;
+	}
+
+	/**
+	 * @brief Called when a public operation starts, before it latches anything. Evicting nodes needs the tree to itself,
+	 * so if the cache is full the structure latch is taken exclusively for the eviction
+	*/
+	void trim() const
+	{
+		if (!isCacheFull())
+			return;
+
+		unique_lock<Latch> lock(fStructureLatch);
+		evict();
+	}
+
+	/**
+	 * @brief Evict the least recently used nodes once more than INDEX_CACHE_NODES are in memory, down to three quarters of it
+	 * so the next eviction is some time away. The root stays. Trees without an index file aren't trimmed.
+	 * The structure latch has to be held exclusively
+	*/
+	void evict() const
+	{
+		lock_guard<mutex> lock(fCacheLock);
+		if (!fFile || fResident.size() <= INDEX_CACHE_NODES)
+			return;
+
+		vector<Node*> candidates;
+		candidates.reserve(fResident.size());
+		for (Node* node : fResident)
+			if (node != root && !node->fOlder && node->fRetiredAt == 0)
+				candidates.push_back(node);
+
+		size_t evicted = std::min(candidates.size(), fResident.size() - INDEX_CACHE_NODES * 3 / 4);
+		std::nth_element(candidates.begin(), candidates.begin() + evicted, candidates.end(),
+			[](const Node* left, const Node* right) { return left->fLastUse < right->fLastUse; });
+
+		for (size_t i = 0; i < evicted; i++)
+		{
+			Node* node = candidates[i];
+			if (node->fIsDirty)
+				writeNode(node);
+
+			removeResident(node);
+			Node::destroy(*fPool, node);
+		}
+	}
+
+	/**
+	 * @brief Write a frame of the index file, the first write after a flush marks the header as unfinished
+	*/
+	void writeFrame(size_t id, const string& bytes) const
+	{
+		if (fIsFileCurrent)
+		{
+			writeHeader(UNFINISHED_LSN);
+			fFile->sync();
+			fIsFileCurrent = false;
+		}
+
+		fFile->writeFrame((int)id, bytes);
+	}
+
+	void writeHeader(unsigned long long lsn) const
+	{
+		stringstream out;
+		size_t rootId = root ? root->fId : 0, size = fSize;
+		out.write((char*)&lsn, sizeof(lsn));
+		out.write((char*)&fOrder, sizeof(fOrder));
+		out.write((char*)&size, sizeof(size));
+		out.write((char*)&rootId, sizeof(rootId));
+		out.write((char*)&fNextId, sizeof(fNextId));
+		out.write((char*)&fFreeHead, sizeof(fFreeHead));
+		unsigned int format = INDEX_FILE_FORMAT;
+		out.write((char*)&format, sizeof(format));
+		fFile->writeFrame(0, out.str());
+	}
+
+	void writeNode(Node* node) const
+	{
+		stringstream out;
+		bool isPrefixed = !node->fKeys.empty() && std::all_of(node->fKeys.begin(), node->fKeys.end(),
+			[](const data& entry) { return isStringKey(entry.first); });
+		char kind = node->fIsLeaf ? (isPrefixed ? PREFIXED_LEAF_FRAME : LEAF_FRAME) : (isPrefixed ? PREFIXED_INTERNAL_FRAME : INTERNAL_FRAME);
+		size_t keysCount = node->fKeys.size();
+		out.write(&kind, sizeof(kind));
+		out.write((char*)&keysCount, sizeof(keysCount));
+		string previous;
+		for (data& entry : node->fKeys)
+		{
+			if (isPrefixed)
+			{
+				// the keys are sorted, so a key is written as the length of the prefix it shares with the previous one and the rest
+				string key = entry.first.toString();
+				size_t shared = getSharedPrefix(previous, key);
+				fh::writeLength(out, shared);
+				fh::writeLength(out, key.size() - shared);
+				out.write(key.data() + shared, key.size() - shared);
+				previous = std::move(key);
+			}
+			else
+			{
+				entry.first.write(out);
+			}
+
+			entry.second.write(out);
+		}
+
+		if (node->fIsLeaf)
+		{
+			out.write((char*)&node->ptr[keysCount], sizeof(node->ptr[keysCount]));
+			out.write((char*)&node->fPrev, sizeof(node->fPrev));
+		}
+		else
+		{
+			for (size_t i = 0; i < keysCount + 1; i++)
+				out.write((char*)&node->ptr[i], sizeof(node->ptr[i]));
+
+			size_t count = node->fCount;
+			out.write((char*)&count, sizeof(count));
+		}
+
+		writeFrame(node->fId, out.str());
+		node->fIsDirty = false;
+	}
+
+	/**
+	 * @brief Read a node from its frame in the index file and keep it in memory
+	*/
+	Node* readNode(size_t id) const
+	{
+		if (!fFile || id >= fNextId)
+			throw std::logic_error("Node " + to_string(id) + " is not part of the tree");
+
+		stringstream in(fFile->readFrame((int)id));
+		char kind = 0;
+		size_t keysCount = 0;
+		in.read(&kind, sizeof(kind));
+		in.read((char*)&keysCount, sizeof(keysCount));
+		bool isLeaf = kind == LEAF_FRAME || kind == PREFIXED_LEAF_FRAME;
+		bool isPrefixed = kind == PREFIXED_LEAF_FRAME || kind == PREFIXED_INTERNAL_FRAME;
+		if (!in || (!isLeaf && kind != INTERNAL_FRAME && kind != PREFIXED_INTERNAL_FRAME) || keysCount > (size_t)fOrder)
+			throw std::logic_error("Index file " + fFile->getPath() + " is corrupted");
+
+		Node* node = Node::create(getPool(), fOrder, isLeaf);
+		try
+		{
+			string previous;
+			for (size_t i = 0; i < keysCount && in; i++)
+			{
+				if (isPrefixed)
+				{
+					size_t shared = 0, suffix = 0;
+					fh::readLength(in, shared);
+					fh::readLength(in, suffix);
+					if (!in || shared > previous.size() || suffix > (size_t)in.rdbuf()->in_avail())
+					{
+						in.setstate(std::ios::failbit);
+						break;
+					}
+
+					previous.resize(shared + suffix);
+					in.read(&previous[shared], suffix);
+					node->fKeys.push_back({ TypeWrapper(previous), RecordPtr(in) });
+				}
+				else
 				{
-					cursor = cursor->ptr[i];
+					TypeWrapper key(in);
+					node->fKeys.push_back({ key, RecordPtr(in) });
+				}
+			}
+
+			if (node->fIsLeaf)
+			{
+				in.read((char*)&node->ptr[keysCount], sizeof(node->ptr[keysCount]));
+				in.read((char*)&node->fPrev, sizeof(node->fPrev));
+				node->fCount = keysCount;
+			}
+			else
+			{
+				for (size_t i = 0; i < keysCount + 1; i++)
+					in.read((char*)&node->ptr[i], sizeof(node->ptr[i]));
+
+				size_t count = 0;
+				in.read((char*)&count, sizeof(count));
+				node->fCount = count;
+			}
+		}
+		catch (...)
+		{
+			Node::destroy(*fPool, node);
+			throw;
+		}
+
+		if (!in)
+		{
+			Node::destroy(*fPool, node);
+			throw std::logic_error("Index file " + fFile->getPath() + " is corrupted");
+		}
+
+		node->fId = id;
+		node->fIsDirty = false;
+		addResident(node);
+		return node;
+	}
+
+	/**
+	 * @brief Remove a key, see remove. The structure latch has to be held exclusively
+	*/
+	void removeKey(const TypeWrapper& key)
+	{
+		if (!root)
+			return;
+
+		Node* cursor = root;
+		Node* parent = nullptr;
+		int leftSibling, rightSibling;
+		vector<Node*> path(1, root);
+		// find the leaf node containing the kvp
+		while (!cursor->fIsLeaf)
+		{
+			for (int i = 0; i < cursor->fKeys.size(); i++)
+			{
+				parent = cursor;
+				leftSibling = i - 1;
+				rightSibling = i + 1;
+				if (key < cursor->fKeys[i].first)
+				{
+					cursor = child(cursor, i);
 					break;
 				}
 
 				if (i == cursor->fKeys.size() - 1)
 				{
-					cursor = cursor->ptr[i + 1];
+					leftSibling = i;
+					rightSibling = i + 2;
+					cursor = child(cursor, i + 1);
 					break;
 				}
 			}
+
+			path.push_back(cursor);
 		}
 
-		while (cursor)
+		for (Node* node : path)
+			prepareWrite(node);
+
+		// in the node, find the kvp, if it exists
+		bool found = false;
+		int pos;
+		for (pos = 0; pos < cursor->fKeys.size(); pos++)
 		{
-			for (int i = 0; i < cursor->fKeys.size(); i++)
+			if (cursor->fKeys[pos].first == key)
 			{
-				if (orEqual && cursor->fKeys[i].first >= what)
-					answer.push_back(cursor->fKeys[i].second);
-				else if (!orEqual && cursor->fKeys[i].first > what)
-					answer.push_back(cursor->fKeys[i].second);
+				found = true;
+				break;
 			}
-
-			cursor = cursor->ptr[cursor->fKeys.size()];
 		}
 
-		return answer;
-	}
+		if (!found)
+			return;
 
-	/**
-	 * @brief  < or <=
-	*/
-	vector<RecordPtr> getRecordPtrsLessThan(const TypeWrapper& what, bool orEqual)
-	{
-		vector<RecordPtr> answer;
-		Node* cursor = root;
-		while (cursor && !cursor->fIsLeaf)
-			cursor = cursor->ptr[0];
+		// erase the key from the node's keys
+		cursor->fKeys.erase(cursor->fKeys.begin() + pos);
+		markDirty(cursor);
+		fSize--;
 
-		while (cursor)
+		// in case we are deleting the only element in the tree, just delete the tree itself
+		if (cursor == root)
 		{
-			for (int i = 0; i < cursor->fKeys.size(); i++)
+			for (int i = 0; i < fOrder + 1; i++)
+				cursor->ptr[i] = 0;
+
+			if (cursor->fKeys.size() == 0)
+			{
+				release(cursor, path);
+				root = nullptr;
+			}
+			else
 			{
-				if (orEqual && cursor->fKeys[i].first <= what)
-					answer.push_back(cursor->fKeys[i].second);
-				else if (!orEqual && cursor->fKeys[i].first < what)
-					answer.push_back(cursor->fKeys[i].second);
+				recount(cursor);
 			}
 
-			cursor = cursor->ptr[cursor->fKeys.size()];
+			return;
 		}
 
-		return answer;
-	}
-
-	/**
-	 * @brief By given query with primary key get all the records satisfying its criteria
-	 * @param query - data base query to check against tree's records
-	 * @return array of record pointers that satisfy the criteria
-	*/
-	vector<RecordPtr> getRecordsFromQuery(InternalQuery& query)
-	{
-		if (!query.isPrimaryKeyQuery())
-			throw invalid_argument("Cannot select/remove items from tree without primary index");
+		// adjust the child pointers after deleting the element
+		cursor->ptr[cursor->fKeys.size()] = cursor->ptr[cursor->fKeys.size() + 1];
+		cursor->ptr[cursor->fKeys.size() + 1] = 0;
 
-		vector<RecordPtr> answer;
-		if (query.getOperator() == Operator::EQUAL)
-		{
-			Node* targetNode = search(query.getValue());
-			if (targetNode)
-				answer.push_back(targetNode->fKeys[targetNode->keyIndex(query.getValue())].second);
-		}
-		else if (query.getOperator() == Operator::NOT_EQUAL)
+		if (cursor->fKeys.size() >= (fOrder + 1) / 2 - 1 /*delete -1*/)
 		{
-			answer = getAllRecordPtrsExcept(query.getValue());
+			recountPath(key);
+			deleteIndex(key);
+			return;
 		}
-		else if (query.getOperator() == Operator::GREATER_THAN)
+
+		// Borrow
+		if (leftSibling >= 0)
 		{
-			answer = getRecordPtrsGreaterThan(query.getValue(), false);
+			Node* leftNode = child(parent, leftSibling);
+			prepareWrite(leftNode);
+			if (leftNode->fKeys.size() >= (fOrder + 1) / 2 /*+ 1*/)
+			{
+				// take the last element from left sibling and insert it in cursor's start + readjust pointer to point to next leaf
+				cursor->fKeys.insert(cursor->fKeys.begin(), leftNode->fKeys.back());
+				cursor->ptr[cursor->fKeys.size()] = cursor->ptr[cursor->fKeys.size() - 1];
+				cursor->ptr[cursor->fKeys.size() - 1] = 0;
+
+				// after inserting last el. from leftSibling in cursor, erase it from left sibl. and readjust pointers
+				leftNode->fKeys.erase(leftNode->fKeys.end() - 1);
+				leftNode->ptr[leftNode->fKeys.size()] = cursor->fId;
+				leftNode->ptr[leftNode->fKeys.size() + 1] = 0;
+				parent->fKeys[leftSibling] = cursor->fKeys[0];
+				recount(leftNode);
+				markDirty(leftNode);
+				markDirty(parent);
+				recountPath(key);
+				deleteIndex(key);
+				return;
+			}
 		}
-		else if (query.getOperator() == Operator::GREATER_THAN_OR_EQUAL)
+
+		//Borrow
+		if (rightSibling <= parent->fKeys.size())
 		{
-			answer = getRecordPtrsGreaterThan(query.getValue(), true);
+			Node* rightNode = child(parent, rightSibling);
+			prepareWrite(rightNode);
+			if (rightNode->fKeys.size() >= (fOrder + 1) / 2 /*+ 1*/)
+			{
+				// Borrow key from right sibling and readjust pointers
+				cursor->fKeys.push_back(rightNode->fKeys[0]);
+				cursor->ptr[cursor->fKeys.size()] = cursor->ptr[cursor->fKeys.size() - 1];
+				cursor->ptr[cursor->fKeys.size() - 1] = 0;
+
+				// Erase the borrowed element and readjust nodes
+				rightNode->fKeys.erase(rightNode->fKeys.begin());
+				rightNode->ptr[rightNode->fKeys.size()] = rightNode->ptr[rightNode->fKeys.size() + 1];
+				rightNode->ptr[rightNode->fKeys.size() + 1] = 0;
+				parent->fKeys[rightSibling - 1] = rightNode->fKeys[0]; // to fulfil the properties for b+tree, we take the smallest element
+																	   // from the right sibling and put it in the parent's keys
+				recount(rightNode);
+				markDirty(rightNode);
+				markDirty(parent);
+				recountPath(key);
+				deleteIndex(key);
+				return;
+			}
 		}
-		else if (query.getOperator() == Operator::LESS_THAN)
+
+		// Merges
+		if (leftSibling >= 0)
 		{
-			answer = getRecordPtrsLessThan(query.getValue(), false);
+			Node* leftNode = child(parent, leftSibling);
+			prepareWrite(leftNode);
+			leftNode->ptr[leftNode->fKeys.size()] = 0;
+			for (int j = 0; j < cursor->fKeys.size(); j++)
+				leftNode->fKeys.push_back(cursor->fKeys[j]);
+
+			leftNode->ptr[leftNode->fKeys.size()] = cursor->ptr[cursor->fKeys.size()];
+			relinkPrev(leftNode);
+			recount(leftNode);
+			markDirty(leftNode);
+			// Merging two leaf nodes
+			removeInternal(parent->fKeys[leftSibling].first, parent, cursor, path);
+			release(cursor, path);
 		}
-		else if (query.getOperator() == Operator::LESS_THAN_OR_EQUAL)
+		else if (rightSibling <= parent->fKeys.size())
 		{
-			answer = getRecordPtrsLessThan(query.getValue(), true);
-		}
-
-		return answer;
-	}
-
-	Node* getRoot()
-	{
-		return root;
-	}
+			Node* rightNode = child(parent, rightSibling);
+			prepareWrite(rightNode);
+			cursor->ptr[cursor->fKeys.size()] = 0;
+			for (int i = cursor->fKeys.size(), j = 0; j < rightNode->fKeys.size(); i++, j++)
+				cursor->fKeys.insert(cursor->fKeys.begin() + i, rightNode->fKeys[j]);
 
-	size_t size() const { return this->fSize; }
+			cursor->ptr[cursor->fKeys.size()] = rightNode->ptr[rightNode->fKeys.size()];
+			relinkPrev(cursor);
+			recount(cursor);
+			// Merging two leaf nodes
+			removeInternal(parent->fKeys[rightSibling - 1].first, parent, rightNode, path);
+			release(rightNode, path);
+		}
 
-	/**
-	 * @brief Write the tree to file, just the elements in root-left-right way
-	 * @param out - output stream
-	*/
-	void write(ofstream& out)
-	{
-		set<TypeWrapper> visited;
-		out.write((char*)&fOrder, sizeof(fOrder));
-		out.write((char*)&fSize, sizeof(fSize));
-		writeRec(root, out, visited);
+		recountPath(key);
+		deleteIndex(key);
 	}
 
-private:
-	int fOrder;
-	size_t fSize;
-	Node* root;
-
 	/**
 	 * @brief Method used for inserting a kvp that is located neither in the leaves
 	 * nor in the root.
 	 * @param kvp - key value pair that will be inserted
 	 * @param cursor - root of subtree
 	 * @param child - child of cursor
+	 * @param path - the latched nodes of the insertion, down to cursor's child
 	*/
-	void insertInternal(data kvp, Node* cursor, Node* child)
+	void insertInternal(data kvp, Node* cursor, Node* child, vector<Node*>& path)
 	{
 		/// Check to see if the current node can contain any more kvp's
 		if (cursor->fKeys.size() < fOrder)
@@ -547,13 +1985,14 @@ private:
 				cursor->ptr[j] = cursor->ptr[j - 1];
 
 			cursor->fKeys.insert(cursor->fKeys.begin() + i, kvp);
-			cursor->ptr[i + 1] = child;
+			cursor->ptr[i + 1] = child->fId;
+			markDirty(cursor);
 		}
 		else
 		{
-			Node* newInternal = new Node(fOrder, false); // create new internal node when splitting
+			Node* newInternal = createNode(false); // create new internal node when splitting
 			vector<data> virtualKvp;
-			vector<Node*> virtualPtr;
+			vector<size_t> virtualPtr;
 			virtualKvp.reserve(fOrder + 1); // we assume the keys are full so we reserve exactly fOrder+1 so we can split accordingly to the newly added el.
 			virtualPtr.reserve(fOrder + 2); // if keys are full of an internal node, that means ptr is also full so we reserve fOrder+2
 
@@ -565,69 +2004,211 @@ private:
 				i++;
 
 			virtualKvp.insert(virtualKvp.begin() + i, kvp); // insert new key
-			virtualPtr.insert(virtualPtr.begin() + i + 1, child); // insert the element from the previous iteration
+			virtualPtr.insert(virtualPtr.begin() + i + 1, child->fId); // insert the element from the previous iteration
 
-			// We are halving the keys and pointers of cursor, because we are splitting it
-			int k = cursor->ptr.size() - 1;
-			while (cursor->fKeys.size() != (fOrder + 1) / 2)
-			{
-				cursor->fKeys.pop_back();
-				cursor->ptr[k] = nullptr;
-				k--;
-			}
+			// We are halving the keys and pointers of cursor, because we are splitting it. The left half is taken
+			// from the virtual node too, since the new key and child may belong to it
+			size_t leftKeysSize = (fOrder + 1) / 2;
+			cursor->fKeys.assign(virtualKvp.begin(), virtualKvp.begin() + leftKeysSize);
+			for (size_t j = 0; j < cursor->ptr.size(); j++)
+				cursor->ptr[j] = j <= leftKeysSize ? virtualPtr[j] : 0;
 
-			// Since we dont need repeating elements in the internal nodes, we skip the first key here by saying fOrder + 1 - (fOrder+1)/2 - 1
-			size_t newInternalKeysSize = fOrder - (fOrder + 1) / 2;
-			newInternal->fKeys.reserve(newInternalKeysSize);
+			// Since we dont need repeating elements in the internal nodes, we skip the first key of the right half
 			newInternal->fKeys.insert(newInternal->fKeys.begin(), virtualKvp.begin() + cursor->fKeys.size() + 1, virtualKvp.end()); // Fill keys of newInternal
 			for (size_t j = 0, i = cursor->fKeys.size() + 1; i < virtualPtr.size(); i++, j++)
 				newInternal->ptr[j] = virtualPtr[i];
 
-			if (cursor == root)
+			recount(cursor);
+			recount(newInternal);
+			markDirty(cursor);
+
+			if (cursor == path.front())
 			{
-				Node* newRoot = new Node(fOrder, false);
+				Node* newRoot = createNode(false);
 				newRoot->fKeys.push_back(virtualKvp[cursor->fKeys.size()]);
-				newRoot->ptr[0] = cursor;
-				newRoot->ptr[1] = newInternal;
+				newRoot->ptr[0] = cursor->fId;
+				newRoot->ptr[1] = newInternal->fId;
+				recount(newRoot);
 				root = newRoot;
 			}
 			else
 			{
-				insertInternal(virtualKvp[cursor->fKeys.size()], findParent(root, cursor), newInternal);
+				insertInternal(virtualKvp[cursor->fKeys.size()], findParent(cursor, path), newInternal, path);
 			}
 		}
 	}
 
 	/**
-	 * @brief Given root of tree and a child node, find the parent of that child node
-	 * @param root - begining of the subtree
-	 * @param child - child whoose parent we will look for
-	 * @return the parent if found, otherwise nullptr
+	 * @brief Recompute the number of keys in the subtree of a node, the counts of its children have to be up to date
 	*/
-	Node* findParent(Node* root, Node* child)
+	void recount(Node* node) const
 	{
-		if (child == root || root == nullptr)
-			return nullptr;
+		if (node->fIsLeaf)
+		{
+			node->fCount = node->fKeys.size();
+			return;
+		}
 
-		Node* parent = nullptr;
-		if (root->fIsLeaf || (root->ptr[0])->fIsLeaf)
-			return nullptr;
+		size_t count = 0;
+		for (size_t i = 0; i < node->fKeys.size() + 1; i++)
+			count += child(node, i)->fCount;
 
-		for (Node* rootChild : root->ptr)
-		{
-			if (rootChild == child)
+		node->fCount = count;
+	}
+
+	/**
+	 * @brief Count the leading keys satisfying a predicate that holds for a prefix of the keys in ascending order
+	 * (i.e. {key} < {bound}). A separator satisfying it means the whole subtree left of it does too
+	 * @param isBefore - the predicate
+	 * @return the number of keys before the first one the predicate doesn't hold for
+	*/
+	size_t countLeading(const std::function<bool(const TypeWrapper&)>& isBefore) const
+	{
+		size_t count = 0;
+		Node* leaf = descendShared([&](Node* node)
 			{
-				return root;
-			}
-			else
+				size_t i = 0;
+				while (i < node->fKeys.size() && isBefore(node->fKeys[i].first))
+				{
+					count += child(node, i)->fCount;
+					i++;
+				}
+
+				return i;
+			});
+
+		if (!leaf)
+			return 0;
+
+		for (size_t i = 0; i < leaf->fKeys.size() && isBefore(leaf->fKeys[i].first); i++)
+			count++;
+
+		leaf->fLatch.unlock_shared();
+		return count;
+	}
+
+	/**
+	 * @brief Get the key with the given position in ascending key order, see getAt. The structure latch has to be held.
+	 * An insertion latches a node before it counts the new key in the node's children, so the counts of a latched
+	 * node's children add up to its own count and the position stays inside the followed subtree
+	*/
+	data getAtLatched(size_t index) const
+	{
+		Node* leaf = descendShared([&](Node* node)
 			{
-				parent = findParent(rootChild, child);
-				if (parent)
-					return parent;
-			}
+				size_t i = 0;
+				while (i < node->fKeys.size() && index >= child(node, i)->fCount)
+				{
+					index -= child(node, i)->fCount;
+					i++;
+				}
+
+				return i;
+			});
+
+		data entry = leaf->fKeys[index];
+		leaf->fLatch.unlock_shared();
+		return entry;
+	}
+
+	/**
+	 * @brief Find the positions of the keys between two bounds, the keys in the range are the ones at positions [begin, end).
+	 * The bounds are tested positively like in forEachInRange, so a bound of another type than the keys gives an empty range.
+	 * The structure latch has to be held
+	*/
+	void getRankRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive, size_t& begin, size_t& end) const
+	{
+		end = upper ? countLeading([&](const TypeWrapper& key) { return key < *upper || (upperInclusive && key == *upper); }) : fSize.load();
+		begin = lower ? countLeading([&](const TypeWrapper& key) { return !(key > *lower || (lowerInclusive && key == *lower)); }) : 0;
+		if (begin > end)
+			begin = end;
+	}
+
+	/**
+	 * @brief Recompute the subtree counts of the nodes on the path from the root to the leaf where a key belongs,
+	 * bottom-up. Called after every insertion and removal - nodes off the path that were split, merged or lent a key
+	 * are recounted where that happens. On removal it has to run before deleteIndex replaces the separators
+	 * equal to the removed key, those still lead to the leaf that held it
+	 * @param key - the inserted or removed key
+	*/
+	void recountPath(const TypeWrapper& key)
+	{
+		vector<Node*> path;
+		Node* cursor = root;
+		while (cursor)
+		{
+			path.push_back(cursor);
+			if (cursor->fIsLeaf)
+				break;
+
+			size_t i = 0;
+			while (i < cursor->fKeys.size() && !(key < cursor->fKeys[i].first))
+				i++;
+
+			cursor = child(cursor, i);
 		}
 
-		return parent;
+		for (size_t i = path.size(); i > 0; i--)
+		{
+			prepareWrite(path[i - 1]);
+			size_t count = path[i - 1]->fCount;
+			recount(path[i - 1]);
+			if (path[i - 1]->fCount != count)
+				markDirty(path[i - 1]);
+		}
+	}
+
+	/**
+	 * @brief Find the parent of a node on the path of an insertion or a removal
+	 * @param child - node on the path
+	 * @param path - nodes from the top of the path down to a leaf
+	 * @return the parent, nullptr for the top of the path
+	*/
+	Node* findParent(Node* child, const vector<Node*>& path)
+	{
+		for (size_t i = 1; i < path.size(); i++)
+			if (path[i] == child)
+				return path[i - 1];
+
+		return nullptr;
+	}
+
+	/**
+	 * @brief Separator of two neighbouring leaves, any key s with {left} < s <= {right} leads to the right leaf all the same.
+	 * For string keys it is the shortest prefix of {right} greater than {left}, so the internal nodes hold short keys
+	 * (i.e. "Jo" between "Jane" and "John") and a node of a long key doesn't grow its frame in the index file
+	 * @param left - last key of the left leaf
+	 * @param right - first key of the right leaf
+	 * @return the key put in the parent, it isn't necessarily in the tree
+	*/
+	static data getSeparator(const data& left, const data& right)
+	{
+		if (!isStringKey(left.first) || !isStringKey(right.first))
+			return right;
+
+		string rightKey = right.first.toString();
+		size_t shared = getSharedPrefix(left.first.toString(), rightKey);
+		if (shared + 1 >= rightKey.size())
+			return right;
+
+		return { TypeWrapper(rightKey.substr(0, shared + 1)), right.second };
+	}
+
+	static bool isStringKey(const TypeWrapper& key)
+	{
+		return key.getContent() && typeid(*key.getContent()) == typeid(StringObject);
+	}
+
+	/**
+	 * @return length of the longest common prefix of two strings
+	*/
+	static size_t getSharedPrefix(const string& first, const string& second)
+	{
+		size_t length = 0;
+		while (length < first.size() && length < second.size() && first[length] == second[length])
+			length++;
+
+		return length;
 	}
 
 	/**
@@ -638,7 +2219,7 @@ private:
 	*/
 	Node* splitNode(Node*& cursor, data& kvp)
 	{
-		Node* newLeaf = new Node(fOrder, true);
+		Node* newLeaf = createNode(true);
 		vector<data> virtualNode;
 		virtualNode.reserve(fOrder + 1);
 		virtualNode.insert(virtualNode.begin(), cursor->fKeys.begin(), cursor->fKeys.end());
@@ -649,39 +2230,29 @@ private:
 		virtualNode.insert(virtualNode.begin() + i, kvp);
 
 		cursor->fKeys.clear();
-		cursor->fKeys.reserve((fOrder + 1) / 2);
 		cursor->fKeys.insert(cursor->fKeys.begin(), virtualNode.begin(), virtualNode.begin() + (fOrder + 1) / 2);
 
-		size_t newLeafKeysSize = fOrder + 1 - (fOrder + 1) / 2;
-		newLeaf->fKeys.reserve(newLeafKeysSize);
 		newLeaf->fKeys.insert(newLeaf->fKeys.begin(), virtualNode.begin() + (fOrder + 1) / 2, virtualNode.end());
 
-		cursor->ptr[cursor->fKeys.size()] = newLeaf;
 		newLeaf->ptr[newLeaf->fKeys.size()] = cursor->ptr[fOrder];
-		cursor->ptr[fOrder] = nullptr;
-
-		return newLeaf;
-	}
-
-	/**
-	 * @brief Clears the B+ tree
-	 * @param cursor - root from which clearing takes place
-	*/
-	void clear(Node*& cursor)
-	{
-		if (cursor != nullptr)
+		newLeaf->fPrev = cursor->fId;
+		Node* next = getNode(cursor->ptr[fOrder]);
+		if (next)
 		{
-			if (!cursor->fIsLeaf)
-			{
-				for (Node*& child : cursor->ptr)
-				{
-					clear(child);
-				}
-			}
-
-			delete cursor;
-			cursor = nullptr;
+			// Latching the next leaf while holding cursor keeps the order of the scans, which go from a leaf to the next one
+			unique_lock<Latch> nextLock(next->fLatch);
+			prepareWrite(next);
+			next->fPrev = newLeaf->fId;
+			markDirty(next);
 		}
+
+		cursor->ptr[cursor->fKeys.size()] = newLeaf->fId;
+		cursor->ptr[fOrder] = 0;
+
+		recount(cursor);
+		recount(newLeaf);
+		markDirty(cursor);
+		return newLeaf;
 	}
 
 	/**
@@ -690,26 +2261,27 @@ private:
 	 * @param kvp - key that will be removed in the recursive call to remove internal
 	 * @param cursor - parent of child
 	 * @param child - child node(result of the merging of nodes). It is a leftover from the merge process with it's right or left brother and will be deleted
+	 * @param path - nodes from the root to the leaf of the removal
 	*/
-	void removeInternal(const TypeWrapper& kvp, Node*& cursor, Node*& child) {
+	void removeInternal(const TypeWrapper& kvp, Node*& cursor, Node*& child, vector<Node*>& path) {
 		if (cursor == root)
 		{
 			if (cursor->fKeys.size() == 1)
 			{
-				if (cursor->ptr[1] == child)
+				if (cursor->ptr[1] == child->fId)
 				{
 					// Changing root node
-					delete child;
-					root = cursor->ptr[0];
-					delete cursor;
+					release(child, path);
+					root = this->child(cursor, 0);
+					release(cursor, path);
 					cursor = child = nullptr;
 					return;
 				}
-				else if (cursor->ptr[0] == child) {
+				else if (cursor->ptr[0] == child->fId) {
 					// Changing root node
-					delete child;
-					root = cursor->ptr[1];
-					delete cursor;
+					release(child, path);
+					root = this->child(cursor, 1);
+					release(cursor, path);
 					cursor = child = nullptr;
 					return;
 				}
@@ -719,7 +2291,7 @@ private:
 		int pos;
 		// find pos of child that is to be deleted
 		for (pos = 0; pos < cursor->fKeys.size() + 1; pos++)
-			if (cursor->ptr[pos] == child)
+			if (cursor->ptr[pos] == child->fId)
 				break;
 
 		// shift pointers one to the left so we "eat" the child that is to be deleted
@@ -728,7 +2300,7 @@ private:
 			if (i != cursor->fKeys.size())
 				cursor->ptr[i] = cursor->ptr[i + 1];
 			else
-				cursor->ptr[i] = nullptr;
+				cursor->ptr[i] = 0;
 		}
 
 		for (pos = 0; pos < cursor->fKeys.size(); pos++)
@@ -737,6 +2309,8 @@ private:
 
 		// Erase the key that we have sent up the tree
 		cursor->fKeys.erase(cursor->fKeys.begin() + pos);
+		recount(cursor);
+		markDirty(cursor);
 
 		if (cursor->fKeys.size() >= (fOrder + 1) / 2 - 1)
 			return;
@@ -744,11 +2318,11 @@ private:
 		if (cursor == root)
 			return;
 
-		Node* parent = findParent(root, cursor);
+		Node* parent = findParent(cursor, path);
 		int leftSibling = -1, rightSibling = parent->fKeys.size() + 1;
 		for (pos = 0; pos < parent->fKeys.size() + 1; pos++)
 		{
-			if (parent->ptr[pos] == cursor)
+			if (parent->ptr[pos] == cursor->fId)
 			{
 				leftSibling = pos - 1;
 				rightSibling = pos + 1;
@@ -758,7 +2332,8 @@ private:
 
 		if (leftSibling >= 0)
 		{
-			Node* leftNode = parent->ptr[leftSibling];
+			Node* leftNode = this->child(parent, leftSibling);
+			prepareWrite(leftNode);
 			if (leftNode->fKeys.size() >= (fOrder + 1) / 2)
 			{
 				cursor->fKeys.insert(cursor->fKeys.begin(), parent->fKeys[leftSibling]);
@@ -767,15 +2342,20 @@ private:
 					cursor->ptr[i] = cursor->ptr[i - 1];
 
 				cursor->ptr[0] = leftNode->ptr[leftNode->fKeys.size()];
-				leftNode->ptr[leftNode->fKeys.size()] = nullptr;
+				leftNode->ptr[leftNode->fKeys.size()] = 0;
 				leftNode->fKeys.pop_back();
+				recount(cursor);
+				recount(leftNode);
+				markDirty(leftNode);
+				markDirty(parent);
 				return;
 			}
 		}
 
 		if (rightSibling <= parent->fKeys.size())
 		{
-			Node* rightNode = parent->ptr[rightSibling];
+			Node* rightNode = this->child(parent, rightSibling);
+			prepareWrite(rightNode);
 			if (rightNode->fKeys.size() >= (fOrder + 1) / 2)
 			{
 				cursor->fKeys.push_back(parent->fKeys[pos]);
@@ -785,137 +2365,132 @@ private:
 				for (int i = 0; i < rightNode->fKeys.size(); ++i)
 					rightNode->ptr[i] = rightNode->ptr[i + 1];
 
-				rightNode->ptr[rightNode->fKeys.size()] = nullptr;
+				rightNode->ptr[rightNode->fKeys.size()] = 0;
 				rightNode->fKeys.erase(rightNode->fKeys.begin());
+				recount(cursor);
+				recount(rightNode);
+				markDirty(rightNode);
+				markDirty(parent);
 				return;
 			}
 		}
 
 		if (leftSibling >= 0)
 		{
-			Node* leftNode = parent->ptr[leftSibling];
+			Node* leftNode = this->child(parent, leftSibling);
+			prepareWrite(leftNode);
 			leftNode->fKeys.push_back(parent->fKeys[leftSibling]);
 
 			for (int i = leftNode->fKeys.size(), j = 0; i < fOrder + 1 && j < cursor->fKeys.size() + 1; j++, i++)
 			{
 				leftNode->ptr[i] = cursor->ptr[j];
-				cursor->ptr[j] = nullptr;
+				cursor->ptr[j] = 0;
 			}
 
 			for (int j = 0; j < cursor->fKeys.size(); j++)
 				leftNode->fKeys.push_back(cursor->fKeys[j]);
 
-			removeInternal(parent->fKeys[leftSibling].first, parent, cursor);
+			recount(leftNode);
+			markDirty(leftNode);
+			removeInternal(parent->fKeys[leftSibling].first, parent, cursor, path);
+
+			// The merged node is out of the tree, the caller's pointer to it is cleared too
+			release(cursor, path);
+			cursor = nullptr;
 		}
 		else if (rightSibling <= parent->fKeys.size())
 		{
-			Node* rightNode = parent->ptr[rightSibling];
+			Node* rightNode = this->child(parent, rightSibling);
+			prepareWrite(rightNode);
 			cursor->fKeys.push_back(parent->fKeys[rightSibling - 1]);
 
 			for (int i = cursor->fKeys.size(), j = 0; i < fOrder + 1 && j < rightNode->fKeys.size() + 1; j++, i++)
 			{
 				cursor->ptr[i] = rightNode->ptr[j];
-				rightNode->ptr[j] = nullptr;
+				rightNode->ptr[j] = 0;
 			}
 
 			for (int j = 0; j < rightNode->fKeys.size(); j++)
 				cursor->fKeys.push_back(rightNode->fKeys[j]);
 
-			removeInternal(parent->fKeys[rightSibling - 1].first, parent, rightNode);
+			recount(cursor);
+			removeInternal(parent->fKeys[rightSibling - 1].first, parent, rightNode, path);
+			release(rightNode, path);
 		}
 	}
 
 	/**
-	 * @brief Called after remove(), used to delete the second occurence of an index (if second occurence exists)
-	 * @param kvp - key to delete
-	 * @param cursor - pivot element from which searching element for deletion takes place
+	 * @brief Called after remove(), used to replace the separator equal to the removed key (if there is one) with the
+	 * smallest key right of it. Such a separator lies on the path from the root to the key's leaf
+	 * @param key - the removed key
 	*/
-	void deleteIndex(const TypeWrapper& key, Node* cursor)
+	void deleteIndex(const TypeWrapper& key)
 	{
-		if (!cursor)
-			return;
+		Node* cursor = root;
+		while (cursor && !cursor->fIsLeaf)
+		{
+			int indKvp = cursor->keyIndex(key);
+			if (indKvp != -1)
+			{
+				data smallest;
+				if (getSmallestElementInSubTree(child(cursor, indKvp + 1), smallest))
+				{
+					prepareWrite(cursor);
+					cursor->fKeys[indKvp] = smallest;
+					markDirty(cursor);
+				}
 
-		int indKvp = cursor->keyIndex(key);
-		if (indKvp == -1)
-			deleteIndex(key, findParent(root, cursor));
-		else
-			cursor->fKeys[indKvp] = getSmallestElementInSubTree(cursor->ptr[indKvp + 1]);
+				return;
+			}
+
+			size_t i = 0;
+			while (i < cursor->fKeys.size() && !(key < cursor->fKeys[i].first))
+				i++;
+
+			cursor = child(cursor, i);
+		}
 	}
 
 	/**
 	 * @brief By given pivot point {root} find the smallest index in its subtree
 	 * @param root - pivot node
-	 * @return the smallest index in the subtree of root
+	 * @param smallest - set to the smallest index in the subtree of root
+	 * @return False if the subtree holds no keys
 	*/
-	data getSmallestElementInSubTree(Node* root)
+	bool getSmallestElementInSubTree(Node* root, data& smallest)
 	{
 		while (!root->fIsLeaf)
-			root = root->ptr[0];
-
-		if (!root)
-			return { -1,{-1,-1} };
-
-		return root->fKeys.front();
-	}
-
-	/**
-	 * @brief Copy the tree given by it's root recursively
-	 * @param root - tree to be copied
-	 * @return Newly copied tree
-	*/
-	Node* copy(Node* root)
-	{
-		if (!root)
-			return nullptr;
-
-		if (root->fIsLeaf)
-		{
-			Node* leaf = new Node(root->fOrder, root->fIsLeaf);
-			for (data& val : root->fKeys)
-				leaf->fKeys.push_back(val);
-
-			for (int i = 0; i < root->fKeys.size() + 1; i++)
-				leaf->ptr[i] = root->ptr[i];
-
-			return leaf;
-		}
-		else
-		{
-			Node* inner = new Node(root->fOrder, root->fIsLeaf);
-
-			for (data& val : root->fKeys)
-				inner->fKeys.push_back(val);
+			root = child(root, 0);
 
-			for (unsigned short slot = 0; slot < root->fKeys.size() + 1; ++slot)
-				inner->ptr[slot] = copy(root->ptr[slot]);
+		if (root->fKeys.empty())
+			return false;
 
-			return inner;
-		}
+		smallest = root->fKeys.front();
+		return true;
 	}
 
 	/**
-	 * @brief Used in writing the tree to file
+	 * @brief Used in writing the tree to file. Only the leaves are written, a separator in an internal node may be
+	 * a truncated key (see getSeparator) that isn't in the tree
 	 * @param cursor - begining of the subTree
 	 * @param out - output stream
-	 * @param visitedKeys - set of all the keys that have been written already
 	*/
-	void writeRec(Node* cursor, ofstream& out, set<TypeWrapper>& visitedKeys)
+	void writeRec(Node* cursor, ostream& out)
 	{
 		if (cursor) {
-			for (int i = 0; i < cursor->fKeys.size(); i++)
+			if (cursor->fIsLeaf)
 			{
-				if (visitedKeys.find(cursor->fKeys[i].first) != visitedKeys.end())
-					continue;
-
-				cursor->fKeys[i].first.write(out);
-				cursor->fKeys[i].second.write(out);
-				visitedKeys.insert(cursor->fKeys[i].first);
+				for (int i = 0; i < cursor->fKeys.size(); i++)
+				{
+					cursor->fKeys[i].first.write(out);
+					cursor->fKeys[i].second.write(out);
+				}
 			}
-
-			if (!cursor->fIsLeaf)
+			else
+			{
 				for (int i = 0; i < cursor->fKeys.size() + 1; i++)
-					writeRec(cursor->ptr[i], out, visitedKeys);
+					writeRec(child(cursor, i), out);
+			}
 		}
 	}
-
-};
\ No newline at end of file
+};
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cstdint>
 #include "CommandType.h"
 #include "StringHelper.hpp"
 
@@ -17,7 +18,11 @@ class CommandParser
 {
 private:
 	bool fIsDistinct = false;
+	bool fIsDescending = false;
+	size_t fLimit = SIZE_MAX;
+	size_t fOffset = 0;
 	string fOrderBy;
+	string fGroupBy;
 	string fRaw;
 	vector<string> fTokens;
 
@@ -30,6 +35,11 @@ public:
 	{
 		clearCmd();
 		fIsDistinct = false;
+		fIsDescending = false;
+		fLimit = SIZE_MAX;
+		fOffset = 0;
+		fOrderBy.clear();
+		fGroupBy.clear();
 
 		if (getNumberOfSymbol(fRaw, '\"') % 2 != 0)
 			throw invalid_argument("Invalid command, check the number of quotes");
@@ -44,6 +54,17 @@ public:
 
 		tokenizeInnerString();
 
+		// The selected columns may be split into several tokens ("name, COUNT(*)"), they are joined back into one
+		if (!fTokens.empty() && sh::toUpper(fTokens[0]) == "SELECT")
+		{
+			size_t from = findToken("FROM");
+			for (size_t i = 2; i < from && from < fTokens.size(); i++)
+				fTokens[1] += fTokens[i];
+
+			if (from > 2 && from < fTokens.size())
+				fTokens.erase(fTokens.begin() + 2, fTokens.begin() + from);
+		}
+
 		if (std::find(fTokens.begin(), fTokens.end(), "WHERE") != fTokens.end())
 		{
 			for (size_t i = 0; i < fTokens.size(); i++)
@@ -52,7 +73,8 @@ public:
 				if (fTokens[i] == "WHERE")
 				{
 					i++;
-					while (i < fTokens.size() && (fTokens[i] != "ORDER" && fTokens[i] != "BY" && fTokens[i] != "DISTINCT"))
+					while (i < fTokens.size() && (fTokens[i] != "ORDER" && fTokens[i] != "GROUP" && fTokens[i] != "BY" && fTokens[i] != "DISTINCT"
+						&& fTokens[i] != "LIMIT" && fTokens[i] != "OFFSET" && fTokens[i] != "DESC"))
 					{
 						fTokens[currInd] += " " + fTokens[i];
 						i++;
@@ -69,20 +91,64 @@ public:
 				{
 					if (fTokens[i + 1] == "BY")
 					{
-						fOrderBy = fTokens[i + 2];
+						fOrderBy = readColumnList(i + 2);
+						fIsDescending = std::find(fTokens.begin() + i + 2, fTokens.end(), "DESC") != fTokens.end();
 					}
 				}
 			}
 		}
 
+		if (!fIsDescending && std::find(fTokens.begin(), fTokens.end(), "DESC") != fTokens.end())
+			throw invalid_argument("DESC has to follow ORDER BY {columnName}");
+
+		if (std::find(fTokens.begin(), fTokens.end(), "GROUP") != fTokens.end())
+		{
+			for (size_t i = 0; i + 1 < fTokens.size(); i++)
+				if (fTokens[i] == "GROUP" && fTokens[i + 1] == "BY")
+					fGroupBy = readColumnList(i + 2);
+		}
+
 		if (std::find(fTokens.begin(), fTokens.end(), "DISTINCT") != fTokens.end())
 			fIsDistinct = true;
 
+		auto limit = std::find(fTokens.begin(), fTokens.end(), "LIMIT");
+		if (limit != fTokens.end())
+		{
+			if (limit + 1 == fTokens.end() || !sh::isStringInteger(*(limit + 1)) || (limit + 1)->front() == '-')
+				throw invalid_argument("LIMIT needs the number of records to return");
+
+			fLimit = std::stoull(*(limit + 1));
+		}
+
+		auto offset = std::find(fTokens.begin(), fTokens.end(), "OFFSET");
+		if (offset != fTokens.end())
+		{
+			if (offset + 1 == fTokens.end() || !sh::isStringInteger(*(offset + 1)) || (offset + 1)->front() == '-')
+				throw invalid_argument("OFFSET needs the number of records to skip");
+
+			fOffset = std::stoull(*(offset + 1));
+		}
+
 
 		if (fRaw.size() == 0 || fTokens.size() == 0)
 			throw invalid_argument("Invalid command, check the number of arguments you've given");
 	}
 
+	/// @brief Read a list of columns starting at the given token. A list may be split into tokens
+	/// at the spaces after its commas ("ORDER BY name, grade") and before braces ("ORDER BY COUNT(*)"),
+	/// these tokens are joined back
+	///
+	/// @param start - position of the first token of the list
+	/// @return the list, columns are separated by commas
+	string readColumnList(size_t start) const
+	{
+		string list = atToken(start);
+		while (!list.empty() && start + 1 < fTokens.size() && (list.back() == ',' || fTokens[start + 1].front() == '('))
+			list += fTokens[++start];
+
+		return list;
+	}
+
 	/// @brief Splits raw into parts(tokens) and pushes them inside tokens private member.
 	void tokenizeInnerString()
 	{
@@ -188,8 +254,38 @@ public:
 
 	string getOrderBy() const { return fOrderBy; }
 
+	string getGroupBy() const { return fGroupBy; }
+
 	bool isDistinct() const { return fIsDistinct; }
 
+	bool isDescending() const { return fIsDescending; }
+
+	/// @return the most records a SELECT returns, SIZE_MAX without LIMIT
+	size_t getLimit() const { return fLimit; }
+
+	/// @return the number of records a SELECT skips before the ones it returns, 0 without OFFSET
+	size_t getOffset() const { return fOffset; }
+
+	/// @brief Get the position of a keyword among the tokens (case insensitive)
+	/// @param token - keyword to look for
+	/// @return the position of the keyword, size() if it is not present
+	size_t findToken(const string& token) const
+	{
+		for (size_t i = 0; i < fTokens.size(); i++)
+			if (sh::toUpper(fTokens[i]) == sh::toUpper(token))
+				return i;
+
+		return fTokens.size();
+	}
+
+	/// @brief Check whether a keyword is present among the tokens (case insensitive)
+	/// @param token - keyword to look for
+	/// @return True if the keyword is present, false otherwise
+	bool hasToken(const string& token) const
+	{
+		return findToken(token) != fTokens.size();
+	}
+
 	/// @brief Getter
 	/// @return raw string
 	string& getRaw()
@@ -206,6 +302,10 @@ public:
 		{
 			return CommandType::CREATE_TABLE;
 		}
+		else if (cmd == "CREATEINDEX" || (cmd == "CREATE" && fTokens.size() > 1 && sh::toUpper(fTokens[1]) == "INDEX"))
+		{
+			return CommandType::CREATE_INDEX;
+		}
 		else if (cmd == "DROPTABLE")
 		{
 			return CommandType::DROP_TABLE;
@@ -226,6 +326,10 @@ public:
 		{
 			return CommandType::REMOVE;
 		}
+		else if (cmd == "UPDATE")
+		{
+			return CommandType::UPDATE;
+		}
 		else if (cmd == "SELECT")
 		{
 			return CommandType::SELECT;
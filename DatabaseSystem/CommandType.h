@@ -1,11 +1,13 @@
 #pragma once
 enum class CommandType {
 	CREATE_TABLE,
+	CREATE_INDEX,
 	DROP_TABLE,
 	LIST_TABLES,
 	TABLE_INFO,
 	INSERT,
 	REMOVE,
+	UPDATE,
 	SELECT,
 	EXIT,
 	NONE
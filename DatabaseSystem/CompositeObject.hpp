@@ -0,0 +1,158 @@
+#pragma once
+#include<vector>
+#include "Object.hpp"
+#include "ObjectType.h"
+
+using std::vector;
+
+/**
+ * @brief Descriptor of a key made of the values of several columns, used by composite indexes.
+ * Keys are compared lexicographically, column by column. Only the columns both keys have are compared,
+ * so a shorter key is equal to every key starting with the same values - that is what lets a lookup with
+ * values for a leading prefix of the columns find all keys sharing the prefix.
+*/
+class CompositeObject : public Object
+{
+public:
+	CompositeObject() {}
+
+	/**
+	 * @param parts - values of the key's columns, the object takes ownership of them
+	*/
+	CompositeObject(const vector<Object*>& parts) : fParts(parts) {}
+
+	CompositeObject(const CompositeObject& other)
+	{
+		copyFrom(other);
+	}
+
+	CompositeObject& operator=(const CompositeObject& other)
+	{
+		if (this != &other)
+		{
+			free();
+			copyFrom(other);
+		}
+
+		return *this;
+	}
+
+	~CompositeObject()
+	{
+		free();
+	}
+
+	virtual Object* clone() const final override
+	{
+		return new CompositeObject(*this);
+	}
+
+	virtual size_t memsize() const final override
+	{
+		size_t total = 0;
+		for (const Object* part : fParts)
+			total += part->memsize();
+
+		return total;
+	}
+
+	virtual std::string toString() const final override
+	{
+		std::string result;
+		for (size_t i = 0; i < fParts.size(); i++)
+			result += (i == 0 ? "" : ",") + fParts[i]->toString();
+
+		return result;
+	}
+
+	virtual size_t size() const final override
+	{
+		return toString().size();
+	}
+
+	virtual size_t hash() const final override
+	{
+		size_t seed = fParts.size();
+		for (const Object* part : fParts)
+			seed = combineHash(seed, part->hash());
+
+		return seed;
+	}
+
+	/**
+	 * @brief Mix the hash of the next part into the hash of the parts before it. Start with the number of parts as the seed
+	 * @param seed - hash of the parts so far
+	 * @param partHash - hash of the next part
+	 * @return hash of the parts including the next one
+	*/
+	static size_t combineHash(size_t seed, size_t partHash)
+	{
+		return seed ^ (partHash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+
+	virtual void write(ostream& out) const final override
+	{
+		ObjectType c = ObjectType::COMPOSITE;
+		out.write((char*)&c, sizeof(c));
+
+		size_t count = fParts.size();
+		out.write((char*)&count, sizeof(count));
+		for (const Object* part : fParts)
+			part->write(out);
+	}
+
+	size_t partsCount() const { return fParts.size(); }
+
+	const Object& getPart(size_t index) const { return *fParts.at(index); }
+
+private:
+	vector<Object*> fParts;
+
+	/**
+	 * @return negative, zero or positive if this key is less than, equal to or greater than the other
+	 * on the columns both of them have
+	*/
+	int compare(const CompositeObject& other) const
+	{
+		size_t common = fParts.size() < other.fParts.size() ? fParts.size() : other.fParts.size();
+		for (size_t i = 0; i < common; i++)
+		{
+			if (*fParts[i] < *other.fParts[i])
+				return -1;
+			if (*fParts[i] > *other.fParts[i])
+				return 1;
+		}
+
+		return 0;
+	}
+
+	virtual bool isGreaterThan(const Object& other) const final override
+	{
+		return compare(static_cast<const CompositeObject&>(other)) > 0;
+	}
+
+	virtual bool isEqualTo(const Object& other) const final override
+	{
+		return compare(static_cast<const CompositeObject&>(other)) == 0;
+	}
+
+	virtual bool isLesserThan(const Object& other) const final override
+	{
+		return compare(static_cast<const CompositeObject&>(other)) < 0;
+	}
+
+	void copyFrom(const CompositeObject& other)
+	{
+		fParts.reserve(other.fParts.size());
+		for (const Object* part : other.fParts)
+			fParts.push_back(part->clone());
+	}
+
+	void free()
+	{
+		for (Object* part : fParts)
+			delete part;
+
+		fParts.clear();
+	}
+};
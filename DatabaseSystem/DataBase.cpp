@@ -29,12 +29,12 @@ DataBase::DataBase(const string& name, const string& path)
 	save();
 }
 
-void DataBase::createTable(const string& path, const string& tableName, unordered_map<string, string>& colNameType, vector<string>& colNames, const string primaryKey, int maxRecordsPerPage)
+void DataBase::createTable(const string& path, const string& tableName, unordered_map<string, string>& colNameType, vector<string>& colNames, const string primaryKey, int maxRecordsPerPage, bool useTableSpace, IndexType indexType)
 {
 	if (fTables.find(tableName) != fTables.end())
 		throw invalid_argument("There is already a table with this name in the system");
 
-	Table t(fDBPath, tableName, colNameType, colNames, primaryKey, maxRecordsPerPage);
+	Table t(fDBPath, tableName, colNameType, colNames, primaryKey, maxRecordsPerPage, useTableSpace, indexType);
 	fTables[tableName] = t;
 	save();
 }
@@ -42,6 +42,7 @@ void DataBase::createTable(const string& path, const string& tableName, unordere
 void DataBase::dropTable(const string& tableName)
 {
 	string pathToDelete = getTable(tableName).getTablePath();
+	getTable(tableName).closeStorage();
 	std::error_code errorCode;
 	if (!fs::remove_all(pathToDelete, errorCode))
 		throw logic_error(errorCode.message());
@@ -50,22 +51,53 @@ void DataBase::dropTable(const string& tableName)
 	save();
 }
 
+void DataBase::createIndex(const string& tableName, const vector<string>& colNames, const vector<string>& includeColNames)
+{
+	getTable(tableName).createSecondaryIndex(colNames, includeColNames);
+	save();
+}
+
 void DataBase::insert(const string& tableName, vector<unordered_map<string, TypeWrapper>> colNameValueList)
 {
-	for (size_t i = 0; i < colNameValueList.size(); i++)
-		getTable(tableName).insert(colNameValueList[i]);
+	Table& table = getTable(tableName);
+	try
+	{
+		for (size_t i = 0; i < colNameValueList.size(); i++)
+			table.insert(colNameValueList[i]);
+	}
+	catch (...)
+	{
+		// The records inserted before the failing one stay in the table
+		table.commit();
+		throw;
+	}
 
-	save();
+	table.commit();
 }
 
 int DataBase::remove(const string& tableName, Query& query)
 {
-	int deletedRecords = getTable(tableName).deleteRecord(query);
+	Table& table = getTable(tableName);
+	int deletedRecords = table.deleteRecord(query);
 
-	save();
+	table.commit();
 	return deletedRecords;
 }
 
+int DataBase::update(const string& tableName, Query& query, const unordered_map<string, TypeWrapper>& colNameValue)
+{
+	Table& table = getTable(tableName);
+	int updatedRecords = table.update(query, colNameValue);
+
+	table.commit();
+	return updatedRecords;
+}
+
+void DataBase::checkpoint()
+{
+	for (pair<const string, Table>& entry : fTables)
+		entry.second.checkpoint();
+}
 
 void DataBase::listTables() const
 {
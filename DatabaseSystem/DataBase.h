@@ -15,8 +15,10 @@ public:
 	 * @param colNameType - hashtable where against each column name we have a column type (Integer, String, Double)
 	 * @param primaryKey - the name of the indexed column
 	 * @param maxRecordsPerPage - how many records we can keep in a page
+	 * @param useTableSpace - whether all pages of the table are kept in a single data file
+	 * @param indexType - the structure of the primary key index (B+ tree or hash)
 	*/
-	void createTable(const string& path, const string& tableName, unordered_map<string, string>& colNameType, vector<string>& colNames, const string primaryKey = "", int maxRecordsPerPage = 1024);
+	void createTable(const string& path, const string& tableName, unordered_map<string, string>& colNameType, vector<string>& colNames, const string primaryKey = "", int maxRecordsPerPage = 1024, bool useTableSpace = false, IndexType indexType = IndexType::BPTREE);
 
 	/**
 	 * @brief Attempts to drop a table with given name, removing it from fTables and deleting the binary file of the table on the disk
@@ -24,6 +26,15 @@ public:
 	*/
 	void dropTable(const string& tableName);
 
+	/**
+	 * @brief Attempts to create a secondary (non-unique) index on a column of the table with name {tableName},
+	 * or a composite index if several columns are given
+	 * @param tableName - name of table
+	 * @param colNames - names of the columns to be indexed
+	 * @param includeColNames - names of the columns whose values are stored in the index too
+	*/
+	void createIndex(const string& tableName, const vector<string>& colNames, const vector<string>& includeColNames);
+
 	/**
 	 * @brief Attempts to insert an array of records in the table with name {tableName}
 	 * @param tableName - name of table
@@ -33,6 +44,20 @@ public:
 
 	int remove(const string& tableName, Query& query);
 
+	/**
+	 * @brief Attempts to set new values of some columns of the records of the table with name {tableName} satisfying the query
+	 * @param tableName - name of table
+	 * @param query - WHERE clause, an empty one selects all records
+	 * @param colNameValue - new value of every updated column
+	 * @return the number of updated records
+	*/
+	int update(const string& tableName, Query& query, const unordered_map<string, TypeWrapper>& colNameValue);
+
+	/**
+	 * @brief Writes the changes of every table to its files and empties the tables' logs
+	*/
+	void checkpoint();
+
 	/**
 	 * @return the number of tables in the database
 	*/
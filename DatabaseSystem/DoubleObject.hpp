@@ -14,6 +14,8 @@ public:
 
 	DoubleObject(double value) : fValue(value) {}
 
+	double getValue() const { return fValue; }
+
 	virtual Object* clone() const final override
 	{
 		return new DoubleObject(*this);
@@ -34,7 +36,13 @@ public:
 		return to_string(fValue).size();
 	}
 
-	virtual void write(ofstream& out) const final override
+	virtual size_t hash() const final override
+	{
+		// 0.0 and -0.0 are equal, so they have to hash the same
+		return std::hash<double>()(fValue == 0 ? 0.0 : fValue);
+	}
+
+	virtual void write(ostream& out) const final override
 	{
 		ObjectType i = ObjectType::DOUBLE;
 		out.write((char*)&i, sizeof(i));
@@ -44,20 +52,20 @@ public:
 private:
 	double fValue;
 
+	// Values are compared exactly: equality within a tolerance isn't transitive and no hash can agree with it,
+	// so hash indexes and hash joins would miss values that compare equal
 	virtual bool isGreaterThan(const Object& other) const final override
 	{
-		double otherfValue = static_cast<const DoubleObject&>(other).fValue;
-		return (fValue - otherfValue) > ((fabs(fValue) < abs(otherfValue) ? abs(otherfValue) : abs(fValue)) * std::numeric_limits<double>::epsilon());
+		return fValue > static_cast<const DoubleObject&>(other).fValue;
 	}
 
 	virtual bool isEqualTo(const Object& other) const final override
 	{
-		return fabs(fValue - static_cast<const DoubleObject&>(other).fValue) < std::numeric_limits<double>::epsilon();
+		return fValue == static_cast<const DoubleObject&>(other).fValue;
 	}
 
 	virtual bool isLesserThan(const Object& other) const final override
 	{
-		double otherfValue = static_cast<const DoubleObject&>(other).fValue;
-		return (otherfValue - fValue) > ((fabs(fValue) < abs(otherfValue) ? abs(otherfValue) : abs(fValue)) * std::numeric_limits<double>::epsilon());
+		return fValue < static_cast<const DoubleObject&>(other).fValue;
 	}
 };
\ No newline at end of file
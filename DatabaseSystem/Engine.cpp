@@ -1,18 +1,25 @@
 #include "Engine.h"
 #include <algorithm>
+#include <mutex>
+#include <unordered_set>
 
 using std::max;
+using std::unordered_set;
 
 void Engine::menu()
 {
 	cout << yellow << "\t\t\t\t\t\t\tMENU" << endl;
-	cout << "CreateTable {tableName} (ColumnName1:DataType1, ColumnName2:DataType2..) Index ON {columnName}" << endl;
+	cout << "CreateTable {tableName} (ColumnName1:DataType1, ColumnName2:DataType2..) Index ON {columnName} USING {BTREE|HASH|ART} TABLESPACE" << endl;
+	cout << "CreateIndex ON {tableName}({columnName1}, {columnName2}...) INCLUDE ({columnName3}, {columnName4}...)" << endl;
 	cout << "DropTable {tableName}" << endl;
 	cout << "ListTables" << endl;
 	cout << "TableInfo {tableName}" << endl;
-	cout << "Select {columnNames} FROM {tableName} WHERE {condition1} {OR|AND} {condition2} OrderBy {columnName} DISTINCT" << endl;
+	cout << "Select {columnNames} FROM {tableName} WHERE {condition1} {OR|AND} {condition2} ORDER BY {columnName1}, {columnName2}... DESC LIMIT {count} OFFSET {count} DISTINCT" << endl;
+	cout << "Select {columnNames}, {COUNT|SUM|AVG|MIN|MAX|MEDIAN}({columnName|*}), PERCENTILE({columnName}, {fraction}) FROM {tableName} WHERE {condition} GROUP BY {columnNames}" << endl;
+	cout << "Select {columnNames} FROM {tableName1} JOIN {tableName2} ON {tableName1}.{columnName} = {tableName2}.{columnName} WHERE {condition}" << endl;
 	cout << "Remove FROM {tableName} WHERE {condition1} {OR|AND} {condition2} .." << endl;
-	cout << "Insert INTO {tableName} {(value1, value2...)}" << reset << endl;
+	cout << "Insert INTO {tableName} {(value1, value2...)}" << endl;
+	cout << "Update {tableName} SET {columnName1} = {value1}, {columnName2} = {value2}... WHERE {condition1} {OR|AND} {condition2} .." << reset << endl;
 }
 
 unordered_map<string, string> Engine::getColNameType(string scheme, vector<string>& colNames)
@@ -52,52 +59,291 @@ vector<unordered_map<string, TypeWrapper>> Engine::getColNameValues(string value
 		for (size_t j = 0; j < splitRecord.size(); j++)
 		{
 			string colName = indexColumn[j];
-			string colType = scheme[colName];
-
-			if (sh::isCorrectColumnType(colType, splitRecord[j]))
-			{
-				if (colType == "Integer")
-					colVal.insert({ colName, TypeWrapper(stoi(splitRecord[j])) });
-				else if (colType == "Double")
-					colVal.insert({ colName, TypeWrapper(stod(splitRecord[j])) });
-				else if (colType == "String")
-					colVal.insert({ colName, TypeWrapper(splitRecord[j]) });
-			}
-			else
-			{
-				throw invalid_argument("Invalid type for column {" + colName + "} with value {" + splitRecord[j] + "}");
-			}
+			colVal.insert({ colName, getValue(colName, scheme[colName], splitRecord[j]) });
 		}
 		result.push_back(colVal);
 	}
 	return result;
 }
 
+TypeWrapper Engine::getValue(const string& colName, const string& colType, const string& value) const
+{
+	if (!sh::isCorrectColumnType(colType, value))
+		throw invalid_argument("Invalid type for column {" + colName + "} with value {" + value + "}");
+
+	if (colType == "Integer")
+		return TypeWrapper(stoi(value));
+	else if (colType == "Double")
+		return TypeWrapper(stod(value));
+
+	return TypeWrapper(value);
+}
+
+unordered_map<string, TypeWrapper> Engine::getColNameAssignments(const string& assignments, const unordered_map<string, string>& scheme) const
+{
+	// Assignments are separated by the commas outside of quoted strings
+	vector<string> parts(1);
+	bool inQuotes = false;
+	for (char c : assignments)
+	{
+		if (c == '"')
+			inQuotes = !inQuotes;
+
+		if (c == ',' && !inQuotes)
+			parts.push_back("");
+		else
+			parts.back() += c;
+	}
+
+	unordered_map<string, TypeWrapper> colVal;
+	for (string& part : parts)
+	{
+		size_t equals = part.find('=');
+		if (equals == string::npos)
+			throw invalid_argument("Invalid assignment {" + part + "}, expected {columnName} = {value}");
+
+		string colName = part.substr(0, equals), value = part.substr(equals + 1);
+		sh::trim(colName);
+		sh::trim(value);
+		if (scheme.find(colName) == scheme.end())
+			throw invalid_argument("There is no column with name {" + colName + "}");
+
+		if (!colVal.insert({ colName, getValue(colName, scheme.at(colName), value) }).second)
+			throw invalid_argument("Column {" + colName + "} is assigned more than once");
+	}
+
+	return colVal;
+}
+
 Engine& Engine::getInstance()
 {
 	static Engine inst;
 	return inst;
 }
 
+vector<string> Engine::getColumnList(string list) const
+{
+	sh::trim(list);
+	if (list.size() >= 2 && list.front() == '(' && list.back() == ')')
+		list = list.substr(1, list.size() - 2);
+
+	vector<string> columns = sh::splitBy(list, ",");
+	for (string& column : columns)
+		sh::trim(column);
+
+	sh::removeEmptyStringsInVector(columns);
+	return columns;
+}
+
+void Engine::selectAggregates(Table& target, Query& query, vector<string>& selectedItems, const vector<string>& groupBy, const string& orderBy,
+	bool isDescending, size_t limit, size_t offset)
+{
+	// Columns of the answer: the GROUP BY columns followed by the aggregates in the order they were selected
+	unordered_map<string, size_t> resultIndex;
+	for (size_t i = 0; i < groupBy.size(); i++)
+		resultIndex[groupBy[i]] = i;
+
+	vector<Aggregate> aggregates;
+	for (const string& item : selectedItems)
+	{
+		Aggregate aggregate;
+		if (Aggregate::tryParse(item, aggregate))
+		{
+			resultIndex[item] = groupBy.size() + aggregates.size();
+			aggregates.push_back(aggregate);
+		}
+		else if (resultIndex.find(item) == resultIndex.end())
+		{
+			throw invalid_argument("Column " + item + " has to be aggregated or be part of GROUP BY");
+		}
+	}
+
+	vector<Record> answer = target.aggregate(query, groupBy, aggregates);
+	if (!orderBy.empty())
+	{
+		vector<int> columnIds;
+		for (const string& column : Table::splitColumnList(orderBy))
+		{
+			if (resultIndex.find(column) == resultIndex.end())
+				throw invalid_argument("Cannot order by " + column + ", it is not part of the answer");
+
+			columnIds.push_back(resultIndex[column]);
+		}
+
+		heapSort(answer, columnIds);
+		if (isDescending)
+			std::reverse(answer.begin(), answer.end());
+	}
+
+	answer.erase(answer.begin(), answer.begin() + std::min(offset, answer.size()));
+	if (answer.size() > limit)
+		answer.resize(limit);
+
+	printSelectedRecords(answer, selectedItems, resultIndex);
+}
+
+void Engine::selectJoin(Table& left, Table& right, const string& on, const string& where, vector<string>& selectedColumns, const string& orderBy, bool isDistinct,
+	bool isDescending, size_t limit, size_t offset)
+{
+	// The sides of the ON condition may name the tables in any order
+	vector<string> sides = sh::splitBy(on, "=");
+	if (sides.size() != 2)
+		throw invalid_argument("Invalid JOIN condition {" + on + "}, expected {table}.{column} = {table}.{column}");
+
+	string leftColumn, rightColumn;
+	for (string& side : sides)
+	{
+		sh::trim(side);
+		size_t dot = side.find('.');
+		string table = dot == string::npos ? "" : side.substr(0, dot);
+		if (table == left.getTableName() && leftColumn.empty())
+			leftColumn = side.substr(dot + 1);
+		else if (table == right.getTableName() && rightColumn.empty())
+			rightColumn = side.substr(dot + 1);
+		else
+			throw invalid_argument("Invalid JOIN condition {" + on + "}, expected {table}.{column} = {table}.{column}");
+	}
+
+	Join join(left, leftColumn, right, rightColumn);
+	const unordered_map<string, size_t>& colIndex = join.getColIndex();
+	if (selectedColumns.size() == 1 && selectedColumns[0] == "*")
+		selectedColumns = join.getColumns();
+
+	for (const string& column : selectedColumns)
+		if (colIndex.find(column) == colIndex.end())
+			throw invalid_argument("There is no column with name {" + column + "} in the joined tables, a column both tables have is named {table}.{column}");
+
+	// Joined records are filtered as they come out of the join, every worker keeps its own matches
+	Query query(where, join.getScheme(), "");
+	bool hasQuery = !query.getShuntingOutput().empty();
+	vector<vector<Record>> perWorker;
+
+	// Without an order, duplicates to drop or records to skip nothing needs the whole answer, so every worker prints its
+	// matches JOIN_PRINT_BATCH at a time. The columns only get wider, the header is printed again when a batch widens one
+	if (orderBy.empty() && !isDistinct && limit == SIZE_MAX && offset == 0)
+	{
+		std::mutex printing;
+		unordered_map<string, size_t> longestWordsPerCol;
+		bool hasHeader = false;
+		size_t printed = 0;
+		auto print = [&](vector<Record>& records)
+			{
+				std::lock_guard<std::mutex> lock(printing);
+				bool isWider = !hasHeader;
+				for (const std::pair<const string, size_t>& longest : getLongestWordPerCol(records, selectedColumns, colIndex))
+				{
+					if (longest.second > longestWordsPerCol[longest.first])
+					{
+						longestWordsPerCol[longest.first] = longest.second;
+						isWider = true;
+					}
+				}
+
+				if (isWider)
+					printHeader(selectedColumns, longestWordsPerCol);
+
+				hasHeader = true;
+				printRecords(records, selectedColumns, colIndex, longestWordsPerCol);
+				printed += records.size();
+				records.clear();
+			};
+
+		join.run([&](size_t workers) { perWorker.resize(workers); }, [&](const Record& l, const Record& r, size_t worker)
+			{
+				Record joined = join.combine(l, r);
+				if (hasQuery && !query.checkRecordAgainstQuery(joined, colIndex))
+					return;
+
+				perWorker[worker].push_back(std::move(joined));
+				if (perWorker[worker].size() == JOIN_PRINT_BATCH)
+					print(perWorker[worker]);
+			});
+
+		vector<Record> rest;
+		for (vector<Record>& records : perWorker)
+			for (Record& r : records)
+				rest.push_back(std::move(r));
+
+		print(rest);
+		cout << "Total " << printed << " records selected." << endl;
+		return;
+	}
+
+	join.run([&](size_t workers) { perWorker.resize(workers); }, [&](const Record& l, const Record& r, size_t worker)
+		{
+			Record joined = join.combine(l, r);
+			if (!hasQuery || query.checkRecordAgainstQuery(joined, colIndex))
+				perWorker[worker].push_back(std::move(joined));
+		});
+
+	vector<Record> answer;
+	for (vector<Record>& records : perWorker)
+		for (Record& r : records)
+			answer.push_back(std::move(r));
+
+	if (isDistinct)
+	{
+		unordered_set<vector<TypeWrapper>, GroupKeyHash, GroupKeyEqual> seen;
+		vector<Record> unique;
+		for (Record& r : answer)
+		{
+			vector<TypeWrapper> values;
+			for (const string& column : selectedColumns)
+				values.push_back(r.get(colIndex.at(column)));
+
+			if (seen.insert(values).second)
+				unique.push_back(std::move(r));
+		}
+
+		answer = std::move(unique);
+	}
+
+	if (!orderBy.empty())
+	{
+		vector<int> columnIds;
+		for (const string& column : Table::splitColumnList(orderBy))
+		{
+			if (colIndex.find(column) == colIndex.end())
+				throw invalid_argument("Cannot order by " + column + ", it is not part of the joined tables");
+
+			columnIds.push_back(colIndex.at(column));
+		}
+
+		heapSort(answer, columnIds);
+		if (isDescending)
+			std::reverse(answer.begin(), answer.end());
+	}
+
+	answer.erase(answer.begin(), answer.begin() + std::min(offset, answer.size()));
+	if (answer.size() > limit)
+		answer.resize(limit);
+
+	printSelectedRecords(answer, selectedColumns, colIndex);
+}
+
 void Engine::printSelectedRecords(vector<Record>& records, vector<string>& selectedColumns, unordered_map<string, size_t> colIndex) const
 {
 	unordered_map<string, size_t> longestWordsPerCol = getLongestWordPerCol(records, selectedColumns, colIndex);
 	printHeader(selectedColumns, longestWordsPerCol);
+	printRecords(records, selectedColumns, colIndex, longestWordsPerCol);
+	cout << "Total " << records.size() << " records selected." << endl;
+}
 
+void Engine::printRecords(vector<Record>& records, vector<string>& selectedColumns, const unordered_map<string, size_t>& colIndex,
+	unordered_map<string, size_t>& longestWordsPerCol) const
+{
 	for (size_t i = 0; i < records.size(); i++)
 	{
 		cout << " | ";
 		for (size_t j = 0; j < selectedColumns.size(); j++)
 		{
-			TypeWrapper content = records[i].get(colIndex[selectedColumns[j]]);
+			TypeWrapper content = records[i].get(colIndex.at(selectedColumns[j]));
 			printCellInformation(content, longestWordsPerCol[selectedColumns[j]], selectedColumns[j].size());
 			cout << " | ";
 		}
 
 		cout << endl;
 	}
-
-	cout << "Total " << records.size() << " records selected." << endl;
 }
 
 void Engine::printCellInformation(TypeWrapper& cell, size_t longestWordOfCol, size_t colSize) const
@@ -214,7 +460,20 @@ void Engine::run()
 					vector<string> colNames;
 					unordered_map<string, string> scheme = getColNameType(cp.atToken(2), colNames);
 					string primaryKey = cp.size() >= 6 ? cp.atToken(5) : "";
-					db.createTable(dbPath, tblName, scheme, colNames, primaryKey);
+					bool useTableSpace = cp.hasToken("TABLESPACE");
+					IndexType indexType = IndexType::BPTREE;
+					if (cp.hasToken("USING"))
+					{
+						string structure = sh::toUpper(cp.atToken(cp.findToken("USING") + 1));
+						if (structure == "HASH")
+							indexType = IndexType::HASH;
+						else if (structure == "ART")
+							indexType = IndexType::ART;
+						else if (structure != "BTREE")
+							throw invalid_argument("Unknown index structure " + structure + ", expected BTREE, HASH or ART");
+					}
+
+					db.createTable(dbPath, tblName, scheme, colNames, primaryKey, 1024, useTableSpace, indexType);
 				}
 				catch (const invalid_argument& e)
 				{
@@ -228,6 +487,37 @@ void Engine::run()
 				}
 
 				cout << green << "Table " << cp.atToken(1) << " created!" << reset << endl;
+				break;
+			case CommandType::CREATE_INDEX:
+				try
+				{
+					if (cp.hasToken("USING"))
+						throw invalid_argument("Secondary indexes are always B+ trees, USING is supported only for the primary key index");
+
+					size_t on = cp.findToken("ON");
+					string tblName = cp.atToken(on + 1);
+					vector<string> colNames = getColumnList(cp.atToken(on + 2));
+					vector<string> includeColNames;
+					size_t include = cp.findToken("INCLUDE");
+					if (include < cp.size())
+						includeColNames = getColumnList(cp.atToken(include + 1));
+
+					string colName;
+					for (size_t i = 0; i < colNames.size(); i++)
+						colName += (i == 0 ? "" : ",") + colNames[i];
+
+					db.createIndex(tblName, colNames, includeColNames);
+					cout << green << "Index on " << tblName << "(" << colName << ") created!" << reset << endl;
+				}
+				catch (const invalid_argument& e)
+				{
+					cout << red << e.what() << reset << endl;
+				}
+				catch (const out_of_range& e)
+				{
+					cout << red << e.what() << reset << endl;
+				}
+
 				break;
 			case CommandType::DROP_TABLE:
 				try
@@ -272,6 +562,15 @@ void Engine::run()
 						scheme += name + ":" + t.getTableScheme().at(name) + ", ";
 
 					scheme += ") " + (t.getPrimaryKey().empty() ? "No Index on this table" : ("Index ON " + t.getPrimaryKey()));
+					if (!t.getPrimaryKey().empty() && t.getPrimaryIndexType() == IndexType::HASH)
+						scheme += " USING HASH";
+					else if (!t.getPrimaryKey().empty() && t.getPrimaryIndexType() == IndexType::ART)
+						scheme += " USING ART";
+					for (const SecondaryIndex& index : t.getSecondaryIndexes())
+						scheme += ", Index ON " + index.getDescription() + " (" + to_string(index.distinctKeys()) + " distinct values)";
+
+					if (t.isUsingTableSpace())
+						scheme += " (stored in a single tablespace file)";
 
 					cout << yellow << "Table " << cp.atToken(1) << " : " << scheme << endl;
 
@@ -334,11 +633,57 @@ void Engine::run()
 			case CommandType::SELECT:
 				try
 				{
-					vector<string> selectedColumns = sh::splitBy(cp.atToken(1), ",");
+					vector<string> selectedColumns = Table::splitColumnList(cp.atToken(1));
 					string tblName = cp.atToken(3);
 					Table& target = db.getTable(tblName);
 					bool isDistinct = cp.isDistinct();
 					string orderBy = cp.getOrderBy();
+					bool isDescending = cp.isDescending();
+					size_t limit = cp.getLimit();
+					size_t offset = cp.getOffset();
+
+					vector<string> groupBy = Table::splitColumnList(cp.getGroupBy());
+					bool hasAggregates = false;
+					for (const string& item : selectedColumns)
+					{
+						Aggregate aggregate;
+						hasAggregates = hasAggregates || Aggregate::tryParse(item, aggregate);
+					}
+
+					if (cp.size() > 4 && sh::toUpper(cp.atToken(4)) == "JOIN")
+					{
+						if (hasAggregates || !groupBy.empty())
+							throw invalid_argument("Aggregate functions and GROUP BY cannot be used with JOIN");
+
+						Table& right = db.getTable(cp.atToken(5));
+						if (cp.size() <= 6 || sh::toUpper(cp.atToken(6)) != "ON")
+							throw invalid_argument("JOIN needs a condition: JOIN {tableName} ON {table}.{column} = {table}.{column}");
+
+						// The ON condition runs until the WHERE clause or the ORDER BY/GROUP BY/DISTINCT/LIMIT/OFFSET keywords
+						string on, where;
+						size_t i = 7;
+						for (; i < cp.size(); i++)
+						{
+							string token = sh::toUpper(cp.atToken(i));
+							if (token.rfind("WHERE", 0) == 0 || token == "ORDER" || token == "GROUP" || token == "DISTINCT" || token == "LIMIT" || token == "OFFSET")
+								break;
+
+							on += cp.atToken(i);
+						}
+
+						if (i < cp.size() && sh::toUpper(cp.atToken(i)).rfind("WHERE", 0) == 0)
+							where = cp.atToken(i);
+
+						selectJoin(target, right, on, where, selectedColumns, orderBy, isDistinct, isDescending, limit, offset);
+						break;
+					}
+
+					if (hasAggregates || !groupBy.empty())
+					{
+						Query query(cp.size() <= 4 ? "" : cp.atToken(4), target.getTableScheme(), target.getPrimaryKey());
+						selectAggregates(target, query, selectedColumns, groupBy, orderBy, isDescending, limit, offset);
+						break;
+					}
 
 					if (cp.size() <= 4)
 					{
@@ -347,12 +692,12 @@ void Engine::run()
 						{
 							selectedColumns = sh::splitBy(db.getTable(tblName).getTableHeader(), ",");
 							sh::removeEmptyStringsInVector(selectedColumns);
-							vector<Record> answer = target.select(q, orderBy, isDistinct, selectedColumns);
+							vector<Record> answer = target.select(q, orderBy, isDistinct, selectedColumns, isDescending, limit, offset);
 							printSelectedRecords(answer, selectedColumns, target.getColIndex());
 						}
 						else
 						{
-							vector<Record> answer = target.select(q, orderBy, isDistinct, selectedColumns);
+							vector<Record> answer = target.select(q, orderBy, isDistinct, selectedColumns, isDescending, limit, offset);
 							printSelectedRecords(answer, selectedColumns, target.getColIndex());
 						}
 					}
@@ -363,12 +708,12 @@ void Engine::run()
 						{
 							selectedColumns = sh::splitBy(db.getTable(tblName).getTableHeader(), ",");
 							sh::removeEmptyStringsInVector(selectedColumns);
-							vector<Record> answer = target.select(query, orderBy, isDistinct, selectedColumns);
+							vector<Record> answer = target.select(query, orderBy, isDistinct, selectedColumns, isDescending, limit, offset);
 							printSelectedRecords(answer, selectedColumns, target.getColIndex());
 						}
 						else
 						{
-							vector<Record> answer = target.select(query, orderBy, isDistinct, selectedColumns);
+							vector<Record> answer = target.select(query, orderBy, isDistinct, selectedColumns, isDescending, limit, offset);
 							printSelectedRecords(answer, selectedColumns, target.getColIndex());
 						}
 					}
@@ -404,8 +749,47 @@ void Engine::run()
 					break;
 				}
 
+				break;
+			case CommandType::UPDATE:
+				try
+				{
+					string tblName = cp.atToken(1);
+					Table& target = db.getTable(tblName);
+					if (sh::toUpper(cp.atToken(2)) != "SET")
+						throw invalid_argument("Invalid command, expected Update {tableName} SET {columnName} = {value}...");
+
+					// The assignments run until the WHERE clause, a table without one has all of its records updated
+					string assignments, where;
+					for (size_t i = 3; i < cp.size(); i++)
+					{
+						if (sh::toUpper(cp.atToken(i)).rfind("WHERE", 0) == 0)
+						{
+							where = cp.atToken(i);
+							break;
+						}
+
+						assignments += cp.atToken(i);
+					}
+
+					unordered_map<string, TypeWrapper> values = getColNameAssignments(assignments, target.getTableScheme());
+					Query query(where, target.getTableScheme(), target.getPrimaryKey());
+					int updatedRecords = db.update(tblName, query, values);
+					cout << green << "Total " << updatedRecords << " rows updated in " << tblName << reset << endl;
+				}
+				catch (const invalid_argument& e)
+				{
+					cout << red << e.what() << reset << endl;
+					break;
+				}
+				catch (const out_of_range& e)
+				{
+					cout << red << e.what() << reset << endl;
+					break;
+				}
+
 				break;
 			case CommandType::EXIT:
+				db.checkpoint();
 				db.save();
 				cout << green << "Goodbye" << reset << endl;
 				return;
@@ -2,6 +2,7 @@
 #include<iostream>
 #include "termcolor.hpp"
 #include "Database.h"
+#include "Join.hpp"
 #include "CommandParser.hpp"
 
 using std::cout;
@@ -37,8 +38,69 @@ private:
 	*/
 	vector<unordered_map<string, TypeWrapper>> getColNameValues(string values, unordered_map<string, string>& scheme, unordered_map<size_t, string>& indexColumn);
 
+	/**
+	 * @brief Convert a stringified value to the type of its column
+	 * @param colName - name of the column
+	 * @param colType - type of the column
+	 * @param value - stringified value
+	 * @return the value, throws invalid_argument if it doesn't match the column's type
+	*/
+	TypeWrapper getValue(const string& colName, const string& colType, const string& value) const;
+
+	/**
+	 * @brief By given assignments in form {columnName1} = {value1}, {columnName2} = {value2}... get the new value of every column
+	 * @param assignments - stringified assignments of an Update
+	 * @param scheme - types of the table's columns
+	 * @return hashtable with the new value against each assigned column
+	*/
+	unordered_map<string, TypeWrapper> getColNameAssignments(const string& assignments, const unordered_map<string, string>& scheme) const;
+
+	/**
+	 * @brief By given list of columns in form ({columnName1}, {columnName2}...) get the column names
+	 * @param list - stringified list of columns, the braces are optional
+	 * @return the trimmed column names
+	*/
+	vector<string> getColumnList(string list) const;
+
+	/**
+	 * @brief Execute and print a Select having aggregate functions or GROUP BY
+	 * @param target - table to select from
+	 * @param query - WHERE clause
+	 * @param selectedItems - selected GROUP BY columns and aggregate functions, i.e. "name", "COUNT(*)", "AVG(grade)"
+	 * @param groupBy - GROUP BY columns
+	 * @param orderBy - columns or aggregates of the answer to order by, separated by commas
+	 * @param isDescending - if True the answer is ordered from the greatest to the smallest
+	 * @param limit - the most groups to print
+	 * @param offset - the number of groups skipped before the printed ones
+	*/
+	void selectAggregates(Table& target, Query& query, vector<string>& selectedItems, const vector<string>& groupBy, const string& orderBy,
+		bool isDescending, size_t limit, size_t offset);
+
+	/**
+	 * @brief Execute and print a Select joining two tables with the cheapest join strategy, see Join
+	 * @param left - table named after FROM
+	 * @param right - table named after JOIN
+	 * @param on - join condition, {table}.{column} = {table}.{column}
+	 * @param where - WHERE clause over the joined records, may be empty
+	 * @param selectedColumns - selected columns, plain or qualified with the table name
+	 * @param orderBy - columns to order by, separated by commas
+	 * @param isDistinct - if True then the answer shall not contain any duplicates of the selected columns
+	 * @param isDescending - if True the answer is ordered from the greatest to the smallest
+	 * @param limit - the most joined records to print
+	 * @param offset - the number of joined records skipped before the printed ones
+	*/
+	void selectJoin(Table& left, Table& right, const string& on, const string& where, vector<string>& selectedColumns, const string& orderBy, bool isDistinct,
+		bool isDescending, size_t limit, size_t offset);
+
 	void printSelectedRecords(vector<Record>& records, vector<string>& selectedColumns, unordered_map<string, size_t> colIndex) const;
 
+	/**
+	 * @brief Print the rows of the records, without a header and a total
+	 * @param longestWordsPerCol - width of every selected column, at least as wide as the records' values
+	*/
+	void printRecords(vector<Record>& records, vector<string>& selectedColumns, const unordered_map<string, size_t>& colIndex,
+		unordered_map<string, size_t>& longestWordsPerCol) const;
+
 	void printHeader(vector<string>& selectedColumns, unordered_map<string, size_t>& longestWordsPerCol) const;
 
 	size_t getLongestContentAtCol(size_t col, vector<Record>& records) const;
@@ -1,15 +1,23 @@
 #pragma once
+#include<cstdio>
 #include<fstream>
 #include<string>
+#ifdef _WIN32
+#include<io.h>
+#else
+#include<unistd.h>
+#endif
 
 using std::ifstream;
 using std::string;
 using std::ofstream;
+using std::istream;
+using std::ostream;
 
 class FileHelper
 {
 public:
-	static void readString(ifstream& in, string& dest)
+	static void readString(istream& in, string& dest)
 	{
 		size_t size = 0;
 		char* str = nullptr;
@@ -21,10 +29,100 @@ public:
 		delete[] str;
 	}
 
-	static void writeString(ofstream& out, string dest)
+	static void writeString(ostream& out, string dest)
 	{
 		size_t size = dest.size();
 		out.write((char*)&size, sizeof(size));
 		out.write((char*)dest.c_str(), size);
 	}
+
+	/**
+	 * @brief Write a length in as few bytes as it needs, 7 bits in a byte with the high bit set on all bytes but the last
+	 * @param out - output stream
+	 * @param length - the length
+	*/
+	static void writeLength(ostream& out, size_t length)
+	{
+		while (length >= 0x80)
+		{
+			out.put((char)((length & 0x7F) | 0x80));
+			length >>= 7;
+		}
+
+		out.put((char)length);
+	}
+
+	/**
+	 * @brief Read a length written by writeLength
+	 * @param in - input stream, its fail bit is set if the length is cut off or too long
+	 * @param length - set to the length
+	*/
+	static void readLength(istream& in, size_t& length)
+	{
+		length = 0;
+		for (size_t shift = 0; shift < sizeof(size_t) * 8; shift += 7)
+		{
+			char byte = 0;
+			if (!in.get(byte))
+				return;
+
+			length |= (size_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return;
+		}
+
+		in.setstate(std::ios::failbit);
+	}
+
+	/**
+	 * @brief Open a C file stream, used where the file has to be forced to the disk
+	 * @param path - path of the file
+	 * @param mode - fopen mode
+	 * @return the stream, nullptr if the file couldn't be opened
+	*/
+	static FILE* openFile(const string& path, const char* mode)
+	{
+#ifdef _WIN32
+		FILE* file = nullptr;
+		if (fopen_s(&file, path.c_str(), mode) != 0)
+			return nullptr;
+
+		return file;
+#else
+		return fopen(path.c_str(), mode);
+#endif
+	}
+
+	/**
+	 * @brief Flush a file stream and wait until the operating system has written its data to the disk
+	 * @param file - the stream
+	 * @return True on success
+	*/
+	static bool syncFile(FILE* file)
+	{
+		if (fflush(file) != 0)
+			return false;
+
+#ifdef _WIN32
+		return _commit(_fileno(file)) == 0;
+#else
+		return fsync(fileno(file)) == 0;
+#endif
+	}
+
+	/**
+	 * @brief Wait until everything written to the file at the given path is on the disk
+	 * @param path - path of a file written and closed before
+	 * @return True on success
+	*/
+	static bool syncFile(const string& path)
+	{
+		FILE* file = openFile(path, "ab");
+		if (file == nullptr)
+			return false;
+
+		bool synced = syncFile(file);
+		fclose(file);
+		return synced;
+	}
 };
@@ -0,0 +1,198 @@
+#pragma once
+#include<vector>
+#include "RecordPtr.hpp"
+#include "TypeWrapper.hpp"
+
+using std::vector;
+
+#define DEFAULT_HASH_CAPACITY 16
+
+// Hash table slot
+class HashSlot {
+public:
+	bool fIsUsed;
+	TypeWrapper fKey;
+	RecordPtr fPtr;
+
+	HashSlot() : fIsUsed(false) {}
+};
+
+/**
+ * @brief Descriptor of a unique hash index from key to record pointer.
+ * Open addressing with linear probing over a power of two number of slots, grown twice when 70% full.
+ * Removal shifts the following entries of the probe sequence back, so there are no tombstones and
+ * the slots can be written to and read from file as they are, without rehashing on load.
+ * Only equality lookups are supported.
+*/
+class HashIndex
+{
+public:
+	HashIndex() : fSlots(DEFAULT_HASH_CAPACITY), fSize(0) {}
+
+	/**
+	 * @brief Reading constructor, every entry is put directly in the slot it was saved from
+	 * @param in - input stream
+	*/
+	HashIndex(istream& in) : fSize(0)
+	{
+		size_t capacity = 0;
+		in.read((char*)&capacity, sizeof(capacity));
+		in.read((char*)&fSize, sizeof(fSize));
+		fSlots.resize(capacity);
+
+		for (size_t i = 0; i < fSize; i++)
+		{
+			size_t slot = 0;
+			in.read((char*)&slot, sizeof(slot));
+			fSlots[slot].fKey = TypeWrapper(in);
+			fSlots[slot].fPtr = RecordPtr(in);
+			fSlots[slot].fIsUsed = true;
+		}
+	}
+
+	/**
+	 * @brief Write the used slots to file together with their positions
+	 * @param out - output stream
+	*/
+	void write(ostream& out) const
+	{
+		size_t capacity = fSlots.size();
+		out.write((char*)&capacity, sizeof(capacity));
+		out.write((char*)&fSize, sizeof(fSize));
+
+		for (size_t slot = 0; slot < fSlots.size(); slot++)
+		{
+			if (!fSlots[slot].fIsUsed)
+				continue;
+
+			out.write((char*)&slot, sizeof(slot));
+			fSlots[slot].fKey.write(out);
+			fSlots[slot].fPtr.write(out);
+		}
+	}
+
+	/**
+	 * @brief Insert a key with the pointer to its record
+	 * @return False if the key is already in the index (nothing is inserted), True otherwise
+	*/
+	bool insert(const TypeWrapper& key, const RecordPtr& ptr)
+	{
+		if ((fSize + 1) * 10 > fSlots.size() * 7)
+			grow();
+
+		size_t slot = findSlot(key);
+		if (fSlots[slot].fIsUsed)
+			return false;
+
+		fSlots[slot].fKey = key;
+		fSlots[slot].fPtr = ptr;
+		fSlots[slot].fIsUsed = true;
+		fSize++;
+		return true;
+	}
+
+	/**
+	 * @brief Look up a key
+	 * @param key - key to be searched for
+	 * @param ptr - set to the pointer of the key's record if the key is found
+	 * @return True if the key is in the index, false otherwise
+	*/
+	bool find(const TypeWrapper& key, RecordPtr& ptr) const
+	{
+		size_t slot = findSlot(key);
+		if (!fSlots[slot].fIsUsed)
+			return false;
+
+		ptr = fSlots[slot].fPtr;
+		return true;
+	}
+
+	bool contains(const TypeWrapper& key) const
+	{
+		return fSlots[findSlot(key)].fIsUsed;
+	}
+
+	/**
+	 * @brief Remove a key, the entries after it in the probe sequence are moved back to close the gap
+	 * @param key - key to be removed
+	*/
+	void remove(const TypeWrapper& key)
+	{
+		size_t hole = findSlot(key);
+		if (!fSlots[hole].fIsUsed)
+			return;
+
+		fSlots[hole] = HashSlot();
+		fSize--;
+
+		size_t mask = fSlots.size() - 1;
+		size_t next = hole;
+		while (true)
+		{
+			next = (next + 1) & mask;
+			if (!fSlots[next].fIsUsed)
+				break;
+
+			// The entry stays if its home slot lies cyclically in (hole, next]
+			size_t home = homeSlot(fSlots[next].fKey);
+			bool staysInPlace = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+			if (staysInPlace)
+				continue;
+
+			fSlots[hole] = std::move(fSlots[next]);
+			fSlots[next] = HashSlot();
+			hole = next;
+		}
+	}
+
+	/**
+	 * @brief Remove a batch of keys
+	 * @param keys - keys to be removed, keys that are not in the index are skipped
+	*/
+	void remove(const vector<TypeWrapper>& keys)
+	{
+		for (const TypeWrapper& key : keys)
+			remove(key);
+	}
+
+	size_t size() const { return fSize; }
+
+private:
+	vector<HashSlot> fSlots;
+	size_t fSize;
+
+	size_t homeSlot(const TypeWrapper& key) const
+	{
+		return key.hash() & (fSlots.size() - 1);
+	}
+
+	/**
+	 * @return the slot holding the key, or the empty slot where the probing for it stopped
+	*/
+	size_t findSlot(const TypeWrapper& key) const
+	{
+		size_t mask = fSlots.size() - 1;
+		size_t slot = homeSlot(key);
+		while (fSlots[slot].fIsUsed && !(fSlots[slot].fKey == key))
+			slot = (slot + 1) & mask;
+
+		return slot;
+	}
+
+	void grow()
+	{
+		vector<HashSlot> old(fSlots.size() * 2);
+		std::swap(old, fSlots);
+		fSize = 0;
+
+		for (HashSlot& entry : old)
+		{
+			if (!entry.fIsUsed)
+				continue;
+
+			size_t slot = findSlot(entry.fKey);
+			fSlots[slot] = std::move(entry);
+			fSize++;
+		}
+	}
+};
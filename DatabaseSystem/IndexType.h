@@ -0,0 +1,7 @@
+#pragma once
+enum class IndexType
+{
+	BPTREE,
+	HASH,
+	ART
+};
@@ -12,6 +12,8 @@ public:
 
 	IntegerObject(int value) : fValue(value) {}
 
+	int getValue() const { return fValue; }
+
 	virtual Object* clone() const final override
 	{
 		return new IntegerObject(*this);
@@ -32,7 +34,12 @@ public:
 		return to_string(fValue).size();
 	}
 
-	virtual void write(ofstream& out) const final override
+	virtual size_t hash() const final override
+	{
+		return std::hash<int>()(fValue);
+	}
+
+	virtual void write(ostream& out) const final override
 	{
 		ObjectType i = ObjectType::INT;
 		out.write((char*)&i, sizeof(i));
@@ -0,0 +1,540 @@
+#pragma once
+#include<algorithm>
+#include<atomic>
+#include<limits>
+#include<memory>
+#include<unordered_map>
+#include "Table.hpp"
+#include "JoinStrategy.h"
+
+using std::unique_ptr;
+
+#define JOIN_MEMORY_BUDGET (64 * 1024 * 1024)
+#define JOIN_MAX_PARTITIONS 128
+#define JOIN_INDEX_PROBE_COST 16
+#define JOIN_PROBE_BATCH 1024
+#define JOIN_MERGE_BATCH 4096
+#define JOIN_PRINT_BATCH 1024
+
+/**
+ * @brief Descriptor of a join of two tables on the equality of a column of each ({left}.{column} = {right}.{column}).
+ * The strategy is chosen by the sizes of the tables and the indexes on the join columns:
+ *
+ * - Index nested loop: when one table is much smaller than the other and the join column of the bigger one is indexed,
+ * the smaller table is scanned and every record looks its matches up in the index. Only the pages holding matches are read.
+ *
+ * - Sort-merge: when the join columns of both tables have B+ tree indexes, both tables can be read in key order and the
+ * matching runs of keys merged. Only the records of one key are kept in memory, so it is used instead of spilling a hash join to disk.
+ *
+ * - Hash: otherwise the smaller table is the build side: its records are put in a hash table by the value of the join column.
+ * The records of the other table, the probe side, are then streamed out of their pages and looked up in the hash table.
+ * When the build side doesn't fit in the memory budget the join turns into a grace hash join: both sides are first split
+ * by the hash of the join column into partitions kept in files on the disk. Matching records always land in partitions with
+ * the same number, so the partitions are joined pair by pair afterwards, and only one build partition per worker is in memory.
+ *
+ * Every match is handed out as soon as it is found. The joined records hold the columns of the left table followed by
+ * the columns of the right one. A column is named {table}.{column}, and also just {column} if no column of the other table has the same name.
+*/
+class Join
+{
+public:
+	/**
+	 * @param left - left table of the join
+	 * @param leftColumn - join column of the left table
+	 * @param right - right table of the join
+	 * @param rightColumn - join column of the right table
+	 * @param memoryBudget - the most bytes of build side records kept in memory
+	*/
+	Join(Table& left, const string& leftColumn, Table& right, const string& rightColumn, size_t memoryBudget = JOIN_MEMORY_BUDGET)
+		: fLeft(left), fRight(right), fLeftColumn(leftColumn), fRightColumn(rightColumn), fMemoryBudget(memoryBudget), fPartitions(1)
+	{
+		if (left.getTableName() == right.getTableName())
+			throw invalid_argument("Cannot join table " + left.getTableName() + " with itself");
+
+		if (left.getColIndex().find(leftColumn) == left.getColIndex().end())
+			throw invalid_argument("There is no column with name {" + leftColumn + "} in table " + left.getTableName());
+
+		if (right.getColIndex().find(rightColumn) == right.getColIndex().end())
+			throw invalid_argument("There is no column with name {" + rightColumn + "} in table " + right.getTableName());
+
+		if (left.getTableScheme().at(leftColumn) != right.getTableScheme().at(rightColumn))
+			throw invalid_argument("Cannot join columns " + leftColumn + " and " + rightColumn + " of different types");
+
+		fLeftKeyPos = left.getColIndex().at(leftColumn);
+		fRightKeyPos = right.getColIndex().at(rightColumn);
+		initializeColumns();
+		chooseStrategy();
+	}
+
+	/**
+	 * @brief Run the join
+	 * @param prepare - called once before the join with the number of workers that may emit records
+	 * @param emit - called with every pair of matching records, the left table's one first, and the number of the worker that found it
+	*/
+	void run(const std::function<void(size_t)>& prepare, const std::function<void(const Record&, const Record&, size_t)>& emit)
+	{
+		prepare(ph::getWorkersCount(std::numeric_limits<size_t>::max()));
+		if (fStrategy == JoinStrategy::INDEX_NESTED_LOOP)
+			joinIndexNestedLoop(emit);
+		else if (fStrategy == JoinStrategy::SORT_MERGE)
+			joinSortMerge(emit);
+		else if (fPartitions == 1)
+			joinInMemory(emit);
+		else
+			joinPartitions(emit);
+	}
+
+	/**
+	 * @brief Concatenate the records of a matching pair into a joined record
+	*/
+	Record combine(const Record& left, const Record& right) const
+	{
+		Record joined(fColumns.size());
+		for (size_t i = 0; i < left.size(); i++)
+			joined.addValue(left.get(i));
+		for (size_t i = 0; i < right.size(); i++)
+			joined.addValue(right.get(i));
+
+		return joined;
+	}
+
+	/**
+	 * @return the qualified names of the columns of the joined records, in order
+	*/
+	const vector<string>& getColumns() const { return fColumns; }
+
+	/**
+	 * @return the position of every column in the joined records, by qualified and by unambiguous plain name
+	*/
+	const unordered_map<string, size_t>& getColIndex() const { return fColIndex; }
+
+	/**
+	 * @return the type of every column of the joined records, by qualified and by unambiguous plain name
+	*/
+	const unordered_map<string, string>& getScheme() const { return fScheme; }
+
+	/**
+	 * @return whether the build side of a hash join didn't fit in memory and the join was split into partitions on the disk
+	*/
+	bool isPartitioned() const { return fStrategy == JoinStrategy::HASH && fPartitions > 1; }
+
+	JoinStrategy getStrategy() const { return fStrategy; }
+
+private:
+	Table& fLeft;
+	Table& fRight;
+	string fLeftColumn, fRightColumn;
+	size_t fLeftKeyPos, fRightKeyPos;
+	size_t fMemoryBudget;
+	size_t fPartitions;
+	JoinStrategy fStrategy;
+	// The build side of a hash join, the indexed (inner) side of an index nested loop join
+	bool fBuildIsLeft;
+	vector<string> fColumns;
+	unordered_map<string, size_t> fColIndex;
+	unordered_map<string, string> fScheme;
+
+	struct KeyHash
+	{
+		size_t operator()(const TypeWrapper& key) const { return key.hash(); }
+	};
+
+	typedef unordered_map<TypeWrapper, vector<Record>, KeyHash> BuildTable;
+
+	Table& getBuild() { return fBuildIsLeft ? fLeft : fRight; }
+
+	Table& getProbe() { return fBuildIsLeft ? fRight : fLeft; }
+
+	size_t getBuildKeyPos() const { return fBuildIsLeft ? fLeftKeyPos : fRightKeyPos; }
+
+	size_t getProbeKeyPos() const { return fBuildIsLeft ? fRightKeyPos : fLeftKeyPos; }
+
+	void initializeColumns()
+	{
+		vector<string> leftColumns = sh::splitBy(fLeft.getTableHeader(), ",");
+		vector<string> rightColumns = sh::splitBy(fRight.getTableHeader(), ",");
+		sh::removeEmptyStringsInVector(leftColumns);
+		sh::removeEmptyStringsInVector(rightColumns);
+
+		auto add = [&](Table& table, const vector<string>& columns, const vector<string>& otherColumns)
+		{
+			for (const string& column : columns)
+			{
+				string qualified = table.getTableName() + "." + column;
+				fColIndex[qualified] = fColumns.size();
+				fScheme[qualified] = table.getTableScheme().at(column);
+				if (std::find(otherColumns.begin(), otherColumns.end(), column) == otherColumns.end())
+				{
+					fColIndex[column] = fColumns.size();
+					fScheme[column] = table.getTableScheme().at(column);
+				}
+
+				fColumns.push_back(qualified);
+			}
+		};
+
+		add(fLeft, leftColumns, rightColumns);
+		add(fRight, rightColumns, leftColumns);
+	}
+
+	/**
+	 * @brief Pick the cheapest strategy. A scan costs a record read per record, an index probe costs about as much as
+	 * reading JOIN_INDEX_PROBE_COST records, so an index nested loop pays off when the outer table has that many times
+	 * fewer records than the indexed one. Between a hash join and a merge join the hash join is preferred as long as its
+	 * build side fits in memory, the merge join reads the records in key order and not in page order
+	*/
+	void chooseStrategy()
+	{
+		fStrategy = JoinStrategy::HASH;
+		size_t leftRecords = fLeft.getRecordsCount(), rightRecords = fRight.getRecordsCount();
+		bool outerIsLeft = leftRecords <= rightRecords;
+		size_t outerRecords = outerIsLeft ? leftRecords : rightRecords;
+		size_t innerRecords = outerIsLeft ? rightRecords : leftRecords;
+		Table& inner = outerIsLeft ? fRight : fLeft;
+		if (inner.hasIndexOn(outerIsLeft ? fRightColumn : fLeftColumn) && outerRecords * JOIN_INDEX_PROBE_COST <= innerRecords)
+		{
+			fStrategy = JoinStrategy::INDEX_NESTED_LOOP;
+			fBuildIsLeft = !outerIsLeft;
+			return;
+		}
+
+		// Build on the smaller input, grace partitions are sized so that every worker's partition fits in its share of the budget
+		fBuildIsLeft = fLeft.getBytesData() <= fRight.getBytesData();
+		size_t buildBytes = (size_t)getBuild().getBytesData();
+		if (buildBytes <= fMemoryBudget)
+			return;
+
+		if (fLeft.hasOrderedIndexOn(fLeftColumn) && fRight.hasOrderedIndexOn(fRightColumn))
+		{
+			fStrategy = JoinStrategy::SORT_MERGE;
+			return;
+		}
+
+		size_t workerBudget = fMemoryBudget / ph::getWorkersCount(std::numeric_limits<size_t>::max());
+		if (workerBudget == 0)
+			workerBudget = 1;
+
+		fPartitions = std::min<size_t>(JOIN_MAX_PARTITIONS, 2 * buildBytes / workerBudget + 1);
+	}
+
+	/**
+	 * @brief Hand a matching pair out in left-right order
+	 * @param build - record of the build (or inner) side
+	 * @param probe - record of the probe (or outer) side
+	*/
+	void emitPair(const Record& build, const Record& probe, size_t worker, const std::function<void(const Record&, const Record&, size_t)>& emit) const
+	{
+		if (fBuildIsLeft)
+			emit(build, probe, worker);
+		else
+			emit(probe, build, worker);
+	}
+
+	/**
+	 * @brief Index nested loop join. The outer table is streamed out of its pages, every worker gathers its records in batches
+	 * and looks the batch up in the index of the inner table, see probeIndex
+	*/
+	void joinIndexNestedLoop(const std::function<void(const Record&, const Record&, size_t)>& emit)
+	{
+		Table& outer = getProbe();
+		Query all("", outer.getTableScheme(), outer.getPrimaryKey());
+		vector<vector<Record>> batches;
+		outer.scanMatching(all, [&](size_t workers) { batches.resize(workers); }, [&](const Record& r, size_t worker)
+			{
+				if (r.get(getProbeKeyPos()).getContent() == nullptr)
+					return;
+
+				batches[worker].push_back(r);
+				if (batches[worker].size() == JOIN_PROBE_BATCH)
+				{
+					probeIndex(batches[worker], worker, emit);
+					batches[worker].clear();
+				}
+			});
+
+		for (size_t worker = 0; worker < batches.size(); worker++)
+			probeIndex(batches[worker], worker, emit);
+	}
+
+	/**
+	 * @brief Look a batch of outer records up in the index of the inner table. The pointers of all matches are sorted first,
+	 * so every page of the inner table is loaded once per batch, no matter how many outer records match records in it
+	 * @param batch - records of the outer table
+	 * @param worker - number of the worker handing out the matches
+	*/
+	void probeIndex(const vector<Record>& batch, size_t worker, const std::function<void(const Record&, const Record&, size_t)>& emit)
+	{
+		Table& inner = getBuild();
+		const string& innerColumn = fBuildIsLeft ? fLeftColumn : fRightColumn;
+		vector<pair<RecordPtr, size_t>> matches;
+		vector<RecordPtr> ptrs;
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			inner.getKeyRecordPtrs(innerColumn, batch[i].get(getProbeKeyPos()), ptrs);
+			for (const RecordPtr& ptr : ptrs)
+				matches.push_back({ ptr, i });
+		}
+
+		std::sort(matches.begin(), matches.end(), [](const pair<RecordPtr, size_t>& a, const pair<RecordPtr, size_t>& b) { return a.first < b.first; });
+
+		for (size_t i = 0; i < matches.size();)
+		{
+			int index = matches[i].first.getPage();
+			Page page = inner.loadPage(index);
+			for (; i < matches.size() && matches[i].first.getPage() == index; i++)
+			{
+				const Record& r = page.at(matches[i].first.getIndexInPage());
+				if (!r.isInvalid())
+					emitPair(r, batch[matches[i].second], worker, emit);
+			}
+		}
+	}
+
+	/**
+	 * @brief Records of a table in the key order of an index. The pointers are read from the index JOIN_MERGE_BATCH at a time,
+	 * each batch resuming after the last key of the previous one, and only the records of the current batch are fetched
+	*/
+	class OrderedReader
+	{
+	public:
+		OrderedReader(Table& table, const string& column) : fTable(table), fColumn(column), fPos(0), fHasStarted(false), fIsDone(false)
+		{
+			fetch();
+		}
+
+		bool isValid() const { return fPos < fBatch.size(); }
+
+		const Record& get() const { return fBatch[fPos]; }
+
+		void next()
+		{
+			if (++fPos == fBatch.size())
+				fetch();
+		}
+
+	private:
+		Table& fTable;
+		string fColumn;
+		TypeWrapper fLastKey;
+		vector<Record> fBatch;
+		size_t fPos;
+		bool fHasStarted, fIsDone;
+
+		void fetch()
+		{
+			fBatch.clear();
+			fPos = 0;
+			vector<RecordPtr> ptrs;
+			while (fBatch.empty() && !fIsDone)
+			{
+				TypeWrapper last;
+				fTable.getRecordPtrsAfterKey(fColumn, fHasStarted ? &fLastKey : nullptr, JOIN_MERGE_BATCH, ptrs, last);
+				fIsDone = ptrs.empty();
+				if (!fIsDone)
+				{
+					fBatch = fTable.fetchRecordsInOrder(ptrs);
+					fLastKey = last;
+					fHasStarted = true;
+				}
+			}
+		}
+	};
+
+	static bool isKey(const TypeWrapper& value, const TypeWrapper& key)
+	{
+		return value.getContent() != nullptr && value == key;
+	}
+
+	/**
+	 * @brief Sort-merge join. Both tables are read in the order of the join column, the runs of equal keys are matched
+	 * while the smaller keys of either side are skipped. Only the inner run of the current key is kept in memory
+	*/
+	void joinSortMerge(const std::function<void(const Record&, const Record&, size_t)>& emit)
+	{
+		OrderedReader left(fLeft, fLeftColumn);
+		OrderedReader right(fRight, fRightColumn);
+		vector<Record> run;
+		while (left.isValid() && right.isValid())
+		{
+			const TypeWrapper& leftKey = left.get().get(fLeftKeyPos);
+			const TypeWrapper& rightKey = right.get().get(fRightKeyPos);
+			if (leftKey.getContent() == nullptr)
+				left.next();
+			else if (rightKey.getContent() == nullptr)
+				right.next();
+			else if (leftKey < rightKey)
+				left.next();
+			else if (rightKey < leftKey)
+				right.next();
+			else
+			{
+				TypeWrapper key = rightKey;
+				run.clear();
+				for (; right.isValid() && isKey(right.get().get(fRightKeyPos), key); right.next())
+					run.push_back(right.get());
+
+				for (; left.isValid() && isKey(left.get().get(fLeftKeyPos), key); left.next())
+					for (const Record& match : run)
+						emit(left.get(), match, 0);
+			}
+		}
+	}
+
+	/**
+	 * @brief Partition of a join key. The hash is mixed first - the hash table of a partition buckets the same keys again,
+	 * and without mixing all keys of a partition would share the low bits of their hashes
+	*/
+	size_t getPartition(const TypeWrapper& key) const
+	{
+		unsigned long long mixed = (unsigned long long)key.hash() * 0x9E3779B97F4A7C15ull;
+		return (size_t)((mixed >> 32) % fPartitions);
+	}
+
+	void joinInMemory(const std::function<void(const Record&, const Record&, size_t)>& emit)
+	{
+		// Build: every worker gathers the records of its pages, they are moved into one hash table afterwards
+		Table& build = getBuild();
+		Query all("", build.getTableScheme(), build.getPrimaryKey());
+		vector<vector<Record>> gathered;
+		build.scanMatching(all, [&](size_t workers) { gathered.resize(workers); }, [&](const Record& r, size_t worker)
+			{
+				if (r.get(getBuildKeyPos()).getContent() != nullptr)
+					gathered[worker].push_back(r);
+			});
+
+		BuildTable table;
+		for (vector<Record>& records : gathered)
+			for (Record& r : records)
+			{
+				TypeWrapper key = r.get(getBuildKeyPos());
+				table[key].push_back(std::move(r));
+			}
+
+		gathered.clear();
+		probe(table, emit);
+	}
+
+	/**
+	 * @brief Stream the probe side out of its pages and look every record up in the hash table of the build side
+	*/
+	void probe(const BuildTable& table, const std::function<void(const Record&, const Record&, size_t)>& emit)
+	{
+		Table& probe = getProbe();
+		Query all("", probe.getTableScheme(), probe.getPrimaryKey());
+		probe.scanMatching(all, [](size_t) {}, [&](const Record& r, size_t worker)
+			{
+				const TypeWrapper& key = r.get(getProbeKeyPos());
+				if (key.getContent() == nullptr)
+					return;
+
+				auto it = table.find(key);
+				if (it == table.end())
+					return;
+
+				for (const Record& match : it->second)
+					emitPair(match, r, worker, emit);
+			});
+	}
+
+	/**
+	 * @brief Grace hash join. Both sides are written to partition files, every worker writing its own files,
+	 * then the pairs of partitions are joined in memory by a pool of workers. The files are deleted at the end
+	*/
+	void joinPartitions(const std::function<void(const Record&, const Record&, size_t)>& emit)
+	{
+		static std::atomic<size_t> joinsCount(0);
+		fs::path directory = fs::temp_directory_path() / ("join_" + fLeft.getTableName() + "_" + fRight.getTableName() + "_" + to_string(joinsCount++));
+		fs::create_directories(directory);
+
+		try
+		{
+			size_t writers = partitionTable(getBuild(), getBuildKeyPos(), directory / "build");
+			size_t probeWriters = partitionTable(getProbe(), getProbeKeyPos(), directory / "probe");
+
+			ph::parallelForWithWorker(fPartitions, [&](size_t partition, size_t worker)
+				{
+					BuildTable table;
+					readPartition(directory / "build", partition, writers, [&](Record& r)
+						{
+							TypeWrapper key = r.get(getBuildKeyPos());
+							table[key].push_back(std::move(r));
+						});
+
+					if (table.empty())
+						return;
+
+					readPartition(directory / "probe", partition, probeWriters, [&](Record& r)
+						{
+							auto it = table.find(r.get(getProbeKeyPos()));
+							if (it == table.end())
+								return;
+
+							for (const Record& match : it->second)
+								emitPair(match, r, worker, emit);
+						});
+				});
+		}
+		catch (...)
+		{
+			fs::remove_all(directory);
+			throw;
+		}
+
+		fs::remove_all(directory);
+	}
+
+	/**
+	 * @brief Split the records of a table into partition files by the hash of the join column
+	 * @param table - the table
+	 * @param keyPos - position of the join column
+	 * @param prefix - path prefix of the files, a file is named {prefix}_{partition}_{worker}
+	 * @return the number of workers that wrote files
+	*/
+	size_t partitionTable(Table& table, size_t keyPos, const fs::path& prefix)
+	{
+		vector<vector<unique_ptr<ofstream>>> files;
+		Query all("", table.getTableScheme(), table.getPrimaryKey());
+		table.scanMatching(all, [&](size_t workers) { files.resize(workers); }, [&](const Record& r, size_t worker)
+			{
+				const TypeWrapper& key = r.get(keyPos);
+				if (key.getContent() == nullptr)
+					return;
+
+				vector<unique_ptr<ofstream>>& workerFiles = files[worker];
+				if (workerFiles.empty())
+					workerFiles.resize(fPartitions);
+
+				size_t partition = getPartition(key);
+				if (!workerFiles[partition])
+					workerFiles[partition].reset(new ofstream(getPartitionPath(prefix, partition, worker), std::ios::binary));
+
+				r.write(*workerFiles[partition]);
+			});
+
+		return files.size();
+	}
+
+	/**
+	 * @brief Read back all records of a partition, from the files of every worker that wrote it
+	*/
+	void readPartition(const fs::path& prefix, size_t partition, size_t writers, const std::function<void(Record&)>& visit) const
+	{
+		for (size_t worker = 0; worker < writers; worker++)
+		{
+			ifstream in(getPartitionPath(prefix, partition, worker), std::ios::binary);
+			if (!in)
+				continue;
+
+			while (in.peek() != EOF)
+			{
+				Record r(in);
+				visit(r);
+			}
+		}
+	}
+
+	static string getPartitionPath(const fs::path& prefix, size_t partition, size_t worker)
+	{
+		return prefix.string() + "_" + to_string(partition) + "_" + to_string(worker);
+	}
+};
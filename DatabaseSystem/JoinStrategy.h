@@ -0,0 +1,7 @@
+#pragma once
+enum class JoinStrategy
+{
+	HASH,
+	INDEX_NESTED_LOOP,
+	SORT_MERGE
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include "TypeWrapper.hpp"
+
+/**
+ * @brief Descriptor of a range of index keys between two optional bounds
+*/
+class KeyRange
+{
+public:
+	TypeWrapper fLower;
+	TypeWrapper fUpper;
+	bool fHasLower;
+	bool fHasUpper;
+	bool fLowerInclusive;
+	bool fUpperInclusive;
+
+	KeyRange() : fHasLower(false), fHasUpper(false), fLowerInclusive(false), fUpperInclusive(false) {}
+
+	void setLower(const TypeWrapper& value, bool inclusive)
+	{
+		fLower = value;
+		fHasLower = true;
+		fLowerInclusive = inclusive;
+	}
+
+	void setUpper(const TypeWrapper& value, bool inclusive)
+	{
+		fUpper = value;
+		fHasUpper = true;
+		fUpperInclusive = inclusive;
+	}
+
+	/**
+	 * @return the lower bound, nullptr if the range is unbounded from below
+	*/
+	const TypeWrapper* getLower() const { return fHasLower ? &fLower : nullptr; }
+
+	/**
+	 * @return the upper bound, nullptr if the range is unbounded from above
+	*/
+	const TypeWrapper* getUpper() const { return fHasUpper ? &fUpper : nullptr; }
+
+	bool isBounded() const { return fHasLower || fHasUpper; }
+};
@@ -0,0 +1,6 @@
+#pragma once
+enum class LogRecordType : char {
+	INSERT,
+	REMOVE,
+	UPDATE
+};
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+#include<vector>
+#include<cstddef>
+#include<algorithm>
+
+using std::vector;
+
+#define NODE_POOL_SLAB_BLOCKS 64
+
+/**
+ * @brief Allocator of equally sized memory blocks. The blocks are cut out of slabs of NODE_POOL_SLAB_BLOCKS blocks,
+ * a freed block is kept in a free list and handed out again before a new slab is taken. Destroying the pool frees
+ * all of its slabs at once, so the objects placed in its blocks have to be destroyed before that, but don't have to
+ * give their blocks back one by one. Not thread-safe
+*/
+class NodePool
+{
+public:
+	/**
+	 * @param blockSize - size of a block in bytes, it is rounded up so every block is aligned for any type
+	*/
+	NodePool(size_t blockSize) : fBlockSize(roundUp(std::max(blockSize, sizeof(void*)), alignof(std::max_align_t))),
+		fFreeHead(nullptr), fSlabUsed(NODE_POOL_SLAB_BLOCKS) {}
+
+	NodePool(const NodePool& other) = delete;
+	NodePool& operator=(const NodePool& other) = delete;
+
+	~NodePool()
+	{
+		for (char* slab : fSlabs)
+			delete[] slab;
+	}
+
+	/**
+	 * @return an uninitialized block of getBlockSize() bytes
+	*/
+	void* allocate()
+	{
+		if (fFreeHead)
+		{
+			void* block = fFreeHead;
+			fFreeHead = *(void**)block;
+			return block;
+		}
+
+		if (fSlabUsed == NODE_POOL_SLAB_BLOCKS)
+		{
+			fSlabs.push_back(new char[fBlockSize * NODE_POOL_SLAB_BLOCKS]);
+			fSlabUsed = 0;
+		}
+
+		return fSlabs.back() + fBlockSize * fSlabUsed++;
+	}
+
+	/**
+	 * @brief Give back a block of this pool, the object in it has to be destroyed already
+	*/
+	void deallocate(void* block)
+	{
+		*(void**)block = fFreeHead;
+		fFreeHead = block;
+	}
+
+	size_t getBlockSize() const { return fBlockSize; }
+
+	static size_t roundUp(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+private:
+	size_t fBlockSize;
+	vector<char*> fSlabs;
+	void* fFreeHead; // the first bytes of a free block hold the next free block
+	size_t fSlabUsed; // blocks of the last slab handed out so far
+};
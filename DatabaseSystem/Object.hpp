@@ -1,18 +1,24 @@
 #pragma once
 #include <string>
 #include<fstream>
+#include<functional>
 using std::ofstream;
 using std::ifstream;
+using std::ostream;
+using std::istream;
 using std::to_string;
 
 class Object
 {
 public:
+	virtual ~Object() = default;
+
 	virtual Object* clone() const = 0;
 	virtual size_t memsize() const = 0;
 	virtual std::string toString() const = 0;
-	virtual void write(ofstream& out) const = 0;
+	virtual void write(ostream& out) const = 0;
 	virtual size_t size() const = 0;
+	virtual size_t hash() const = 0;
 
 	bool operator>(const Object& other) const
 	{
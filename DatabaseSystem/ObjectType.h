@@ -5,4 +5,5 @@ enum class ObjectType
 	DOUBLE,
 	STRING,
 	DATE,
+	COMPOSITE,
 };
\ No newline at end of file
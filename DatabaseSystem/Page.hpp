@@ -17,7 +17,7 @@ private:
 
 public:
 
-	Page(ifstream& in)
+	Page(istream& in)
 	{
 		/// @brief Read page's max capacity to object
 		in.read((char*)&maxSize, sizeof(maxSize));
@@ -38,7 +38,8 @@ public:
 
 	/**
 	 * Create a new page specifying the maximum number of records it can hold
-	 * and the path at which the page will be stored relative to the executable files
+	 * and the path at which the page will be stored relative to the executable files.
+	 * The page is only held in memory until its owning table persists it
 	 *
 	 * @param maxSize the maximum number of records that fit in one page
 	 * @param path the path at which the page is stored relative to the executable files
@@ -47,7 +48,6 @@ public:
 	{
 		this->path = path;
 		this->maxSize = maxSize;
-		this->save();
 	}
 
 	/**
@@ -70,30 +70,50 @@ public:
 			return false;
 
 		records.push_back(record);
-		save();
 
 		return true;
 	}
 
 	/**
-	 * Delete a record from the page at specified index
+	 * Delete a record from the page at specified index.
+	 * The change is kept in memory until the page is saved
 	 * @param index the index of the record in the page to be deleted
 	 */
 	void removeRecord(size_t index)
 	{
 		records[index].invalidateRecord();
-		save();
 	}
 
 	/**
-	 * @brief Save the page on the disk
+	 * Replace a record of the page at specified index, the record keeps its position.
+	 * The change is kept in memory until the page is saved
+	 * @param index the index of the record in the page to be replaced
+	 * @param record the new record
+	 */
+	void replaceRecord(size_t index, const Record& record)
+	{
+		records[index] = record;
+	}
+
+	/**
+	 * @brief Save the page on the disk in its own file
 	*/
-	void save()
+	void save() const
 	{
 		ofstream out(path, std::ios::binary);
 		if (!out.is_open())
 			throw std::logic_error("Couldn't open file to save page " + path);
 
+		write(out);
+		out.close();
+	}
+
+	/**
+	 * @brief Write the page to an output stream
+	 * @param out - output stream, used for writing
+	*/
+	void write(ostream& out) const
+	{
 		/// @brief Save page's max capacity to file
 		out.write((char*)&maxSize, sizeof(maxSize));
 
@@ -107,8 +127,6 @@ public:
 		/// @brief Save the records themseleves to file
 		for (size_t i = 0; i < records.size(); i++)
 			records[i].write(out);
-
-		out.close();
 	}
 
 	/**
@@ -132,4 +150,17 @@ public:
 
 		throw std::out_of_range(index + " is out of range");
 	}
+
+	/**
+	 * Access a record with its position in the page without copying it
+	 * @param index the position of the record in the page
+	 * @return reference to the required record
+	 */
+	const Record& at(size_t index) const
+	{
+		if (index < records.size())
+			return records[index];
+
+		throw std::out_of_range(std::to_string(index) + " is out of range");
+	}
 };
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+class ParallelHelper
+{
+private:
+	ParallelHelper();
+public:
+	/**
+	 * @brief Get how many workers should be used for the given number of independent tasks
+	 * @param tasks - number of tasks
+	 * @return number of workers, never more than the tasks or the hardware threads
+	*/
+	static size_t getWorkersCount(size_t tasks)
+	{
+		size_t hardware = std::thread::hardware_concurrency();
+		if (hardware == 0)
+			hardware = 1;
+
+		return tasks < hardware ? tasks : hardware;
+	}
+
+	/**
+	 * @brief Run task(0), task(1) ... task(count - 1) on a pool of workers. Every worker takes the next
+	 * not yet taken index, so slow tasks don't hold back the others. With a single task or a single hardware
+	 * thread everything runs on the calling thread. The first exception thrown by a task is rethrown here
+	 * once all workers are done.
+	 * @param count - number of tasks
+	 * @param task - function called with the index of the task
+	*/
+	static void parallelFor(size_t count, const std::function<void(size_t)>& task)
+	{
+		parallelForWithWorker(count, [&](size_t i, size_t) { task(i); });
+	}
+
+	/**
+	 * @brief Same as parallelFor, but every task also gets the number of the worker running it, in [0, getWorkersCount(count)).
+	 * A worker runs its tasks one after another, so tasks can keep per-worker state (i.e. partial results) without locking
+	 * @param count - number of tasks
+	 * @param task - function called with the index of the task and the number of the worker
+	*/
+	static void parallelForWithWorker(size_t count, const std::function<void(size_t, size_t)>& task)
+	{
+		size_t workersCount = getWorkersCount(count);
+		if (workersCount <= 1)
+		{
+			for (size_t i = 0; i < count; i++)
+				task(i, 0);
+
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		std::exception_ptr error = nullptr;
+		std::atomic<bool> failed(false);
+
+		auto work = [&](size_t worker)
+		{
+			size_t i;
+			while (!failed && (i = next++) < count)
+			{
+				try
+				{
+					task(i, worker);
+				}
+				catch (...)
+				{
+					if (!failed.exchange(true))
+						error = std::current_exception();
+				}
+			}
+		};
+
+		vector<std::thread> workers;
+		workers.reserve(workersCount - 1);
+		for (size_t i = 1; i < workersCount; i++)
+			workers.push_back(std::thread(work, i));
+
+		work(0);
+		for (std::thread& worker : workers)
+			worker.join();
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+};
@@ -0,0 +1,245 @@
+#pragma once
+#include<vector>
+#include<string>
+#include<algorithm>
+#include<functional>
+#include "RecordPtr.hpp"
+
+using std::vector;
+using std::string;
+
+#define POSTING_BLOCK_ENTRIES 128
+
+/**
+ * @brief Pointers of all records having one key of a non-unique index, sorted by page and index in page.
+ * The pointers are delta-compressed in blocks of at most POSTING_BLOCK_ENTRIES: a block keeps its first pointer as it is,
+ * every next one is stored as the difference of the page numbers followed by the difference of the indexes in page
+ * (same page) or the index itself (a later page), each number in as few bytes as it needs. Records of a key that lie
+ * close to each other in the table take 2 bytes per pointer instead of 8, so columns with few distinct values
+ * can be indexed cheaply. Appending a pointer greater than all others (the usual case, records are appended
+ * to the table) doesn't decode anything, other changes decode and encode only the block they fall into
+*/
+class PostingList
+{
+public:
+	PostingList() : fSize(0) {}
+
+	/**
+	 * @return the number of pointers in the list
+	*/
+	size_t size() const { return fSize; }
+
+	bool empty() const { return fSize == 0; }
+
+	/**
+	 * @brief Add a pointer, keeping the list sorted
+	 * @param ptr - pointer to a record
+	 * @return the position of the pointer in the list
+	*/
+	size_t insert(const RecordPtr& ptr)
+	{
+		fSize++;
+		if (fBlocks.empty())
+		{
+			fBlocks.push_back(Block(ptr));
+			return 0;
+		}
+
+		size_t blockIndex = findBlock(ptr);
+		Block& block = fBlocks[blockIndex];
+		bool isLastBlock = blockIndex + 1 == fBlocks.size();
+		if (!(ptr < block.fLast) && block.fCount < POSTING_BLOCK_ENTRIES)
+		{
+			appendDelta(block.fBytes, block.fLast, ptr);
+			block.fLast = ptr;
+			block.fCount++;
+			return isLastBlock ? fSize - 1 : countBefore(blockIndex) + block.fCount - 1;
+		}
+
+		if (!(ptr < block.fLast) && isLastBlock)
+		{
+			fBlocks.push_back(Block(ptr));
+			return fSize - 1;
+		}
+
+		size_t position = countBefore(blockIndex);
+		vector<RecordPtr> ptrs = decode(block);
+		size_t pos = std::lower_bound(ptrs.begin(), ptrs.end(), ptr) - ptrs.begin();
+		ptrs.insert(ptrs.begin() + pos, ptr);
+		if (ptrs.size() <= POSTING_BLOCK_ENTRIES)
+		{
+			block = encode(ptrs.begin(), ptrs.end());
+		}
+		else
+		{
+			// split in halves, so appending to a full block doesn't split again right away
+			auto middle = ptrs.begin() + ptrs.size() / 2;
+			block = encode(ptrs.begin(), middle);
+			fBlocks.insert(fBlocks.begin() + blockIndex + 1, encode(middle, ptrs.end()));
+		}
+
+		return position + pos;
+	}
+
+	/**
+	 * @brief Remove a pointer from the list
+	 * @param ptr - pointer to a record
+	 * @param position - set to the position the pointer had in the list
+	 * @return True if the pointer was in the list
+	*/
+	bool remove(const RecordPtr& ptr, size_t& position)
+	{
+		if (fBlocks.empty())
+			return false;
+
+		size_t blockIndex = findBlock(ptr);
+		vector<RecordPtr> ptrs = decode(fBlocks[blockIndex]);
+		auto it = std::lower_bound(ptrs.begin(), ptrs.end(), ptr);
+		if (it == ptrs.end() || !(*it == ptr))
+			return false;
+
+		position = countBefore(blockIndex) + (it - ptrs.begin());
+		ptrs.erase(it);
+		if (ptrs.empty())
+			fBlocks.erase(fBlocks.begin() + blockIndex);
+		else
+			fBlocks[blockIndex] = encode(ptrs.begin(), ptrs.end());
+
+		fSize--;
+		return true;
+	}
+
+	/**
+	 * @brief Visit the pointers in ascending order
+	 * @param visit - function called with every pointer
+	*/
+	void forEach(const std::function<void(const RecordPtr&)>& visit) const
+	{
+		for (const Block& block : fBlocks)
+		{
+			RecordPtr ptr = block.fFirst;
+			visit(ptr);
+			size_t offset = 0;
+			while (offset < block.fBytes.size())
+			{
+				ptr = readDelta(block.fBytes, offset, ptr);
+				visit(ptr);
+			}
+		}
+	}
+
+	/**
+	 * @brief Append the pointers to a vector, in ascending order
+	*/
+	void appendTo(vector<RecordPtr>& ptrs) const
+	{
+		forEach([&](const RecordPtr& ptr) { ptrs.push_back(ptr); });
+	}
+
+private:
+	/**
+	 * @brief Pointers following each other in the list, fBytes holds the deltas of all but the first one
+	*/
+	struct Block
+	{
+		Block(const RecordPtr& first) : fFirst(first), fLast(first), fCount(1) {}
+
+		RecordPtr fFirst;
+		RecordPtr fLast;
+		size_t fCount;
+		string fBytes;
+	};
+
+	vector<Block> fBlocks;
+	size_t fSize;
+
+	/**
+	 * @return the index of the block a pointer belongs to - the last one starting at or before it, the first block for smaller ones
+	*/
+	size_t findBlock(const RecordPtr& ptr) const
+	{
+		auto it = std::upper_bound(fBlocks.begin(), fBlocks.end(), ptr,
+			[](const RecordPtr& value, const Block& block) { return value < block.fFirst; });
+
+		return it == fBlocks.begin() ? 0 : it - fBlocks.begin() - 1;
+	}
+
+	size_t countBefore(size_t blockIndex) const
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < blockIndex; i++)
+			count += fBlocks[i].fCount;
+
+		return count;
+	}
+
+	static vector<RecordPtr> decode(const Block& block)
+	{
+		vector<RecordPtr> ptrs;
+		ptrs.reserve(block.fCount + 1);
+		ptrs.push_back(block.fFirst);
+		size_t offset = 0;
+		while (offset < block.fBytes.size())
+			ptrs.push_back(readDelta(block.fBytes, offset, ptrs.back()));
+
+		return ptrs;
+	}
+
+	static Block encode(vector<RecordPtr>::const_iterator first, vector<RecordPtr>::const_iterator last)
+	{
+		Block block(*first);
+		for (++first; first != last; ++first)
+		{
+			appendDelta(block.fBytes, block.fLast, *first);
+			block.fLast = *first;
+			block.fCount++;
+		}
+
+		return block;
+	}
+
+	static void appendDelta(string& bytes, const RecordPtr& previous, const RecordPtr& ptr)
+	{
+		size_t pageDelta = ptr.getPage() - previous.getPage();
+		appendNumber(bytes, pageDelta);
+		appendNumber(bytes, pageDelta == 0 ? ptr.getIndexInPage() - previous.getIndexInPage() : ptr.getIndexInPage());
+	}
+
+	static RecordPtr readDelta(const string& bytes, size_t& offset, const RecordPtr& previous)
+	{
+		size_t pageDelta = readNumber(bytes, offset);
+		size_t index = readNumber(bytes, offset);
+		if (pageDelta == 0)
+			return RecordPtr(previous.getPage(), previous.getIndexInPage() + (int)index);
+
+		return RecordPtr(previous.getPage() + (int)pageDelta, (int)index);
+	}
+
+	/**
+	 * @brief Append a number 7 bits in a byte, the high bit is set on all bytes but the last (like FileHelper::writeLength)
+	*/
+	static void appendNumber(string& bytes, size_t number)
+	{
+		while (number >= 0x80)
+		{
+			bytes.push_back((char)((number & 0x7F) | 0x80));
+			number >>= 7;
+		}
+
+		bytes.push_back((char)number);
+	}
+
+	static size_t readNumber(const string& bytes, size_t& offset)
+	{
+		size_t number = 0;
+		for (size_t shift = 0; offset < bytes.size(); shift += 7)
+		{
+			unsigned char byte = bytes[offset++];
+			number |= (size_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+
+		return number;
+	}
+};
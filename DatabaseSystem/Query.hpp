@@ -247,6 +247,8 @@ private:
 		{
 			return TypeWrapper(stod(cpy));
 		}
+
+		throw invalid_argument("Invalid value " + val + " in the WHERE clause");
 	}
 
 	/**
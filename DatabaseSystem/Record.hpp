@@ -19,7 +19,7 @@ private:
 public:
 	Record() :fColumns(0), fIsInvalidated(false) {}
 
-	Record(std::ifstream& in)
+	Record(std::istream& in)
 	{
 		in.read((char*)&fIsInvalidated, sizeof(fIsInvalidated));
 		in.read((char*)&fColumns, sizeof(fColumns));
@@ -49,6 +49,19 @@ public:
 		fValues.push_back(value);
 	}
 
+	/**
+	 * Replace the value of a given column of the record
+	 * @param index - the index of the column to be changed
+	 * @param value - the new value
+	 */
+	void setValue(size_t index, const TypeWrapper& value)
+	{
+		if (index >= fValues.size())
+			throw std::out_of_range("Record setValue(index, value) - index is out of range");
+
+		fValues[index] = value;
+	}
+
 	/**
 	 * Get the value of a given column of this record
 	 * @param index - index of the required column
@@ -66,7 +79,7 @@ public:
 	 *  @brief Write a record to file
 	 *  @param out - output stream, used for writing
 	 */
-	void write(ofstream& out) const
+	void write(ostream& out) const
 	{
 		out.write((char*)&fIsInvalidated, sizeof(fIsInvalidated));
 		out.write((char*)&fColumns, sizeof(fColumns));
@@ -3,6 +3,8 @@
 
 using std::ifstream;
 using std::ofstream;
+using std::istream;
+using std::ostream;
 
 /**
  * @brief Descriptor of BPTree pointers to the records.
@@ -10,7 +12,7 @@ using std::ofstream;
 class RecordPtr
 {
 public:
-	RecordPtr(ifstream& in)
+	RecordPtr(istream& in)
 	{
 		in.read((char*)&pageNumber, sizeof(pageNumber));
 		in.read((char*)&indexInPage, sizeof(indexInPage));
@@ -39,13 +41,13 @@ public:
 	/**
 	 * @brief Write metadata to file
 	*/
-	void write(ofstream& out) const
+	void write(ostream& out) const
 	{
 		out.write((char*)&pageNumber, sizeof(pageNumber));
 		out.write((char*)&indexInPage, sizeof(indexInPage));
 	}
 
-	bool operator<(const RecordPtr& other)
+	bool operator<(const RecordPtr& other) const
 	{
 		if (pageNumber < other.pageNumber)
 			return true;
@@ -56,7 +58,7 @@ public:
 		return false;
 	}
 
-	bool operator>(const RecordPtr& other)
+	bool operator>(const RecordPtr& other) const
 	{
 		if (pageNumber > other.pageNumber)
 			return true;
@@ -67,7 +69,7 @@ public:
 		return false;
 	}
 
-	bool operator==(const RecordPtr& other)
+	bool operator==(const RecordPtr& other) const
 	{
 		if (pageNumber == other.pageNumber && indexInPage == other.indexInPage)
 			return true;
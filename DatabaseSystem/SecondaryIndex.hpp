@@ -0,0 +1,466 @@
+#pragma once
+#include<algorithm>
+#include<cstdint>
+#include "BPTree.hpp"
+#include "PostingList.hpp"
+
+#define INCLUDE_SEPARATOR " INCLUDE "
+
+/**
+ * @brief Number of the posting list of a key of a secondary index. The index's B+ tree keeps a RecordPtr with every key,
+ * a slot is turned into that value and back only here, so the value isn't mistaken for the position of a record
+*/
+class PostingSlot
+{
+public:
+	explicit PostingSlot(int index) : fIndex(index) {}
+
+	/**
+	 * @param treeValue - the value the index's B+ tree keeps with a key, see getTreeValue
+	 * @return the slot the value stands for
+	*/
+	static PostingSlot fromTreeValue(const RecordPtr& treeValue) { return PostingSlot(treeValue.getPage()); }
+
+	/**
+	 * @return the value kept with the key in the index's B+ tree
+	*/
+	RecordPtr getTreeValue() const { return RecordPtr(fIndex, 0); }
+
+	int getIndex() const { return fIndex; }
+
+private:
+	int fIndex;
+};
+
+/**
+ * @brief Descriptor of a non-unique index on an arbitrary column of a table, or on several columns (composite index).
+ * The distinct values of the column are the keys of a B+ tree. A composite index keys the tree by the values
+ * of all of its columns, compared lexicographically in the order the columns were given. The tree maps a key to the slot
+ * (see PostingSlot) of the key's posting list - the pointers of all records having that value.
+ * Posting lists are kept sorted by page and index in page, which is also the order records are appended in,
+ * and are delta-compressed (see PostingList), so a key shared by many records costs little more than its pointers' deltas.
+ *
+ * The index may also carry INCLUDE columns: they aren't part of the key, but their values are stored next to every
+ * record pointer, so queries reading only key and included columns can be answered without loading any page.
+*/
+class SecondaryIndex
+{
+public:
+	SecondaryIndex() : fEntries(0) {}
+
+	/**
+	 * @param columns - indexed columns, more than one makes a composite index
+	 * @param includeColumns - columns whose values are stored in the index without being part of the key
+	*/
+	SecondaryIndex(const vector<string>& columns, const vector<string>& includeColumns = vector<string>())
+		: fColumns(columns), fIncludeColumns(includeColumns), fEntries(0)
+	{
+		for (size_t i = 0; i < fColumns.size(); i++)
+			fColumn += (i == 0 ? "" : ",") + fColumns[i];
+	}
+
+	/**
+	 * @brief Reading constructor
+	 * @param in - input stream
+	*/
+	SecondaryIndex(istream& in) : fEntries(0)
+	{
+		// The included columns are saved after the key columns: "{columns} INCLUDE {included columns}"
+		string description;
+		fh::readString(in, description);
+		size_t include = description.find(INCLUDE_SEPARATOR);
+		fColumn = description.substr(0, include);
+		fColumns = sh::splitBy(fColumn, ",");
+		if (include != string::npos)
+			fIncludeColumns = sh::splitBy(description.substr(include + string(INCLUDE_SEPARATOR).size()), ",");
+
+		fTree = BPTree(in);
+
+		size_t slots = 0;
+		in.read((char*)&slots, sizeof(slots));
+		fPostings.resize(slots);
+		fIncluded.resize(hasIncludes() ? slots : 0);
+		for (size_t slot = 0; slot < slots; slot++)
+		{
+			size_t count = 0;
+			in.read((char*)&count, sizeof(count));
+			for (size_t i = 0; i < count; i++)
+			{
+				fPostings[slot].insert(RecordPtr(in));
+				if (hasIncludes())
+					fIncluded[slot].push_back(Record(in));
+			}
+
+			if (count == 0)
+				fFreeSlots.push_back(slot);
+
+			fEntries += count;
+		}
+	}
+
+	/**
+	 * @brief Write the index to file
+	 * @param out - output stream
+	*/
+	void write(ostream& out)
+	{
+		fh::writeString(out, getDescription());
+		fTree.write(out);
+
+		size_t slots = fPostings.size();
+		out.write((char*)&slots, sizeof(slots));
+		for (size_t slot = 0; slot < slots; slot++)
+		{
+			size_t count = fPostings[slot].size(), i = 0;
+			out.write((char*)&count, sizeof(count));
+			fPostings[slot].forEach([&](const RecordPtr& ptr)
+				{
+					ptr.write(out);
+					if (hasIncludes())
+						fIncluded[slot][i++].write(out);
+				});
+		}
+	}
+
+	/**
+	 * @brief Add a record with the given value of the indexed column
+	 * @param key - value of the indexed column
+	 * @param ptr - pointer to the record
+	 * @param included - values of the included columns of the record, see makeIncluded
+	*/
+	void insert(const TypeWrapper& key, const RecordPtr& ptr, const Record& included = Record())
+	{
+		int slot = getPostingSlot(key);
+		size_t pos = fPostings[slot].insert(ptr);
+		if (hasIncludes())
+			fIncluded[slot].insert(fIncluded[slot].begin() + pos, included);
+
+		fEntries++;
+	}
+
+	/**
+	 * @brief Remove a record with the given value of the indexed column, the key is dropped with its last record
+	 * @param key - value of the indexed column
+	 * @param ptr - pointer to the record
+	*/
+	void remove(const TypeWrapper& key, const RecordPtr& ptr)
+	{
+		RecordPtr treeValue;
+		if (!fTree.find(key, treeValue))
+			return;
+
+		int slot = PostingSlot::fromTreeValue(treeValue).getIndex();
+		size_t pos = 0;
+		if (!fPostings[slot].remove(ptr, pos))
+			return;
+
+		if (hasIncludes())
+			fIncluded[slot].erase(fIncluded[slot].begin() + pos);
+
+		fEntries--;
+
+		if (fPostings[slot].empty())
+		{
+			fTree.remove(key);
+			fFreeSlots.push_back(slot);
+		}
+	}
+
+	/**
+	 * @brief Get the pointers of all records whose indexed column satisfies {column} {op} {value}
+	 * @param op - comparison operator
+	 * @param value - value the column is compared against
+	 * @return pointers to the records, grouped by key in ascending key order
+	*/
+	vector<RecordPtr> getRecordPtrs(Operator op, const TypeWrapper& value)
+	{
+		vector<RecordPtr> answer;
+		for (const RecordPtr& treeValue : fTree.getRecordPtrs(op, value))
+			fPostings[PostingSlot::fromTreeValue(treeValue).getIndex()].appendTo(answer);
+
+		return answer;
+	}
+
+	/**
+	 * @brief Get the pointers of all records whose key lies between two bounds, in ascending key order.
+	 * Bounds of a composite index may hold values for a leading prefix of its columns only
+	 * @param lower - lower bound, nullptr for none
+	 * @param lowerInclusive - whether keys equal to the lower bound are included
+	 * @param upper - upper bound, nullptr for none
+	 * @param upperInclusive - whether keys equal to the upper bound are included
+	 * @return pointers to the records, grouped by key in ascending key order
+	*/
+	vector<RecordPtr> getRecordPtrsInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive)
+	{
+		vector<RecordPtr> answer;
+		for (const RecordPtr& treeValue : fTree.getRecordPtrsInRange(lower, lowerInclusive, upper, upperInclusive))
+			fPostings[PostingSlot::fromTreeValue(treeValue).getIndex()].appendTo(answer);
+
+		return answer;
+	}
+
+	/**
+	 * @brief Get the pointers of all records whose key lies between two bounds, in descending key order.
+	 * The records of a key come in the order of its posting list
+	 * @param limit - the keys are read until there are at least this many pointers
+	 * @return pointers to the records, grouped by key in descending key order
+	*/
+	vector<RecordPtr> getRecordPtrsInRangeReverse(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		size_t limit = SIZE_MAX)
+	{
+		vector<RecordPtr> answer;
+		fTree.forEachInRangeReverse(lower, lowerInclusive, upper, upperInclusive, [&](const data& entry)
+			{
+				fPostings[PostingSlot::fromTreeValue(entry.second).getIndex()].appendTo(answer);
+				return answer.size() < limit;
+			});
+
+		return answer;
+	}
+
+	/**
+	 * @brief Visit every indexed record whose key lies between two bounds, in ascending key order, see getRecordPtrsInRange
+	 * @param visit - function called with the key, the pointer to the record and the values of its included columns
+	*/
+	void forEachInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<void(const TypeWrapper&, const RecordPtr&, const Record&)>& visit)
+	{
+		Record noIncludes;
+		fTree.forEachInRange(lower, lowerInclusive, upper, upperInclusive, [&](const data& entry)
+			{
+				int slot = PostingSlot::fromTreeValue(entry.second).getIndex();
+				size_t i = 0;
+				fPostings[slot].forEach([&](const RecordPtr& ptr)
+					{
+						visit(entry.first, ptr, hasIncludes() ? fIncluded[slot][i++] : noIncludes);
+					});
+			});
+	}
+
+	/**
+	 * @brief Visit every indexed record whose key lies between two bounds, in descending key order, see getRecordPtrsInRangeReverse
+	 * @param visit - function called with the key, the pointer to the record and the values of its included columns,
+	 * returns false to stop the scan
+	*/
+	void forEachInRangeReverse(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive,
+		const std::function<bool(const TypeWrapper&, const RecordPtr&, const Record&)>& visit)
+	{
+		Record noIncludes;
+		bool isDone = false;
+		fTree.forEachInRangeReverse(lower, lowerInclusive, upper, upperInclusive, [&](const data& entry)
+			{
+				int slot = PostingSlot::fromTreeValue(entry.second).getIndex();
+				size_t i = 0;
+				fPostings[slot].forEach([&](const RecordPtr& ptr)
+					{
+						if (!isDone)
+							isDone = !visit(entry.first, ptr, hasIncludes() ? fIncluded[slot][i] : noIncludes);
+
+						i++;
+					});
+
+				return !isDone;
+			});
+	}
+
+	/**
+	 * @brief Get the pointers of the records of the next keys in ascending key order, see Table::getRecordPtrsAfterKey.
+	 * Every key is found from the root in O(log n), so only the posting lists of the batch are read
+	 * @param after - the last key of the previous batch, nullptr for the first batch
+	 * @param limit - keys are read until there are at least this many pointers
+	 * @param ptrs - the pointers are appended to it
+	 * @param last - set to the last key read
+	*/
+	void getRecordPtrsAfterKey(const TypeWrapper* after, size_t limit, vector<RecordPtr>& ptrs, TypeWrapper& last) const
+	{
+		data entry;
+		while (ptrs.size() < limit && fTree.getFirstInRange(after, false, nullptr, false, entry))
+		{
+			fPostings[PostingSlot::fromTreeValue(entry.second).getIndex()].appendTo(ptrs);
+			last = entry.first;
+			after = &last;
+		}
+	}
+
+	/**
+	 * @brief Count the indexed records whose key lies between two bounds, see getRecordPtrsInRange.
+	 * The records of a key are counted by the size of its posting list, no pointer is copied
+	 * @return the number of records in the range
+	*/
+	size_t countInRange(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive)
+	{
+		if (!lower && !upper)
+			return fEntries;
+
+		size_t count = 0;
+		fTree.forEachInRange(lower, lowerInclusive, upper, upperInclusive, [&](const data& entry)
+			{
+				count += fPostings[PostingSlot::fromTreeValue(entry.second).getIndex()].size();
+			});
+
+		return count;
+	}
+
+	/**
+	 * @brief Find the smallest or the greatest key between two bounds in O(log n)
+	 * @param last - if True the greatest key is looked for, the smallest one otherwise
+	 * @param key - set to the found key, if the range holds one
+	 * @return True if the range holds a key, false otherwise
+	*/
+	bool getBoundaryKey(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive, bool last, TypeWrapper& key) const
+	{
+		data entry;
+		bool found = last ? fTree.getLastInRange(lower, lowerInclusive, upper, upperInclusive, entry)
+			: fTree.getFirstInRange(lower, lowerInclusive, upper, upperInclusive, entry);
+		if (found)
+			key = entry.first;
+
+		return found;
+	}
+
+	/**
+	 * @brief Find the key of the record at a given position among the indexed records between two bounds, in ascending key order.
+	 * The keys are visited and their records counted by the sizes of their posting lists, like in countInRange
+	 * @param position - position of the record in the range, 0 is the first one
+	 * @param key - set to the key of that record, if the range holds that many records
+	 * @return True if the range holds more than position records, false otherwise
+	*/
+	bool getKeyAtPosition(const TypeWrapper* lower, bool lowerInclusive, const TypeWrapper* upper, bool upperInclusive, size_t position, TypeWrapper& key)
+	{
+		bool found = false;
+		fTree.forEachInRange(lower, lowerInclusive, upper, upperInclusive, [&](const data& entry)
+			{
+				size_t count = fPostings[PostingSlot::fromTreeValue(entry.second).getIndex()].size();
+				if (found)
+					return;
+
+				if (position < count)
+				{
+					key = entry.first;
+					found = true;
+				}
+				else
+				{
+					position -= count;
+				}
+			});
+
+		return found;
+	}
+
+	/**
+	 * @brief Build the key of a record
+	 * @param record - the record
+	 * @param colIndex - position of every column in the record
+	 * @return the value of the indexed column, or the composite of the values of all indexed columns
+	*/
+	TypeWrapper makeKey(const Record& record, const unordered_map<string, size_t>& colIndex) const
+	{
+		if (fColumns.size() == 1)
+			return record.get(colIndex.at(fColumns[0]));
+
+		vector<TypeWrapper> parts;
+		parts.reserve(fColumns.size());
+		for (const string& column : fColumns)
+			parts.push_back(record.get(colIndex.at(column)));
+
+		return TypeWrapper(parts);
+	}
+
+	/**
+	 * @brief Pick the values of the included columns out of a record
+	 * @param record - the record
+	 * @param colIndex - position of every column in the record
+	 * @return the values in the order of getIncludeColumns, an empty record if the index includes no columns
+	*/
+	Record makeIncluded(const Record& record, const unordered_map<string, size_t>& colIndex) const
+	{
+		Record included(fIncludeColumns.size());
+		for (const string& column : fIncludeColumns)
+			included.addValue(record.get(colIndex.at(column)));
+
+		return included;
+	}
+
+	/**
+	 * @return the indexed columns separated by commas
+	*/
+	const string& getColumn() const { return fColumn; }
+
+	/**
+	 * @return the indexed columns followed by the included ones, if any
+	*/
+	string getDescription() const
+	{
+		string description = fColumn;
+		for (size_t i = 0; i < fIncludeColumns.size(); i++)
+			description += (i == 0 ? INCLUDE_SEPARATOR : ",") + fIncludeColumns[i];
+
+		return description;
+	}
+
+	const vector<string>& getColumns() const { return fColumns; }
+
+	const vector<string>& getIncludeColumns() const { return fIncludeColumns; }
+
+	bool isComposite() const { return fColumns.size() > 1; }
+
+	bool hasIncludes() const { return !fIncludeColumns.empty(); }
+
+	/**
+	 * @param column - name of a column
+	 * @return whether the column's values can be read from the index, as part of the key or as an included column
+	*/
+	bool covers(const string& column) const
+	{
+		return std::find(fColumns.begin(), fColumns.end(), column) != fColumns.end()
+			|| std::find(fIncludeColumns.begin(), fIncludeColumns.end(), column) != fIncludeColumns.end();
+	}
+
+	/**
+	 * @return the number of indexed records
+	*/
+	size_t size() const { return fEntries; }
+
+	/**
+	 * @return the number of distinct values of the indexed column(s)
+	*/
+	size_t distinctKeys() const { return fTree.size(); }
+
+private:
+	string fColumn;
+	vector<string> fColumns;
+	vector<string> fIncludeColumns;
+	BPTree fTree;
+	vector<PostingList> fPostings;
+	vector<vector<Record>> fIncluded;
+	vector<int> fFreeSlots;
+	size_t fEntries;
+
+	/**
+	 * @brief Find the slot of the posting list of a key, creating the key if it isn't in the tree yet
+	*/
+	int getPostingSlot(const TypeWrapper& key)
+	{
+		RecordPtr treeValue;
+		if (fTree.find(key, treeValue))
+			return PostingSlot::fromTreeValue(treeValue).getIndex();
+
+		int slot;
+		if (!fFreeSlots.empty())
+		{
+			slot = fFreeSlots.back();
+			fFreeSlots.pop_back();
+		}
+		else
+		{
+			slot = fPostings.size();
+			fPostings.push_back(PostingList());
+			if (hasIncludes())
+				fIncluded.push_back(vector<Record>());
+		}
+
+		fTree.insert({ key, PostingSlot(slot).getTreeValue() });
+		return slot;
+	}
+};
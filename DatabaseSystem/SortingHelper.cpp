@@ -29,4 +29,51 @@ void heapSort(vector<Record>& arr, int columnId)
 		std::swap(arr[0], arr[i]);
 		heapify(arr, i, 0, columnId);
 	}
+}
+
+/**
+ * @return whether a comes after b when comparing the given columns one after another
+*/
+static bool isGreaterOn(const Record& a, const Record& b, const vector<int>& columnIds)
+{
+	for (int columnId : columnIds)
+	{
+		if (a.get(columnId) > b.get(columnId))
+			return true;
+		if (a.get(columnId) < b.get(columnId))
+			return false;
+	}
+
+	return false;
+}
+
+void heapify(vector<Record>& arr, int n, int i, const vector<int>& columnIds)
+{
+	int largest = i;
+	int l = 2 * i + 1;
+	int r = 2 * i + 2;
+
+	if (l < n && isGreaterOn(arr[l], arr[largest], columnIds))
+		largest = l;
+
+	if (r < n && isGreaterOn(arr[r], arr[largest], columnIds))
+		largest = r;
+
+	if (largest != i) {
+		std::swap(arr[i], arr[largest]);
+
+		heapify(arr, n, largest, columnIds);
+	}
+}
+
+void heapSort(vector<Record>& arr, const vector<int>& columnIds)
+{
+	int n = arr.size();
+	for (int i = n / 2 - 1; i >= 0; i--)
+		heapify(arr, n, i, columnIds);
+
+	for (int i = n - 1; i > 0; i--) {
+		std::swap(arr[0], arr[i]);
+		heapify(arr, i, 0, columnIds);
+	}
 }
\ No newline at end of file
@@ -4,3 +4,7 @@
 void heapSort(vector<Record>& arr, int columnId);
 
 void heapify(vector<Record>& arr, int n, int i, int columnId);
+
+void heapSort(vector<Record>& arr, const vector<int>& columnIds);
+
+void heapify(vector<Record>& arr, int n, int i, const vector<int>& columnIds);
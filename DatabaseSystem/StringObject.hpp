@@ -34,7 +34,12 @@ public:
 		return fValue.size();
 	}
 
-	virtual void write(ofstream& out) const final override
+	virtual size_t hash() const final override
+	{
+		return std::hash<string>()(fValue);
+	}
+
+	virtual void write(ostream& out) const final override
 	{
 		size_t size = 0;
 
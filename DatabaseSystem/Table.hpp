@@ -6,11 +6,24 @@
 #include<map>
 #include<unordered_map>
 #include <filesystem>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <cstdint>
 #include "Page.hpp"
+#include "TableSpace.hpp"
 #include "BPTree.hpp"
+#include "SecondaryIndex.hpp"
+#include "HashIndex.hpp"
+#include "ArtIndex.hpp"
+#include "IndexType.h"
+#include "KeyRange.hpp"
+#include "Aggregate.hpp"
 #include "FileHelper.hpp"
 #include "Query.hpp"
 #include "SortingHelper.h"
+#include "ParallelHelper.hpp"
+#include "WriteAheadLog.hpp"
 
 using std::multimap;
 using std::map;
@@ -24,14 +37,17 @@ using std::invalid_argument;
 using std::exception;
 using std::logic_error;
 using std::list;
+using std::shared_ptr;
 
 namespace fs = std::filesystem;
 using fh = FileHelper;
+using ph = ParallelHelper;
 
 class Table
 {
 public:
-	Table() : curPageIndex(0), numOfColumns(0), bytes(0), maxRecordsPerPage(1024) {}
+	Table() : bytes(0), recordsCount(0), maxRecordsPerPage(1024), curPageIndex(0), numOfColumns(0), primaryIndexType(IndexType::BPTREE),
+		usesTableSpace(false), checkpointLsn(0), dirtyPages(std::make_shared<DirtyPages>()), isPrimaryIndexStale(false) {}
 
 	/**
 	 * Create a new table with the specified parameter list
@@ -40,10 +56,15 @@ public:
 	 * @param htblColNameType the types of table columns
 	 * @param strKeyColName the primary key of the table
 	 * @param maxTuplesPerPage the maximum number of records a page can hold
+	 * @param useTableSpace whether all pages are kept in a single data file instead of one file per page
+	 * @param indexType the structure of the primary key index
 	 */
 	Table(const string& path, const string& tableName, unordered_map<string, string>& colNameType, vector<string>& colNames,
-		const string& indexedColName, int maxRecordsPerPage)
+		const string& indexedColName, int maxRecordsPerPage, bool useTableSpace = false, IndexType indexType = IndexType::BPTREE)
 	{
+		if (indexType == IndexType::ART && !indexedColName.empty() && colNameType.count(indexedColName) && colNameType.at(indexedColName) != "Integer")
+			throw invalid_argument("An ART index needs an Integer primary key");
+
 		this->path = path + tableName + "/";
 		this->tableName = tableName;
 		this->primaryKey = indexedColName;
@@ -52,6 +73,12 @@ public:
 		this->curPageIndex = -1;
 		this->numOfColumns = 0;
 		this->bytes = 0;
+		this->recordsCount = 0;
+		this->checkpointLsn = 0;
+		this->usesTableSpace = useTableSpace;
+		this->primaryIndexType = indexType;
+		this->dirtyPages = std::make_shared<DirtyPages>();
+		this->isPrimaryIndexStale = false;
 
 		for (const string& name : colNames)
 			tableHeader += name + ",";
@@ -62,14 +89,15 @@ public:
 		if (!primaryKey.empty())
 			createIndex(primaryKey);
 
-		saveTable();
+		checkpoint();
 	}
 
 	/**
 	 * @brief Reading constructor
 	 * @param in
 	*/
-	Table(ifstream& in)
+	Table(ifstream& in) : recordsCount(0), primaryIndexType(IndexType::BPTREE), usesTableSpace(false), checkpointLsn(0), dirtyPages(std::make_shared<DirtyPages>()),
+		isPrimaryIndexStale(false)
 	{
 		in.read((char*)&bytes, sizeof(bytes));
 		in.read((char*)&maxRecordsPerPage, sizeof(maxRecordsPerPage));
@@ -93,17 +121,56 @@ public:
 		if (!primaryKey.empty())
 			indexedColumnRecords = BPTree(in);
 
+		// Tables saved before tablespaces existed end here and keep their one-file-per-page layout
+		if (!in.read((char*)&usesTableSpace, sizeof(usesTableSpace)))
+			usesTableSpace = false;
+
+		if (usesTableSpace)
+			getTableSpace();
+
+		size_t secondaryIndexesCount = 0;
+		if (in.read((char*)&secondaryIndexesCount, sizeof(secondaryIndexesCount)))
+			for (size_t i = 0; i < secondaryIndexesCount; i++)
+				secondaryIndexes.push_back(SecondaryIndex(in));
+
+		// A hash or radix primary index is stored here, the tree written after the columns is then left empty
+		if (!in.read((char*)&primaryIndexType, sizeof(primaryIndexType)))
+			primaryIndexType = IndexType::BPTREE;
+		else if (primaryIndexType == IndexType::HASH)
+			hashedColumnRecords = HashIndex(in);
+		else if (primaryIndexType == IndexType::ART)
+			radixColumnRecords = ArtIndex(in);
+
 		vector<string> header = sh::splitBy(tableHeader, ",");
 		sh::removeEmptyStringsInVector(header);
 		initializeColumnsIndexes(header);
+
+		// Tables saved before the records were counted are counted once, by reading their pages
+		if (!in.read((char*)&recordsCount, sizeof(recordsCount)))
+			recordsCount = countRecords();
+
+		if (!in.read((char*)&checkpointLsn, sizeof(checkpointLsn)))
+			checkpointLsn = 0;
+
+		// Tables saved before the primary B+ tree got its own index file keep the whole tree after the columns
+		bool isIndexInFile = false;
+		if (!in.read((char*)&isIndexInFile, sizeof(isIndexInFile)))
+			isIndexInFile = false;
+
+		if (isIndexInFile)
+			loadPrimaryIndex();
+
+		recover();
 	}
 
 	/**
-	 *	@brief Save table to binary file on the disk
+	 *	@brief Save table to binary file on the disk. The file is replaced at once: the table is written to a temporary file
+	 *	which is then renamed, so a crash leaves either the old or the new file
 	 */
 	void saveTable()
 	{
-		ofstream out(path + tableName + ".bin", std::ios::binary);
+		string tablePath = path + tableName + ".bin";
+		ofstream out(tablePath + ".tmp", std::ios::binary);
 		if (!out.is_open())
 			throw exception("Couldn't open file to save the table");
 
@@ -124,10 +191,34 @@ public:
 			fh::writeString(out, entry.second);
 		}
 
-		if (!primaryKey.empty())
+		// The primary B+ tree is written to its index file by checkpoint, an empty tree takes its place here
+		if (hasIndexFile())
+			BPTree().write(out);
+		else if (!primaryKey.empty())
 			indexedColumnRecords.write(out);
 
+		out.write((char*)&usesTableSpace, sizeof(usesTableSpace));
+
+		size_t secondaryIndexesCount = secondaryIndexes.size();
+		out.write((char*)&secondaryIndexesCount, sizeof(secondaryIndexesCount));
+		for (SecondaryIndex& index : secondaryIndexes)
+			index.write(out);
+
+		out.write((char*)&primaryIndexType, sizeof(primaryIndexType));
+		if (primaryIndexType == IndexType::HASH)
+			hashedColumnRecords.write(out);
+		else if (primaryIndexType == IndexType::ART)
+			radixColumnRecords.write(out);
+
+		out.write((char*)&recordsCount, sizeof(recordsCount));
+		out.write((char*)&checkpointLsn, sizeof(checkpointLsn));
+
+		bool isIndexInFile = hasIndexFile();
+		out.write((char*)&isIndexInFile, sizeof(isIndexInFile));
 		out.close();
+
+		fh::syncFile(tablePath + ".tmp");
+		fs::rename(tablePath + ".tmp", tablePath);
 	}
 
 	/**
@@ -162,9 +253,7 @@ public:
 		int colPos = colIndex.at(strColName);
 
 		for (int index = 0; index <= curPageIndex; index++) {
-			ifstream in(path + tableName + "_" + to_string(index) + ".bin", std::ios::binary);
-
-			Page p(in);
+			Page p = loadPage(index);
 			for (int i = 0; i < p.size(); ++i)
 			{
 				Record r = p.get(i);
@@ -172,13 +261,61 @@ public:
 					continue;
 
 				RecordPtr recordReference(index, i);
-				indexedColumnRecords.insert({ r.get(colPos), recordReference });
+				insertPrimary(r.get(colPos), recordReference);
 			}
+		}
+
+		checkpoint();
+	}
+
+	/**
+	 * @brief Creates a non-unique index on a column that isn't the primary key, or a composite index on several columns.
+	 * The index is built from the records already in the table and is maintained on every insert and delete
+	 * @param colNames - the columns to be indexed, in the order their values are compared
+	 * @param includeColNames - columns whose values are stored in the index, so it can answer queries reading them
+	*/
+	void createSecondaryIndex(const vector<string>& colNames, const vector<string>& includeColNames = vector<string>())
+	{
+		if (colNames.empty())
+			throw invalid_argument("No columns given for the index");
+
+		for (const string& colName : colNames)
+			if (colTypes.find(colName) == colTypes.end())
+				throw invalid_argument("Cannot put Index on non existing column");
 
-			in.close();
+		for (const string& colName : includeColNames)
+			if (colTypes.find(colName) == colTypes.end())
+				throw invalid_argument("Cannot include non existing column " + colName + " in an index");
+
+		SecondaryIndex index(colNames, includeColNames);
+		if ((colNames.size() == 1 && colNames[0] == primaryKey) || findSecondaryIndex(index.getColumn()) != nullptr)
+			throw invalid_argument("Column " + index.getColumn() + " is already indexed");
+
+		for (int page = 0; page <= curPageIndex; page++) {
+			Page p = loadPage(page);
+			for (size_t i = 0; i < p.size(); ++i)
+			{
+				const Record& r = p.at(i);
+				if (!r.isInvalid())
+					index.insert(index.makeKey(r, colIndex), RecordPtr(page, i), index.makeIncluded(r, colIndex));
+			}
 		}
 
-		saveTable();
+		secondaryIndexes.push_back(std::move(index));
+		checkpoint();
+	}
+
+	/**
+	 * @param colName - name of a column, or comma separated columns of a composite index
+	 * @return the secondary index on that column, nullptr if the column has none
+	*/
+	SecondaryIndex* findSecondaryIndex(const string& colName)
+	{
+		for (SecondaryIndex& index : secondaryIndexes)
+			if (index.getColumn() == colName)
+				return &index;
+
+		return nullptr;
 	}
 
 	/**
@@ -188,11 +325,108 @@ public:
 	Page createPage()
 	{
 		curPageIndex++;
-		Page p(maxRecordsPerPage, path + tableName + "_" + std::to_string(curPageIndex) + ".bin");
-		saveTable();
+		Page p(maxRecordsPerPage, getPagePath(curPageIndex));
+		savePage(curPageIndex, p);
+		return p;
+	}
+
+	/**
+	 * @brief Get the path of the file holding the page with the given index
+	 * @param index - index of the page
+	 * @return the page's own file, or the table's data file if the table uses a tablespace
+	*/
+	string getPagePath(int index) const
+	{
+		if (usesTableSpace)
+			return path + tableName + ".dat";
+
+		return path + tableName + "_" + to_string(index) + ".bin";
+	}
+
+	/**
+	 * @brief Read the page with the given index, a page changed since the last checkpoint is taken from memory
+	 * @param index - index of the page
+	 * @return the page
+	*/
+	Page loadPage(int index)
+	{
+		{
+			lock_guard<mutex> lock(dirtyPages->fLock);
+			auto it = dirtyPages->fPages.find(index);
+			if (it != dirtyPages->fPages.end())
+				return it->second;
+		}
+
+		return readPage(index);
+	}
+
+	/**
+	 * @brief Read the page with the given index from the disk
+	 * @param index - index of the page
+	 * @return the page
+	*/
+	Page readPage(int index)
+	{
+		if (usesTableSpace)
+			return getTableSpace().readPage(index);
+
+		string pagePath = getPagePath(index);
+		ifstream in(pagePath, std::ios::binary);
+		if (!in.is_open())
+			throw std::invalid_argument("Couldnt open page at path " + pagePath + " for reading.");
+
+		Page p(in);
+		in.close();
 		return p;
 	}
 
+	/**
+	 * @brief Keep a changed page in memory until the next checkpoint writes it to the disk,
+	 * the change itself has to be in the log (see logChange)
+	 * @param index - index of the page
+	 * @param page - the changed page
+	*/
+	void savePage(int index, const Page& page)
+	{
+		lock_guard<mutex> lock(dirtyPages->fLock);
+		auto it = dirtyPages->fPages.find(index);
+		if (it != dirtyPages->fPages.end())
+			it->second = page;
+		else
+			dirtyPages->fPages.insert({ index, page });
+	}
+
+	/**
+	 * @brief Write the page with the given index to the disk
+	 * @param index - index of the page
+	 * @param page - the page to be written
+	*/
+	void writePage(int index, const Page& page)
+	{
+		if (usesTableSpace)
+			getTableSpace().writePage(index, page);
+		else
+			page.save();
+	}
+
+	/**
+	 * @brief Release the files held open by the table (i.e. before its directory gets deleted)
+	*/
+	void closeStorage()
+	{
+		if (tableSpace)
+			tableSpace->close();
+
+		if (indexSpace)
+			indexSpace->close();
+
+		if (wal)
+			wal->close();
+
+		lock_guard<mutex> lock(dirtyPages->fLock);
+		dirtyPages->fPages.clear();
+	}
+
 	/**
 	 *	@brief Check wether an object matches its specified type (column type)
 	 *	@param value - the object to be checked
@@ -227,7 +461,7 @@ public:
 			if (primaryValue.getContent() == nullptr)
 				throw invalid_argument("Primary key is not allowed to be empty");
 
-			if (checkRecordExists(primaryKey, primaryValue))
+			if (primaryKeyExists(primaryValue))
 				throw invalid_argument("Primary key " + primaryKey + " is already used before");
 		}
 
@@ -237,34 +471,85 @@ public:
 		for (const string& entry : header)
 			r.addValue(colNameValue[entry]);
 
-		Page page = addRecord(r);
-
-		if (!primaryKey.empty())
-			indexedColumnRecords.insert({ colNameValue.at(primaryKey), RecordPtr(curPageIndex, page.size() - 1) });
-
-		saveTable();
+		RecordPtr recordReference = addRecord(r);
+		indexRecord(r, recordReference);
 	}
 
 	/**
-	 *	@brief Add a new record to the table
+	 *	@brief Add a new record to the table, the change is logged
 	 *	@param record - the record to be added
+	 *	@return the position of the added record
 	 */
-	Page addRecord(Record& record)
+	RecordPtr addRecord(Record& record)
 	{
-		string pagePath = path + tableName + "_" + std::to_string(curPageIndex) + ".bin";
-		ifstream in(pagePath, std::ios::binary);
-		if (!in.is_open())
-			throw std::invalid_argument("Couldnt open page at path " + pagePath + " for reading.");
-
-		Page p(in);
-		if (p.isFull())
-			p = createPage();
+		Page* p = &getDirtyPage(curPageIndex);
+		if (p->isFull())
+		{
+			createPage();
+			p = &getDirtyPage(curPageIndex);
+		}
 
-		p.addRecord(record);
+		p->addRecord(record);
 		bytes += record.getKiloBytesData();
+		recordsCount++;
 
-		in.close();
-		return p;
+		RecordPtr recordReference(curPageIndex, p->size() - 1);
+		logChange(LogRecordType::INSERT, recordReference, nullptr, &record);
+		return recordReference;
+	}
+
+	/**
+	 * @brief Make the changes logged so far durable. A statement is committed once all of its changes are logged,
+	 * the changed pages and indexes are written to the disk later by a checkpoint. A checkpoint is made when the log
+	 * grows over WAL_CHECKPOINT_BYTES or more than WAL_MAX_DIRTY_PAGES pages wait to be written
+	*/
+	void commit()
+	{
+		getLog().commit();
+
+		size_t dirtyCount = 0;
+		{
+			lock_guard<mutex> lock(dirtyPages->fLock);
+			dirtyCount = dirtyPages->fPages.size();
+		}
+
+		if (getLog().size() > WAL_CHECKPOINT_BYTES || dirtyCount > WAL_MAX_DIRTY_PAGES)
+			checkpoint();
+	}
+
+	/**
+	 * @brief Write every page changed since the last checkpoint, the changed nodes of the primary B+ tree and the table's
+	 * metadata with the other indexes to the disk, then empty the log. The metadata records the LSN of the last change it contains, so a crash before the log is emptied
+	 * doesn't redo the changes twice. After a failed write of the log the pages are written without it, which is the only way
+	 * to make those changes durable
+	*/
+	void checkpoint()
+	{
+		if (!getLog().hasFailed())
+			getLog().commit();
+
+		unordered_map<int, Page> pages;
+		{
+			lock_guard<mutex> lock(dirtyPages->fLock);
+			pages.swap(dirtyPages->fPages);
+		}
+
+		for (pair<const int, Page>& entry : pages)
+		{
+			writePage(entry.first, entry.second);
+			if (!usesTableSpace)
+				fh::syncFile(getPagePath(entry.first));
+		}
+
+		if (usesTableSpace && !pages.empty())
+			getTableSpace().sync();
+
+		checkpointLsn = getLog().getLastLsn();
+		if (hasIndexFile())
+			indexedColumnRecords.flush(getIndexSpace(), checkpointLsn);
+
+		saveTable();
+		getLog().truncate();
 	}
 
 	/**
@@ -329,10 +614,45 @@ public:
 	*/
 	void orderBy(vector<Record>& target, const string& orderByWhat)
 	{
-		if (colIndex.find(orderByWhat) == colIndex.end())
-			throw invalid_argument("Cannot select a column that is not part of the scheme. (" + orderByWhat + ")");
+		vector<string> columns = splitColumnList(orderByWhat);
+		vector<int> columnIds;
+		for (const string& column : columns)
+		{
+			if (colIndex.find(column) == colIndex.end())
+				throw invalid_argument("Cannot select a column that is not part of the scheme. (" + column + ")");
+
+			columnIds.push_back(colIndex[column]);
+		}
+
+		if (columnIds.size() == 1)
+			heapSort(target, columnIds[0]);
+		else
+			heapSort(target, columnIds);
+	}
+
+	/**
+	 * @param list - column names separated by commas, i.e. "name, grade". Commas inside braces don't separate,
+	 * so an aggregate with several arguments stays one item, i.e. "PERCENTILE(grade, 0.9)"
+	 * @return the trimmed column names
+	*/
+	static vector<string> splitColumnList(const string& list)
+	{
+		vector<string> columns(1);
+		int depth = 0;
+		for (char c : list)
+		{
+			depth += c == '(' ? 1 : c == ')' ? -1 : 0;
+			if (c == ',' && depth == 0)
+				columns.emplace_back();
+			else
+				columns.back() += c;
+		}
 
-		heapSort(target, colIndex[orderByWhat]);
+		for (string& column : columns)
+			sh::trim(column);
+
+		sh::removeEmptyStringsInVector(columns);
+		return columns;
 	}
 
 	/**
@@ -342,6 +662,21 @@ public:
 	*/
 	vector<Record> select(Query& query)
 	{
+		vector<RecordPtr> candidates;
+		if (getMostSelectiveCandidates(query, candidates))
+		{
+			vector<Record> fetched = fetchRecordsByReference(candidates);
+			if (query.getShuntingOutput().size() == 1)
+				return fetched;
+
+			vector<Record> answer;
+			for (Record& r : fetched)
+				if (query.checkRecordAgainstQuery(r, colIndex))
+					answer.push_back(std::move(r));
+
+			return answer;
+		}
+
 		stack<vector<Record>> result;
 		queue<string> output = query.getShuntingOutput();
 
@@ -350,31 +685,17 @@ public:
 			if (sh::isStringInteger(output.front()))
 			{
 				InternalQuery curr = query.getNumberedQueries().at(output.front());
-				if (curr.isPrimaryKeyQuery())
+				vector<RecordPtr> fromIndex;
+				if (getIndexedRecordPtrs(curr, fromIndex))
 				{
-					vector<RecordPtr> fromTree = indexedColumnRecords.getRecordsFromQuery(curr);
-					if (!fromTree.empty())
-						result.push(fetchRecordsByReference(fromTree));
+					if (!fromIndex.empty())
+						result.push(fetchRecordsByReference(fromIndex));
 					else
 						result.push(vector<Record>());
 				}
 				else
 				{
-					vector<Record> answer;
-					for (size_t index = 0; index <= curPageIndex; index++) {
-						ifstream in(path + tableName + "_" + to_string(index) + ".bin", std::ios::binary);
-
-						Page p(in);
-						for (size_t i = 0; i < p.size(); ++i)
-						{
-							Record r = p.get(i);
-							if (!r.isInvalid())
-								if (curr.checkRecordAgainstCondition(colIndex, r))
-									answer.push_back(r);
-						}
-						in.close();
-					}
-					result.push(answer);
+					result.push(scanPages([&](const Record& r) { return curr.checkRecordAgainstCondition(colIndex, r); }));
 				}
 
 				output.pop();
@@ -425,183 +746,1436 @@ public:
 	}
 
 	/**
-	 * @brief Acts just like select with given query, but can also pass arguments wheter to sort it by
-	 * given column or/and to get only the distinct elements
-	 * @param query - WHERE clause
-	 * @param orderByWhat - by which column shall the sorting be done
-	 * @param isDistinct - if True then the answer shall not contain any duplicates of the selected columns
-	 * @param selectedCols - columns that the user is selecting
-	 * @return array of selected records
+	 * @brief Look up a single condition in the index of its column
+	 * @param condition - condition of the form {column} {operator} {value}
+	 * @param ptrs - filled with the pointers to the records satisfying the condition
+	 * @return True if the column has an index (primary or secondary), false if the condition needs a scan
 	*/
-	vector<Record> select(Query& query, const string& orderByWhat, bool isDistinct, vector<string>& selectedCols)
+	bool getIndexedRecordPtrs(InternalQuery& condition, vector<RecordPtr>& ptrs)
 	{
-		vector<Record> answer;
-		if (!query.getShuntingOutput().empty())
+		if (condition.isPrimaryKeyQuery() && primaryIndexType == IndexType::HASH)
 		{
-			answer = select(query);
+			// A hash index answers only equality, any other comparison needs a scan
+			RecordPtr ptr;
+			if (condition.getOperator() != Operator::EQUAL)
+				return false;
+
+			ptrs.clear();
+			if (hashedColumnRecords.find(condition.getValue(), ptr))
+				ptrs.push_back(ptr);
+
+			return true;
 		}
-		else
-		{
-			for (size_t index = 0; index <= curPageIndex; index++) {
-				ifstream in(path + tableName + "_" + to_string(index) + ".bin", std::ios::binary);
 
-				Page p(in);
-				for (size_t i = 0; i < p.size(); ++i)
-				{
-					Record r = p.get(i);
-					if (!r.isInvalid())
-						answer.push_back(r);
-				}
-				in.close();
-			}
+		if (condition.isPrimaryKeyQuery() && primaryIndexType == IndexType::ART)
+		{
+			ptrs = radixColumnRecords.getRecordPtrs(condition.getOperator(), condition.getValue());
+			return true;
 		}
 
-		if (isDistinct)
-			answer = distinct(answer, selectedCols);
-		if (!orderByWhat.empty())
-			orderBy(answer, orderByWhat);
+		if (condition.isPrimaryKeyQuery())
+		{
+			ptrs = indexedColumnRecords.getRecordsFromQuery(condition);
+			return true;
+		}
 
-		return answer;
-	}
+		SecondaryIndex* index = findSecondaryIndex(condition.getColumn());
+		if (index == nullptr)
+			return false;
 
-	/**
-	 * @param recordReference - a tuple holding info about the index of the page that contains the record, and the record's id in the page
-	 * @return record in the specified reference.
-	 */
-	Record fetchRecordByReference(RecordPtr& recordReference)
-	{
-		string readPath = path + tableName + "_" + to_string(recordReference.getPage()) + ".bin";
-		ifstream in(readPath, std::ios::binary);
-		Page p(in);
-		Record r = p.get(recordReference.getIndexInPage());
-		in.close();
-		return r;
+		ptrs = index->getRecordPtrs(condition.getOperator(), condition.getValue());
+		return true;
 	}
 
 	/**
-	 * @brief Given vector of pointers to records, fetch them all
-	 * @param recordsReferences - vector of record pointers
-	 * @return the records pointed to by record pointers
+	 * @brief Query planner. When the WHERE clause is made only of conditions joined with AND,
+	 * every condition on an indexed column is looked up in its index and the one giving the fewest records
+	 * (the most selective index) provides the candidates. The rest of the conditions are then checked on the candidates only.
+	 * @param query - WHERE clause
+	 * @param candidates - filled with pointers to the records that may satisfy the query
+	 * @return True if the candidates come from an index, false if the query has to be evaluated condition by condition
 	*/
-	vector<Record> fetchRecordsByReference(vector<RecordPtr>& recordsReferences)
+	bool getMostSelectiveCandidates(Query& query, vector<RecordPtr>& candidates)
 	{
-		vector<Record> res;
+		vector<string> conditions;
+		if (!getConjunctiveConditions(query, conditions))
+			return false;
 
-		// Sort refs by page in ascending order, then by index in page in ascending order
-		for (size_t i = 0; i < recordsReferences.size() - 1; i++)
+		bool found = false;
+		for (const string& id : conditions)
 		{
-			size_t min = i;
-			for (size_t j = i + 1; j < recordsReferences.size(); j++)
-				if (recordsReferences[j] < recordsReferences[min])
-					min = j;
+			vector<RecordPtr> ptrs;
+			if (!getIndexedRecordPtrs(query.getNumberedQueries().at(id), ptrs))
+				continue;
+
+			if (!found || ptrs.size() < candidates.size())
+			{
+				candidates = std::move(ptrs);
+				found = true;
+			}
 
-			std::swap(recordsReferences[min], recordsReferences[i]);
+			if (candidates.empty())
+				break;
 		}
 
-		// Whisk through the pages, first opening the one with index 0, then 1, then 2...
-		// and extracting the needed records. Prioritizes extracting the records from the current page, then the next, without
-		// having to reopen on every iteration for every record
-		for (size_t i = 0; i < recordsReferences.size(); i++)
+		for (SecondaryIndex& index : secondaryIndexes)
 		{
-			string readPath = path + tableName + "_" + to_string(recordsReferences[i].getPage()) + ".bin";
-			ifstream in(readPath, std::ios::binary);
-			Page p(in);
-			Record r = p.get(recordsReferences[i].getIndexInPage());
+			if (!index.isComposite() || (found && candidates.empty()))
+				continue;
 
-			if (i < recordsReferences.size() - 1 && recordsReferences[i].getPage() != recordsReferences[i + 1].getPage())
-			{
-				if (!p.get(recordsReferences[i].getIndexInPage()).isInvalid())
-					res.push_back(p.get(recordsReferences[i].getIndexInPage()));
-			}
-			else
-			{
-				while (i < recordsReferences.size() - 1 && recordsReferences[i].getPage() == recordsReferences[i + 1].getPage())
-				{
-					if (!p.get(recordsReferences[i].getIndexInPage()).isInvalid())
-						res.push_back(p.get(recordsReferences[i].getIndexInPage()));
+			KeyRange range;
+			if (!getKeyRange(index.getColumns(), true, query, conditions, range))
+				continue;
 
-					i++;
-				}
+			vector<RecordPtr> ptrs = index.getRecordPtrsInRange(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive);
+			if (!found || ptrs.size() < candidates.size())
+			{
+				candidates = std::move(ptrs);
+				found = true;
 			}
-
-			if (i == recordsReferences.size() - 1)
-				if (!p.get(recordsReferences[i].getIndexInPage()).isInvalid())
-					res.push_back(p.get(recordsReferences[i].getIndexInPage()));
-
-			in.close();
 		}
 
-		return res;
+		return found;
 	}
 
 	/**
-	 * @brief Deletes all the records satisfying the where criteria
-	 * @param query - query containing the where conditions
-	 * @return the number of deleted records in the table
+	 * @param query - WHERE clause
+	 * @param conditions - filled with the ids of the clause's conditions
+	 * @return True if the conditions are joined only with AND, false if the clause has an OR
 	*/
-	int deleteRecord(Query& query)
+	bool getConjunctiveConditions(Query& query, vector<string>& conditions)
 	{
-		int deletedRecords = 0;
-		if (!query.getShuntingOutput().empty())
+		queue<string> output = query.getShuntingOutput();
+		while (!output.empty())
 		{
-			if (!primaryKey.empty())
-			{
-				vector<Record> answer = select(query);
-				for (size_t i = 0; i < answer.size(); i++)
-				{
-					Record r = answer[i];
-					if (r.isInvalid())
-						continue;
-					RecordPtr rPtr = indexedColumnRecords.getRecordAtIndex(r.get(colIndex[primaryKey]));
-					ifstream in(path + tableName + "_" + to_string(rPtr.getPage()) + ".bin", std::ios::binary);
-					Page p(in);
-					bytes -= r.getKiloBytesData();
-					p.removeRecord(rPtr.getIndexInPage());
-					deleteRecord(r);
-					deletedRecords++;
-					in.close();
-				}
-			}
-			else
-			{
-				for (size_t index = 0; index <= curPageIndex; index++)
-				{
-					ifstream in(path + tableName + "_" + to_string(index) + ".bin", std::ios::binary);
-					Page page(in);
-					for (size_t i = 0; i < page.size(); i++)
-					{
-						Record r = page.get(i);
+			if (output.front() == "OR")
+				return false;
 
-						if (!r.isInvalid() && query.checkRecordAgainstQuery(r, colIndex))
-						{
-							bytes -= r.getKiloBytesData();
-							page.removeRecord(i);
-							deletedRecords++;
-						}
-					}
-				}
-			}
+			if (sh::isStringInteger(output.front()))
+				conditions.push_back(output.front());
+
+			output.pop();
 		}
 
-		saveTable();
-		return deletedRecords;
+		return true;
 	}
 
 	/**
-	 * @brief Deletes the given record from the BPTree if the table has primary key
-	 * @param record - record that is to be deleted from the tree
+	 * @brief Turn the conditions of an AND-only WHERE clause into a range of keys of an index. A single column index is
+	 * bounded by the conditions on its column. A composite index is bounded by equality conditions on a leading prefix
+	 * of its columns, optionally followed by a range on the next column - all of them select one contiguous run of keys
+	 * @param columns - columns of the index
+	 * @param isComposite - whether the keys of the index are composite keys
+	 * @param query - WHERE clause
+	 * @param conditions - ids of the clause's conditions
+	 * @param range - filled with the bounds of the keys that may satisfy the conditions
+	 * @return True if the first column of the index has a usable condition, false if the index doesn't help
 	*/
-	void deleteRecord(Record& record)
+	bool getKeyRange(const vector<string>& columns, bool isComposite, Query& query, const vector<string>& conditions, KeyRange& range)
 	{
-		if (!primaryKey.empty())
+		vector<TypeWrapper> prefix;
+		InternalQuery* lowerCondition = nullptr;
+		InternalQuery* upperCondition = nullptr;
+		for (const string& column : columns)
 		{
-			int col = colIndex[primaryKey];
-			indexedColumnRecords.remove(record.get(col));
+			InternalQuery* equality = nullptr;
+			for (const string& id : conditions)
+			{
+				InternalQuery& condition = query.getNumberedQueries().at(id);
+				if (condition.getColumn() != column || !checkType(condition.getValue(), colTypes.at(column)))
+					continue;
+
+				Operator op = condition.getOperator();
+				if (op == Operator::EQUAL)
+					equality = &condition;
+				else if (op == Operator::GREATER_THAN || op == Operator::GREATER_THAN_OR_EQUAL)
+					lowerCondition = &condition;
+				else if (op == Operator::LESS_THAN || op == Operator::LESS_THAN_OR_EQUAL)
+					upperCondition = &condition;
+			}
+
+			if (equality == nullptr)
+				break;
+
+			prefix.push_back(equality->getValue());
+			lowerCondition = upperCondition = nullptr;
 		}
-	}
 
-	/**
-	 *	@brief Check that all specified columns are in the table schema and matches the defined types
+		if (prefix.empty() && lowerCondition == nullptr && upperCondition == nullptr)
+			return false;
+
+		if (!isComposite)
+		{
+			if (!prefix.empty())
+			{
+				range.setLower(prefix[0], true);
+				range.setUpper(prefix[0], true);
+			}
+			if (lowerCondition)
+				range.setLower(lowerCondition->getValue(), lowerCondition->getOperator() == Operator::GREATER_THAN_OR_EQUAL);
+			if (upperCondition)
+				range.setUpper(upperCondition->getValue(), upperCondition->getOperator() == Operator::LESS_THAN_OR_EQUAL);
+
+			return true;
+		}
+
+		// Without a range on the next column both bounds are the prefix itself, which covers every key starting with it
+		vector<TypeWrapper> lowerParts = prefix, upperParts = prefix;
+		bool lowerInclusive = true, upperInclusive = true;
+		if (lowerCondition)
+		{
+			lowerParts.push_back(lowerCondition->getValue());
+			lowerInclusive = lowerCondition->getOperator() == Operator::GREATER_THAN_OR_EQUAL;
+		}
+		if (upperCondition)
+		{
+			upperParts.push_back(upperCondition->getValue());
+			upperInclusive = upperCondition->getOperator() == Operator::LESS_THAN_OR_EQUAL;
+		}
+
+		if (!lowerParts.empty())
+			range.setLower(TypeWrapper(lowerParts), lowerInclusive);
+		if (!upperParts.empty())
+			range.setUpper(TypeWrapper(upperParts), upperInclusive);
+
+		return true;
+	}
+
+	/**
+	 * @brief Acts just like select with given query, but can also pass arguments wheter to sort it by
+	 * given column or/and to get only the distinct elements
+	 * @param query - WHERE clause
+	 * @param orderByWhat - by which column shall the sorting be done
+	 * @param isDistinct - if True then the answer shall not contain any duplicates of the selected columns
+	 * @param selectedCols - columns that the user is selecting
+	 * @param isDescending - if True the records are ordered from the greatest to the smallest
+	 * @param limit - the most records to return, SIZE_MAX for all
+	 * @param offset - the number of records skipped before the returned ones
+	 * @return array of selected records
+	*/
+	vector<Record> select(Query& query, const string& orderByWhat, bool isDistinct, vector<string>& selectedCols,
+		bool isDescending = false, size_t limit = SIZE_MAX, size_t offset = 0)
+	{
+		vector<Record> answer;
+		bool isOrdered = false;
+		// distinct drops records after they are read, so only a scan without it can stop at the limit or skip the offset.
+		// A scan in the ORDER BY order skips the offset itself, any other answer is cut after it is sorted
+		size_t scanLimit = isDistinct ? SIZE_MAX : limit;
+		size_t scanOffset = isDistinct ? 0 : offset;
+		bool isCovered = selectFromIndexOnly(query, orderByWhat, selectedCols, isDescending, scanLimit, scanOffset, answer, isOrdered);
+		if (!isCovered)
+		{
+			if (!orderByWhat.empty() && selectInIndexOrder(query, orderByWhat, isDescending, scanLimit, scanOffset, answer))
+				isOrdered = true;
+			else if (!query.getShuntingOutput().empty())
+				answer = select(query);
+			else
+				answer = scanPages([](const Record&) { return true; });
+		}
+
+		// distinct keeps the relative order of the records, so an answer read in index order stays sorted
+		if (isDistinct)
+			answer = distinct(answer, selectedCols);
+		if (!orderByWhat.empty() && !isOrdered)
+		{
+			orderBy(answer, orderByWhat);
+			if (isDescending)
+				std::reverse(answer.begin(), answer.end());
+		}
+
+		if (isDistinct || !isOrdered)
+			answer.erase(answer.begin(), answer.begin() + std::min(offset, answer.size()));
+		if (answer.size() > limit)
+			answer.resize(limit);
+
+		return answer;
+	}
+
+	/**
+	 * @brief Index-only scan. When an index holds every column the query needs - the selected ones, the ones in the
+	 * WHERE clause and the ORDER BY ones - the answer is built from the index entries alone and no page is loaded.
+	 * The columns not held by the index are left empty in the returned records.
+	 * A covering index is used if the WHERE clause bounds its keys, or if no other index could narrow the query down
+	 * @param query - WHERE clause
+	 * @param orderByWhat - columns to order by, separated by commas
+	 * @param selectedCols - columns that the user is selecting
+	 * @param isDescending - if True the answer is ordered from the greatest to the smallest
+	 * @param limit - the scan stops after this many records if the answer comes in the ORDER BY order (or without one)
+	 * @param offset - the number of records skipped before the selected ones, only if the answer comes in the ORDER BY order.
+	 * The primary key's tree seeks the first one by its position when the WHERE clause is exactly a range of its keys
+	 * @param answer - filled with the selected records
+	 * @param isOrdered - set to True if the answer already comes in the ORDER BY order, the offset is skipped then
+	 * @return True if the query was answered from an index, false otherwise
+	*/
+	bool selectFromIndexOnly(Query& query, const string& orderByWhat, const vector<string>& selectedCols, bool isDescending, size_t limit,
+		size_t offset, vector<Record>& answer, bool& isOrdered)
+	{
+		vector<string> required = selectedCols;
+		for (pair<const string, InternalQuery>& entry : query.getNumberedQueries())
+			required.push_back(entry.second.getColumn());
+
+		vector<string> orderColumns = splitColumnList(orderByWhat);
+		required.insert(required.end(), orderColumns.begin(), orderColumns.end());
+		for (const string& column : required)
+			if (colIndex.find(column) == colIndex.end())
+				return false;
+
+		vector<string> conditions;
+		bool isConjunctive = getConjunctiveConditions(query, conditions);
+
+		// Pick the covering index whose keys the WHERE clause narrows down, the first covering one otherwise
+		bool coveredByPrimary = primaryIndexType == IndexType::BPTREE && !primaryKey.empty();
+		for (const string& column : required)
+			coveredByPrimary = coveredByPrimary && column == primaryKey;
+
+		SecondaryIndex* covering = nullptr;
+		KeyRange range;
+		bool isBounded = coveredByPrimary && isConjunctive && getKeyRange({ primaryKey }, false, query, conditions, range);
+		for (size_t i = 0; i < secondaryIndexes.size() && !isBounded; i++)
+		{
+			SecondaryIndex& index = secondaryIndexes[i];
+			bool covers = true;
+			for (const string& column : required)
+				covers = covers && index.covers(column);
+
+			if (!covers)
+				continue;
+
+			KeyRange indexRange;
+			if (isConjunctive && getKeyRange(index.getColumns(), index.isComposite(), query, conditions, indexRange))
+			{
+				covering = &index;
+				range = indexRange;
+				isBounded = true;
+			}
+			else if (!coveredByPrimary && covering == nullptr)
+			{
+				covering = &index;
+			}
+		}
+
+		if (!coveredByPrimary && covering == nullptr)
+			return false;
+
+		// An unbounded index scan reads every entry, a lookup in another index is cheaper then
+		if (!isBounded && isConjunctive)
+			for (const string& id : conditions)
+				if (hasIndexOn(query.getNumberedQueries().at(id).getColumn()))
+					return false;
+
+		vector<string> keyColumns = covering == nullptr ? vector<string>{ primaryKey } : covering->getColumns();
+		isOrdered = !orderColumns.empty() && orderColumns.size() <= keyColumns.size()
+			&& std::equal(orderColumns.begin(), orderColumns.end(), keyColumns.begin());
+
+		// An answer in the ORDER BY order (or without one) is complete once it has the limit, the scan stops there.
+		// Without ORDER BY the offset is skipped by select, so the scan reads that many more
+		bool canStop = orderColumns.empty() || isOrdered;
+		bool isReverse = isOrdered && isDescending;
+		bool hasQuery = !query.getShuntingOutput().empty();
+		size_t skip = isOrdered ? offset : 0;
+		if (!isOrdered)
+			limit = limit > SIZE_MAX - offset ? SIZE_MAX : limit + offset;
+
+		auto emit = [&](vector<TypeWrapper>& values)
+		{
+			Record r(numOfColumns);
+			for (TypeWrapper& value : values)
+				r.addValue(value);
+
+			if (hasQuery && !query.checkRecordAgainstQuery(r, colIndex))
+				return true;
+
+			if (skip > 0)
+				skip--;
+			else
+				answer.push_back(std::move(r));
+
+			return !canStop || answer.size() < limit;
+		};
+
+		if (covering == nullptr)
+		{
+			if (skip > 0 && !seekOffset(query, isReverse, skip, range))
+				return true;
+
+			size_t keyPos = colIndex[primaryKey];
+			auto visit = [&](const data& entry)
+			{
+				vector<TypeWrapper> values(numOfColumns);
+				values[keyPos] = entry.first;
+				return emit(values);
+			};
+
+			BPTree::Snapshot snapshot = indexedColumnRecords.getSnapshot();
+			if (isReverse)
+				snapshot.forEachInRangeReverse(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive, visit);
+			else
+				snapshot.forEachInRange(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive,
+					[&](const data& entry) { visit(entry); });
+		}
+		else
+		{
+			const vector<string>& includeColumns = covering->getIncludeColumns();
+			auto visit = [&](const TypeWrapper& key, const RecordPtr&, const Record& included)
+			{
+				vector<TypeWrapper> values(numOfColumns);
+				if (covering->isComposite())
+					for (size_t i = 0; i < keyColumns.size(); i++)
+						values[colIndex[keyColumns[i]]] = key.getPart(i);
+				else
+					values[colIndex[keyColumns[0]]] = key;
+
+				for (size_t i = 0; i < includeColumns.size(); i++)
+					values[colIndex[includeColumns[i]]] = included.get(i);
+
+				return emit(values);
+			};
+
+			if (isReverse)
+				covering->forEachInRangeReverse(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive, visit);
+			else
+				covering->forEachInRange(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive,
+					[&](const TypeWrapper& key, const RecordPtr& ptr, const Record& included) { visit(key, ptr, included); });
+		}
+
+		return true;
+	}
+
+	/**
+	 * @param colName - name of a column
+	 * @return whether conditions on the column can be looked up in an index
+	*/
+	bool hasIndexOn(const string& colName)
+	{
+		if (colName == primaryKey)
+			return true;
+
+		for (const SecondaryIndex& index : secondaryIndexes)
+			if (index.getColumns()[0] == colName)
+				return true;
+
+		return false;
+	}
+
+	/**
+	 * @brief Read the records in the key order of an index whose leading columns are the ORDER BY columns,
+	 * so the answer comes out sorted without sorting it. With a WHERE clause this is done only if its conditions are
+	 * joined with AND, are all on the columns of that index and bound its keys (i.e. WHERE id < 100 ORDER BY id),
+	 * the records in the range are checked against the whole clause. The pages are loaded in growing chunks until the answer has the limit,
+	 * and the primary key's B+ tree is read backwards only as far as those chunks need
+	 * @param query - WHERE clause
+	 * @param orderByWhat - columns to order by, separated by commas
+	 * @param isDescending - if True the index is read from its greatest key down
+	 * @param limit - the most records to read
+	 * @param offset - the number of records skipped before the ones read. When the WHERE clause is exactly a range of the index's keys,
+	 * they are skipped without loading their pages: the primary key's tree seeks the first record by its position,
+	 * an ART or a secondary index drops the first pointers of the range
+	 * @param answer - filled with the records in the requested order
+	 * @return True if there is such an index, false if the records have to be sorted
+	*/
+	bool selectInIndexOrder(Query& query, const string& orderByWhat, bool isDescending, size_t limit, size_t offset, vector<Record>& answer)
+	{
+		vector<string> columns = splitColumnList(orderByWhat);
+		if (columns.empty())
+			return false;
+
+		bool hasQuery = !query.getShuntingOutput().empty();
+		vector<string> conditions;
+		if (hasQuery && !getConjunctiveConditions(query, conditions))
+			return false;
+
+		// A condition on another column may have an index of its own that narrows the query down better
+		auto isBoundedBy = [&](const vector<string>& indexed, bool isComposite, KeyRange& range)
+		{
+			for (const string& id : conditions)
+				if (std::find(indexed.begin(), indexed.end(), query.getNumberedQueries().at(id).getColumn()) == indexed.end())
+					return false;
+
+			return getKeyRange(indexed, isComposite, query, conditions, range);
+		};
+
+		// Every chunk is twice the previous one, the first one is the limit and the records still to skip
+		size_t skip = offset;
+		size_t chunk = 0;
+		auto nextChunk = [&]()
+		{
+			size_t size = chunk != 0 ? chunk : std::max<size_t>(limit > SIZE_MAX - skip ? SIZE_MAX : limit + skip, 1);
+			chunk = size > SIZE_MAX / 2 ? SIZE_MAX : size * 2;
+			return size;
+		};
+
+		auto fetchChunk = [&](const vector<RecordPtr>& ptrs)
+		{
+			for (Record& r : fetchRecordsInOrder(ptrs))
+			{
+				if (answer.size() >= limit || (hasQuery && !query.checkRecordAgainstQuery(r, colIndex)))
+					continue;
+
+				if (skip > 0)
+					skip--;
+				else
+					answer.push_back(std::move(r));
+			}
+		};
+
+		auto fetchInChunks = [&](const vector<RecordPtr>& ptrs)
+		{
+			for (size_t start = 0; start < ptrs.size() && answer.size() < limit;)
+			{
+				size_t end = start + std::min(nextChunk(), ptrs.size() - start);
+				fetchChunk(start == 0 && end == ptrs.size() ? ptrs : vector<RecordPtr>(ptrs.begin() + start, ptrs.begin() + end));
+				start = end;
+			}
+		};
+
+		KeyRange range;
+		if (columns.size() == 1 && columns[0] == primaryKey && primaryIndexType == IndexType::BPTREE)
+		{
+			if (hasQuery && !isBoundedBy({ primaryKey }, false, range))
+				return false;
+
+			if (skip > 0 && !seekOffset(query, isDescending, skip, range))
+				return true;
+
+			BPTree::Snapshot snapshot = indexedColumnRecords.getSnapshot();
+			if (!isDescending)
+			{
+				fetchInChunks(snapshot.getRecordPtrsInRange(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive));
+				return true;
+			}
+
+			// The keys are unique, so the next chunk is read from below the last key of the previous one
+			const TypeWrapper* upper = range.getUpper();
+			bool upperInclusive = range.fUpperInclusive;
+			TypeWrapper resumeBefore;
+			while (answer.size() < limit)
+			{
+				size_t size = nextChunk();
+				vector<RecordPtr> ptrs;
+				snapshot.forEachInRangeReverse(range.getLower(), range.fLowerInclusive, upper, upperInclusive, [&](const data& entry)
+					{
+						ptrs.push_back(entry.second);
+						resumeBefore = entry.first;
+						return ptrs.size() < size;
+					});
+
+				fetchChunk(ptrs);
+				if (ptrs.size() < size)
+					break;
+
+				upper = &resumeBefore;
+				upperInclusive = false;
+			}
+
+			return true;
+		}
+
+		if (columns.size() == 1 && columns[0] == primaryKey && primaryIndexType == IndexType::ART)
+		{
+			if (hasQuery && !isBoundedBy({ primaryKey }, false, range))
+				return false;
+
+			// Every record of an exact range is in the answer, so only the pointers up to the limit are read and the skipped ones are dropped
+			KeyRange exact;
+			bool isExact = !hasQuery || getExactKeyRange(primaryKey, query, conditions, exact);
+			size_t toRead = !isExact ? SIZE_MAX : (limit > SIZE_MAX - skip ? SIZE_MAX : limit + skip);
+			vector<RecordPtr> ptrs = isDescending
+				? radixColumnRecords.getRecordPtrsInRangeReverse(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive, toRead)
+				: radixColumnRecords.getRecordPtrsInRange(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive, toRead);
+
+			if (isExact)
+			{
+				ptrs.erase(ptrs.begin(), ptrs.begin() + std::min(skip, ptrs.size()));
+				skip = 0;
+			}
+
+			fetchInChunks(ptrs);
+			return true;
+		}
+
+		for (SecondaryIndex& index : secondaryIndexes)
+		{
+			const vector<string>& indexed = index.getColumns();
+			if (columns.size() > indexed.size() || !std::equal(columns.begin(), columns.end(), indexed.begin()))
+				continue;
+
+			if (hasQuery && !isBoundedBy(indexed, index.isComposite(), range))
+				return false;
+
+			// A key may have many records, so the pointers of the whole range are read before the chunks are loaded
+			vector<RecordPtr> ptrs = isDescending
+				? index.getRecordPtrsInRangeReverse(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive,
+					hasQuery ? SIZE_MAX : (limit > SIZE_MAX - skip ? SIZE_MAX : limit + skip))
+				: index.getRecordPtrsInRange(range.getLower(), range.fLowerInclusive, range.getUpper(), range.fUpperInclusive);
+
+			// Every record of an exact range is in the answer, so the skipped ones are never loaded
+			KeyRange exact;
+			if (!hasQuery || (!index.isComposite() && getExactKeyRange(indexed[0], query, conditions, exact)))
+			{
+				ptrs.erase(ptrs.begin(), ptrs.begin() + std::min(skip, ptrs.size()));
+				skip = 0;
+			}
+
+			fetchInChunks(ptrs);
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * @brief Look up the records having a given value of a column in the index of that column
+	 * @param colName - name of the column
+	 * @param key - value of the column
+	 * @param ptrs - filled with the pointers to the records having that value
+	 * @return True if the column is the primary key or the leading column of a secondary index, false if it would need a scan
+	*/
+	bool getKeyRecordPtrs(const string& colName, const TypeWrapper& key, vector<RecordPtr>& ptrs)
+	{
+		ptrs.clear();
+		if (colName == primaryKey)
+		{
+			RecordPtr ptr;
+			if (primaryIndexType == IndexType::HASH)
+			{
+				if (hashedColumnRecords.find(key, ptr))
+					ptrs.push_back(ptr);
+			}
+			else if (primaryIndexType == IndexType::ART)
+			{
+				if (radixColumnRecords.find(key, ptr))
+					ptrs.push_back(ptr);
+			}
+			else if (indexedColumnRecords.find(key, ptr))
+				ptrs.push_back(ptr);
+
+			return true;
+		}
+
+		for (SecondaryIndex& index : secondaryIndexes)
+		{
+			if (index.getColumns()[0] != colName)
+				continue;
+
+			// The keys of a composite index starting with the value are bounded by the one part prefix
+			if (!index.isComposite())
+				ptrs = index.getRecordPtrs(Operator::EQUAL, key);
+			else
+			{
+				TypeWrapper prefix(vector<TypeWrapper>{ key });
+				ptrs = index.getRecordPtrsInRange(&prefix, true, &prefix, true);
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * @brief Get the pointers of the next records in the ascending order of a column, read from an ordered index of that column.
+	 * Reading resumes after the last key of the previous call, so the records are walked in batches and never all held at once.
+	 * The records of a key aren't split between two batches, so a key shared by many records may make a batch bigger than limit
+	 * @param colName - name of the column
+	 * @param after - the last key of the previous batch, nullptr for the first batch
+	 * @param limit - keys are read until the batch has this many pointers
+	 * @param ptrs - filled with the pointers of the batch, empty once all records were read
+	 * @param last - set to the last key of the batch, to be passed as after for the next one
+	 * @return True if the column is the primary key indexed by a B+ tree or an ART, or the leading column of a secondary index, false otherwise
+	*/
+	bool getRecordPtrsAfterKey(const string& colName, const TypeWrapper* after, size_t limit, vector<RecordPtr>& ptrs, TypeWrapper& last)
+	{
+		ptrs.clear();
+		if (colName == primaryKey && primaryIndexType == IndexType::BPTREE)
+		{
+			// The keys are unique, so the batch ends at the key {limit} positions on, found by the subtree counts
+			data end;
+			bool isFull = indexedColumnRecords.getNthInRange(after, false, nullptr, false, limit - 1, false, end);
+			indexedColumnRecords.forEachInRange(after, false, isFull ? &end.first : nullptr, true, [&](const data& entry)
+				{
+					ptrs.push_back(entry.second);
+					last = entry.first;
+				});
+
+			return true;
+		}
+
+		if (colName == primaryKey && primaryIndexType == IndexType::ART)
+		{
+			radixColumnRecords.forEachInRange(after, false, nullptr, false, [&](const TypeWrapper& key, const RecordPtr& ptr)
+				{
+					ptrs.push_back(ptr);
+					last = key;
+					return ptrs.size() < limit;
+				});
+
+			return true;
+		}
+
+		for (SecondaryIndex& index : secondaryIndexes)
+		{
+			if (index.getColumns()[0] == colName)
+			{
+				index.getRecordPtrsAfterKey(after, limit, ptrs, last);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * @param colName - name of a column
+	 * @return whether the records can be read in the order of the column from an index, see getRecordPtrsAfterKey
+	*/
+	bool hasOrderedIndexOn(const string& colName) const
+	{
+		if (colName == primaryKey)
+			return primaryIndexType != IndexType::HASH;
+
+		for (const SecondaryIndex& index : secondaryIndexes)
+			if (index.getColumns()[0] == colName)
+				return true;
+
+		return false;
+	}
+
+	/**
+	 * @brief Full table scan. The pages are split between a pool of workers, each worker loads its pages
+	 * and filters their records, after which the per-page results are merged in page order
+	 * @param predicate - condition that a valid record has to satisfy to be part of the result
+	 * @return the records satisfying the predicate, in the order they are stored in the table
+	*/
+	vector<Record> scanPages(const std::function<bool(const Record&)>& predicate)
+	{
+		size_t pagesCount = curPageIndex + 1;
+		vector<vector<Record>> perPage(pagesCount);
+
+		ph::parallelFor(pagesCount, [&](size_t index)
+			{
+				Page p = loadPage(index);
+				for (size_t i = 0; i < p.size(); ++i)
+				{
+					const Record& r = p.at(i);
+					if (!r.isInvalid() && predicate(r))
+						perPage[index].push_back(r);
+				}
+			});
+
+		return mergePages(perPage);
+	}
+
+	/**
+	 * @brief Streaming scan: every record satisfying the query is handed to visit as soon as its page is read, nothing is collected.
+	 * The candidates come from the most selective index when the planner finds one, otherwise every page is read.
+	 * Pages are split between a pool of workers
+	 * @param query - WHERE clause, may be empty
+	 * @param prepare - called once before the scan with the number of workers
+	 * @param visit - called with every matching record and the number of the worker that read it (below the number of workers)
+	*/
+	void scanMatching(Query& query, const std::function<void(size_t)>& prepare, const std::function<void(const Record&, size_t)>& visit)
+	{
+		bool hasQuery = !query.getShuntingOutput().empty();
+		vector<RecordPtr> candidates;
+		bool fromIndex = hasQuery && getMostSelectiveCandidates(query, candidates);
+
+		vector<int> touchedPages;
+		vector<vector<int>> byPage;
+		if (fromIndex)
+		{
+			byPage = groupByPage(candidates);
+			for (size_t index = 0; index < byPage.size(); index++)
+				if (!byPage[index].empty())
+					touchedPages.push_back(index);
+		}
+		else
+		{
+			for (int index = 0; index <= curPageIndex; index++)
+				touchedPages.push_back(index);
+		}
+
+		size_t workers = ph::getWorkersCount(touchedPages.size());
+		prepare(workers > 0 ? workers : 1);
+		ph::parallelForWithWorker(touchedPages.size(), [&](size_t task, size_t worker)
+			{
+				int index = touchedPages[task];
+				Page p = loadPage(index);
+				auto visitIfMatching = [&](size_t i)
+				{
+					const Record& r = p.at(i);
+					if (!r.isInvalid() && (!hasQuery || query.checkRecordAgainstQuery(r, colIndex)))
+						visit(r, worker);
+				};
+
+				if (fromIndex)
+					for (int i : byPage[index])
+						visitIfMatching(i);
+				else
+					for (size_t i = 0; i < p.size(); i++)
+						visitIfMatching(i);
+			});
+	}
+
+	/**
+	 * @brief Aggregate query with hash GROUP BY. The records satisfying the query are streamed from the scan into a hash table
+	 * from the values of the GROUP BY columns to the states of the aggregates. Every worker of the scan fills its own table,
+	 * the partial tables are merged at the end. Without GROUP BY all records form a single group
+	 * @param query - WHERE clause, may be empty
+	 * @param groupBy - GROUP BY columns
+	 * @param aggregates - aggregate functions to compute for every group
+	 * @return one record per group: the values of the GROUP BY columns followed by the values of the aggregates
+	*/
+	vector<Record> aggregate(Query& query, const vector<string>& groupBy, const vector<Aggregate>& aggregates)
+	{
+		vector<size_t> groupPos;
+		for (const string& column : groupBy)
+		{
+			if (colIndex.find(column) == colIndex.end())
+				throw invalid_argument("Cannot group by a column that is not part of the scheme. (" + column + ")");
+
+			groupPos.push_back(colIndex[column]);
+		}
+
+		vector<size_t> aggregatePos;
+		for (const Aggregate& aggregate : aggregates)
+		{
+			if (aggregate.isCountAll())
+			{
+				aggregatePos.push_back(0);
+				continue;
+			}
+
+			if (colIndex.find(aggregate.getColumn()) == colIndex.end())
+				throw invalid_argument("Cannot aggregate a column that is not part of the scheme. (" + aggregate.getColumn() + ")");
+
+			bool isNumeric = colTypes.at(aggregate.getColumn()) != "String";
+			if (!isNumeric && (aggregate.getFunction() == AggregateFunction::SUM || aggregate.getFunction() == AggregateFunction::AVG))
+				throw invalid_argument("Cannot compute " + aggregate.getName() + " of a String column");
+
+			aggregatePos.push_back(colIndex[aggregate.getColumn()]);
+		}
+
+		Record fromIndex(aggregates.size());
+		if (groupBy.empty() && aggregateFromIndex(query, aggregates, fromIndex))
+			return { fromIndex };
+
+		typedef unordered_map<vector<TypeWrapper>, vector<AggregateState>, GroupKeyHash, GroupKeyEqual> Groups;
+		vector<Groups> partials;
+		scanMatching(query, [&](size_t workers) { partials.resize(workers); }, [&](const Record& r, size_t worker)
+			{
+				vector<TypeWrapper> key;
+				key.reserve(groupPos.size());
+				for (size_t pos : groupPos)
+					key.push_back(r.get(pos));
+
+				vector<AggregateState>& states = partials[worker][key];
+				states.resize(aggregates.size());
+				for (size_t i = 0; i < aggregates.size(); i++)
+				{
+					if (aggregates[i].isCountAll())
+						states[i].addRecord();
+					else
+						states[i].add(r.get(aggregatePos[i]), aggregates[i].getFunction() == AggregateFunction::PERCENTILE);
+				}
+			});
+
+		Groups& groups = partials[0];
+		for (size_t worker = 1; worker < partials.size(); worker++)
+		{
+			for (pair<const vector<TypeWrapper>, vector<AggregateState>>& entry : partials[worker])
+			{
+				vector<AggregateState>& states = groups[entry.first];
+				states.resize(aggregates.size());
+				for (size_t i = 0; i < aggregates.size(); i++)
+					states[i].merge(entry.second[i]);
+			}
+		}
+
+		// An aggregate over no records still has a value (i.e. COUNT(*) is 0), unless the records are grouped
+		if (groupBy.empty() && groups.empty())
+			groups[vector<TypeWrapper>()].resize(aggregates.size());
+
+		vector<Record> answer;
+		answer.reserve(groups.size());
+		for (pair<const vector<TypeWrapper>, vector<AggregateState>>& entry : groups)
+		{
+			Record r(groupBy.size() + aggregates.size());
+			for (const TypeWrapper& value : entry.first)
+				r.addValue(value);
+
+			for (size_t i = 0; i < aggregates.size(); i++)
+				r.addValue(entry.second[i].result(aggregates[i], aggregates[i].isCountAll() ? "" : colTypes.at(aggregates[i].getColumn())));
+
+			answer.push_back(std::move(r));
+		}
+
+		return answer;
+	}
+
+	/**
+	 * @brief Answer an aggregate query without GROUP BY from a B+ tree index alone, no page is loaded.
+	 * Possible when every aggregate is COUNT(*), MIN, MAX or PERCENTILE of the indexed column and the WHERE clause,
+	 * if any, is a range on that column: MIN and MAX are the first and the last key of the range, COUNT(*)
+	 * is the number of keys in it and a PERCENTILE is the key at its position in the range - all found in O(log n)
+	 * with the subtree counts of the primary key's tree. A secondary index adds up the lengths of the posting lists
+	 * of the keys in the range instead
+	 * @param query - WHERE clause, may be empty
+	 * @param aggregates - aggregate functions to compute
+	 * @param answer - filled with the values of the aggregates
+	 * @return True if the aggregates were computed from an index, false if the records have to be scanned
+	*/
+	bool aggregateFromIndex(Query& query, const vector<Aggregate>& aggregates, Record& answer)
+	{
+		vector<string> conditions;
+		if (!getConjunctiveConditions(query, conditions))
+			return false;
+
+		// The index has to be on the column of the conditions and of the MIN/MAX aggregates
+		string column = conditions.empty() ? "" : query.getNumberedQueries().at(conditions[0]).getColumn();
+		for (const Aggregate& aggregate : aggregates)
+		{
+			if (aggregate.isCountAll())
+				continue;
+
+			AggregateFunction function = aggregate.getFunction();
+			bool isOrderStatistic = function == AggregateFunction::MIN || function == AggregateFunction::MAX || function == AggregateFunction::PERCENTILE;
+			if (!isOrderStatistic || (!column.empty() && aggregate.getColumn() != column))
+				return false;
+
+			column = aggregate.getColumn();
+		}
+
+		bool onPrimary = primaryIndexType == IndexType::BPTREE && !primaryKey.empty() && (column.empty() || column == primaryKey);
+		SecondaryIndex* index = nullptr;
+		if (!onPrimary && !column.empty())
+			index = findSecondaryIndex(column);
+		else if (!onPrimary && !secondaryIndexes.empty())
+			index = &secondaryIndexes[0];
+
+		if (!onPrimary && index == nullptr)
+			return false;
+
+		if (column.empty())
+			column = onPrimary ? primaryKey : index->getColumn();
+
+		KeyRange range;
+		if (!getExactKeyRange(column, query, conditions, range))
+			return false;
+
+		const TypeWrapper* lower = range.getLower();
+		const TypeWrapper* upper = range.getUpper();
+		for (const Aggregate& aggregate : aggregates)
+		{
+			if (aggregate.isCountAll())
+			{
+				size_t count = onPrimary ? indexedColumnRecords.countInRange(lower, range.fLowerInclusive, upper, range.fUpperInclusive)
+					: index->countInRange(lower, range.fLowerInclusive, upper, range.fUpperInclusive);
+				answer.addValue(TypeWrapper((int)count));
+				continue;
+			}
+
+			TypeWrapper key;
+			if (aggregate.getFunction() == AggregateFunction::PERCENTILE)
+			{
+				size_t count = onPrimary ? indexedColumnRecords.countInRange(lower, range.fLowerInclusive, upper, range.fUpperInclusive)
+					: index->countInRange(lower, range.fLowerInclusive, upper, range.fUpperInclusive);
+				if (count > 0 && onPrimary)
+				{
+					data entry;
+					if (indexedColumnRecords.getNthInRange(lower, range.fLowerInclusive, upper, range.fUpperInclusive, aggregate.getPercentilePosition(count), false, entry))
+						key = entry.first;
+				}
+				else if (count > 0)
+				{
+					index->getKeyAtPosition(lower, range.fLowerInclusive, upper, range.fUpperInclusive, aggregate.getPercentilePosition(count), key);
+				}
+
+				answer.addValue(key);
+				continue;
+			}
+
+			bool last = aggregate.getFunction() == AggregateFunction::MAX;
+			if (onPrimary)
+			{
+				data entry;
+				if (last ? indexedColumnRecords.getLastInRange(lower, range.fLowerInclusive, upper, range.fUpperInclusive, entry)
+					: indexedColumnRecords.getFirstInRange(lower, range.fLowerInclusive, upper, range.fUpperInclusive, entry))
+					key = entry.first;
+			}
+			else
+			{
+				index->getBoundaryKey(lower, range.fLowerInclusive, upper, range.fUpperInclusive, last, key);
+			}
+
+			answer.addValue(key);
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Like getKeyRange for a single column, but only succeeds if the range is exactly what the WHERE clause selects:
+	 * every condition is on the column, of the column's type and either a single equality or at most one lower and one upper bound
+	 * @param column - the indexed column
+	 * @param query - WHERE clause
+	 * @param conditions - ids of the clause's conditions, all joined with AND
+	 * @param range - filled with the bounds of the keys satisfying the conditions, unbounded if there are no conditions
+	 * @return True if the conditions are exactly the range, false otherwise
+	*/
+	bool getExactKeyRange(const string& column, Query& query, const vector<string>& conditions, KeyRange& range)
+	{
+		bool hasEquality = false;
+		for (const string& id : conditions)
+		{
+			InternalQuery& condition = query.getNumberedQueries().at(id);
+			if (condition.getColumn() != column || !checkType(condition.getValue(), colTypes.at(column)))
+				return false;
+
+			Operator op = condition.getOperator();
+			if (op == Operator::EQUAL && !range.isBounded())
+			{
+				range.setLower(condition.getValue(), true);
+				range.setUpper(condition.getValue(), true);
+				hasEquality = true;
+			}
+			else if ((op == Operator::GREATER_THAN || op == Operator::GREATER_THAN_OR_EQUAL) && !range.fHasLower)
+				range.setLower(condition.getValue(), op == Operator::GREATER_THAN_OR_EQUAL);
+			else if ((op == Operator::LESS_THAN || op == Operator::LESS_THAN_OR_EQUAL) && !range.fHasUpper)
+				range.setUpper(condition.getValue(), op == Operator::LESS_THAN_OR_EQUAL);
+			else
+				return false;
+
+			if (hasEquality && conditions.size() > 1)
+				return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Skip the first records of an answer read in the primary key's order by seeking the first returned key by its position
+	 * in O(log n), see BPTree::getNthInRange. Done only if the WHERE clause is exactly a range of the keys, a looser range may hold
+	 * records the clause drops, which are skipped one by one after they are checked. The position is found in the live tree,
+	 * so records inserted or removed meanwhile may shift the returned ones like they would between two separate selects
+	 * @param query - WHERE clause, may be empty
+	 * @param isReverse - if True the records are read from the greatest key down
+	 * @param offset - the number of records to skip, set to 0 if they were skipped
+	 * @param range - the range of the keys to read, narrowed to begin at the first returned key
+	 * @return False if the range holds no more than offset records, so nothing is returned, True otherwise
+	*/
+	bool seekOffset(Query& query, bool isReverse, size_t& offset, KeyRange& range)
+	{
+		vector<string> conditions;
+		KeyRange exact;
+		if (!query.getShuntingOutput().empty()
+			&& !(getConjunctiveConditions(query, conditions) && getExactKeyRange(primaryKey, query, conditions, exact)))
+			return true;
+
+		data entry;
+		if (!indexedColumnRecords.getNthInRange(exact.getLower(), exact.fLowerInclusive, exact.getUpper(), exact.fUpperInclusive, offset, isReverse, entry))
+			return false;
+
+		if (isReverse)
+			exact.setUpper(entry.first, true);
+		else
+			exact.setLower(entry.first, true);
+
+		range = exact;
+		offset = 0;
+		return true;
+	}
+
+	/**
+	 * @param recordReference - a tuple holding info about the index of the page that contains the record, and the record's id in the page
+	 * @return record in the specified reference.
+	 */
+	Record fetchRecordByReference(RecordPtr& recordReference)
+	{
+		Page p = loadPage(recordReference.getPage());
+		return p.get(recordReference.getIndexInPage());
+	}
+
+	/**
+	 * @brief Given vector of pointers to records, fetch them all
+	 * @param recordsReferences - vector of record pointers
+	 * @return the records pointed to by record pointers
+	*/
+	vector<Record> fetchRecordsByReference(vector<RecordPtr>& recordsReferences)
+	{
+		// Bucket the refs by page, then load every touched page once (pages are independent, so they are
+		// loaded by a pool of workers) and copy each pointed record out of it a single time
+		vector<vector<int>> byPage = groupByPage(recordsReferences);
+		vector<int> touchedPages;
+		for (size_t index = 0; index < byPage.size(); index++)
+			if (!byPage[index].empty())
+				touchedPages.push_back(index);
+
+		vector<vector<Record>> perPage(touchedPages.size());
+		ph::parallelFor(touchedPages.size(), [&](size_t task)
+			{
+				int index = touchedPages[task];
+				Page p = loadPage(index);
+				perPage[task].reserve(byPage[index].size());
+				for (int i : byPage[index])
+				{
+					const Record& r = p.at(i);
+					if (!r.isInvalid())
+						perPage[task].push_back(r);
+				}
+			});
+
+		return mergePages(perPage);
+	}
+
+	/**
+	 * @brief Like fetchRecordsByReference, but the records are returned in the order of the pointers
+	 * (i.e. index key order) instead of page order. Every touched page is still loaded only once
+	 * @param recordsReferences - vector of record pointers
+	 * @return the records pointed to by record pointers, in the same order
+	*/
+	vector<Record> fetchRecordsInOrder(const vector<RecordPtr>& recordsReferences)
+	{
+		vector<vector<size_t>> positionsByPage(curPageIndex + 1);
+		for (size_t pos = 0; pos < recordsReferences.size(); pos++)
+		{
+			int page = recordsReferences[pos].getPage();
+			if (page >= 0 && page <= curPageIndex)
+				positionsByPage[page].push_back(pos);
+		}
+
+		vector<int> touchedPages;
+		for (size_t index = 0; index < positionsByPage.size(); index++)
+			if (!positionsByPage[index].empty())
+				touchedPages.push_back(index);
+
+		// Every position is written by the single worker owning its page
+		vector<Record> fetched(recordsReferences.size());
+		vector<char> isFetched(recordsReferences.size(), 0);
+		ph::parallelFor(touchedPages.size(), [&](size_t task)
+			{
+				int index = touchedPages[task];
+				Page p = loadPage(index);
+				for (size_t pos : positionsByPage[index])
+				{
+					const Record& r = p.at(recordsReferences[pos].getIndexInPage());
+					if (r.isInvalid())
+						continue;
+
+					fetched[pos] = r;
+					isFetched[pos] = 1;
+				}
+			});
+
+		vector<Record> answer;
+		answer.reserve(fetched.size());
+		for (size_t pos = 0; pos < fetched.size(); pos++)
+			if (isFetched[pos])
+				answer.push_back(std::move(fetched[pos]));
+
+		return answer;
+	}
+
+	/**
+	 * @brief Deletes all the records satisfying the where criteria
+	 * @param query - query containing the where conditions
+	 * @return the number of deleted records in the table
+	*/
+	int deleteRecord(Query& query)
+	{
+		int deletedRecords = 0;
+		if (!query.getShuntingOutput().empty())
+		{
+			// Find the records that may match: the most selective index gives them directly, a table with a primary key
+			// maps the selected records to their pointers, otherwise every record of every page is checked
+			vector<RecordPtr> candidates;
+			bool fromIndex = getMostSelectiveCandidates(query, candidates);
+			if (!fromIndex && !primaryKey.empty())
+			{
+				vector<Record> answer = select(query);
+				candidates.reserve(answer.size());
+				for (const Record& r : answer)
+					if (!r.isInvalid())
+						candidates.push_back(findPrimary(r.get(colIndex[primaryKey])));
+
+				fromIndex = true;
+			}
+
+			vector<int> touchedPages;
+			vector<vector<int>> byPage;
+			if (fromIndex)
+			{
+				byPage = groupByPage(candidates);
+				for (size_t index = 0; index < byPage.size(); index++)
+					if (!byPage[index].empty())
+						touchedPages.push_back(index);
+			}
+			else
+			{
+				for (int index = 0; index <= curPageIndex; index++)
+					touchedPages.push_back(index);
+			}
+
+			// Every touched page is handled by one worker: all matches are marked in memory and the page is written once
+			vector<vector<pair<Record, RecordPtr>>> removedPerPage(touchedPages.size());
+			ph::parallelFor(touchedPages.size(), [&](size_t task)
+				{
+					int index = touchedPages[task];
+					Page page = loadPage(index);
+					auto removeIfMatching = [&](size_t i)
+					{
+						const Record& r = page.at(i);
+						if (r.isInvalid() || !query.checkRecordAgainstQuery(r, colIndex))
+							return;
+
+						removedPerPage[task].push_back({ r, RecordPtr(index, i) });
+						page.removeRecord(i);
+					};
+
+					if (fromIndex)
+						for (int i : byPage[index])
+							removeIfMatching(i);
+					else
+						for (size_t i = 0; i < page.size(); i++)
+							removeIfMatching(i);
+
+					if (!removedPerPage[task].empty())
+						savePage(index, page);
+				});
+
+			// The removed records are then erased from the indexes in one pass
+			vector<TypeWrapper> removedKeys;
+			for (vector<pair<Record, RecordPtr>>& removed : removedPerPage)
+			{
+				for (pair<Record, RecordPtr>& entry : removed)
+				{
+					logChange(LogRecordType::REMOVE, entry.second, &entry.first, nullptr);
+					bytes -= entry.first.getKiloBytesData();
+					recordsCount--;
+					deletedRecords++;
+
+					if (!primaryKey.empty())
+						removedKeys.push_back(entry.first.get(colIndex[primaryKey]));
+
+					for (SecondaryIndex& secondary : secondaryIndexes)
+						secondary.remove(secondary.makeKey(entry.first, colIndex), entry.second);
+				}
+			}
+
+			if (!primaryKey.empty())
+				removePrimary(removedKeys);
+		}
+
+		return deletedRecords;
+	}
+
+	/**
+	 * @brief Set new values of some columns of all records satisfying the where criteria.
+	 * A record is changed in place - it keeps its position, so its pointers in the indexes stay valid and an index is
+	 * updated only when the record's key (or included values) in it changed. Every touched page is written once.
+	 * A record that no longer fits in the frame of its page (tables kept in a tablespace) is moved to the end of the table instead
+	 * @param query - WHERE clause, an empty one selects all records
+	 * @param values - new value of every updated column
+	 * @return the number of updated records, the changes are logged but not committed
+	*/
+	int update(Query& query, const unordered_map<string, TypeWrapper>& values)
+	{
+		checkColumns(values);
+		checkPrimaryKeyUpdate(query, values);
+
+		vector<pair<size_t, TypeWrapper>> assignments;
+		for (const pair<const string, TypeWrapper>& entry : values)
+			assignments.push_back({ colIndex.at(entry.first), entry.second });
+
+		bool hasQuery = !query.getShuntingOutput().empty();
+		vector<RecordPtr> candidates;
+		bool fromIndex = hasQuery && getMostSelectiveCandidates(query, candidates);
+
+		vector<int> touchedPages;
+		vector<vector<int>> byPage;
+		if (fromIndex)
+		{
+			byPage = groupByPage(candidates);
+			for (size_t index = 0; index < byPage.size(); index++)
+				if (!byPage[index].empty())
+					touchedPages.push_back(index);
+		}
+		else
+		{
+			for (int index = 0; index <= curPageIndex; index++)
+				touchedPages.push_back(index);
+		}
+
+		// Every touched page is handled by one worker, the records are changed in memory and the page is written once
+		size_t frameCapacity = usesTableSpace ? getTableSpace().getFrameSize() - sizeof(size_t) : 0;
+		vector<vector<RecordUpdate>> updatedPerPage(touchedPages.size());
+		vector<vector<RecordUpdate>> movedPerPage(touchedPages.size());
+		ph::parallelFor(touchedPages.size(), [&](size_t task)
+			{
+				int index = touchedPages[task];
+				Page page = loadPage(index);
+				size_t pageBytes = usesTableSpace ? getEncodedSize(page) : 0;
+				auto updateIfMatching = [&](size_t i)
+				{
+					const Record& r = page.at(i);
+					if (r.isInvalid() || (hasQuery && !query.checkRecordAgainstQuery(r, colIndex)))
+						return;
+
+					RecordUpdate change{ r, r, RecordPtr(index, i) };
+					for (const pair<size_t, TypeWrapper>& assignment : assignments)
+						change.fNew.setValue(assignment.first, assignment.second);
+
+					if (usesTableSpace)
+					{
+						size_t oldBytes = getEncodedSize(change.fOld), newBytes = getEncodedSize(change.fNew);
+						if (pageBytes - oldBytes + newBytes > frameCapacity && newBytes > oldBytes)
+						{
+							page.removeRecord(i);
+							pageBytes -= oldBytes - getEncodedSize(page.at(i));
+							movedPerPage[task].push_back(std::move(change));
+							return;
+						}
+
+						pageBytes = pageBytes - oldBytes + newBytes;
+					}
+
+					page.replaceRecord(i, change.fNew);
+					updatedPerPage[task].push_back(std::move(change));
+				};
+
+				if (fromIndex)
+					for (int i : byPage[index])
+						updateIfMatching(i);
+				else
+					for (size_t i = 0; i < page.size(); i++)
+						updateIfMatching(i);
+
+				if (!updatedPerPage[task].empty() || !movedPerPage[task].empty())
+					savePage(index, page);
+			});
+
+		// The indexes are then fixed in one pass, a moved record is appended like a new one and gets new pointers
+		int updatedRecords = 0;
+		for (vector<RecordUpdate>& updated : updatedPerPage)
+		{
+			for (RecordUpdate& change : updated)
+			{
+				logChange(LogRecordType::UPDATE, change.fPtr, &change.fOld, &change.fNew);
+				bytes += (long)change.fNew.getKiloBytesData() - (long)change.fOld.getKiloBytesData();
+				reindex(change.fOld, change.fPtr, change.fNew, change.fPtr);
+				updatedRecords++;
+			}
+		}
+
+		for (vector<RecordUpdate>& moved : movedPerPage)
+		{
+			for (RecordUpdate& change : moved)
+			{
+				logChange(LogRecordType::REMOVE, change.fPtr, &change.fOld, nullptr);
+				bytes -= change.fOld.getKiloBytesData();
+				recordsCount--;
+
+				RecordPtr moved = addRecord(change.fNew);
+				reindex(change.fOld, change.fPtr, change.fNew, moved);
+				updatedRecords++;
+			}
+		}
+
+		return updatedRecords;
+	}
+
+	/**
+	 * @brief Bucket record pointers by the page they point to, in linear time
+	 * @param recordsReferences - vector of record pointers
+	 * @return for every page of the table, the indices in the page of the records pointed to (in the order they were given)
+	*/
+	vector<vector<int>> groupByPage(const vector<RecordPtr>& recordsReferences) const
+	{
+		vector<vector<int>> byPage(curPageIndex + 1);
+		for (const RecordPtr& ref : recordsReferences)
+			if (ref.getPage() >= 0 && ref.getPage() <= curPageIndex)
+				byPage[ref.getPage()].push_back(ref.getIndexInPage());
+
+		return byPage;
+	}
+
+	/**
+	 * @param key - value of the primary key
+	 * @return whether a record with that primary key is in the table, answered by the primary index alone
+	*/
+	bool primaryKeyExists(const TypeWrapper& key)
+	{
+		if (primaryIndexType == IndexType::HASH)
+			return hashedColumnRecords.contains(key);
+		if (primaryIndexType == IndexType::ART)
+			return radixColumnRecords.contains(key);
+
+		return indexedColumnRecords.contains(key);
+	}
+
+	/**
+	 * @param key - value of the primary key, it has to be in the table
+	 * @return the pointer to the record with that primary key
+	*/
+	RecordPtr findPrimary(const TypeWrapper& key)
+	{
+		if (primaryIndexType == IndexType::HASH)
+		{
+			RecordPtr ptr;
+			hashedColumnRecords.find(key, ptr);
+			return ptr;
+		}
+
+		if (primaryIndexType == IndexType::ART)
+		{
+			RecordPtr ptr;
+			radixColumnRecords.find(key, ptr);
+			return ptr;
+		}
+
+		return indexedColumnRecords.getRecordAtIndex(key);
+	}
+
+	void insertPrimary(const TypeWrapper& key, const RecordPtr& ptr)
+	{
+		if (isPrimaryIndexStale)
+			return;
+
+		if (primaryIndexType == IndexType::HASH)
+			hashedColumnRecords.insert(key, ptr);
+		else if (primaryIndexType == IndexType::ART)
+			radixColumnRecords.insert(key, ptr);
+		else
+			indexedColumnRecords.insert({ key, ptr });
+	}
+
+	void removePrimary(const vector<TypeWrapper>& keys)
+	{
+		if (isPrimaryIndexStale)
+			return;
+
+		if (primaryIndexType == IndexType::HASH)
+			hashedColumnRecords.remove(keys);
+		else if (primaryIndexType == IndexType::ART)
+			radixColumnRecords.remove(keys);
+		else
+			indexedColumnRecords.remove(keys);
+	}
+
+	/**
+	 * @brief Deletes the given record from the BPTree if the table has primary key
+	 * @param record - record that is to be deleted from the tree
+	*/
+	void deleteRecord(Record& record)
+	{
+		if (!primaryKey.empty())
+		{
+			int col = colIndex[primaryKey];
+			removePrimary({ record.get(col) });
+		}
+	}
+
+	/**
+	 *	@brief Check that all specified columns are in the table schema and matches the defined types
 	 *	@param htblColNameValue some columns to be checked against the table schema
 	 */
 	void checkColumns(std::unordered_map<string, TypeWrapper> colNameValue)
@@ -617,12 +2191,16 @@ public:
 		}
 	}
 
+	const string& getTableName() const { return tableName; }
+
 	const string& getTableHeader() const { return tableHeader; }
 
 	const string& getTablePath() const { return path; }
 
 	long getBytesData() const { return bytes; }
 
+	size_t getRecordsCount() const { return recordsCount; }
+
 	const unordered_map<string, string>& getTableScheme() const { return colTypes; }
 
 	const unordered_map<string, size_t>& getColIndex() const { return colIndex; }
@@ -631,15 +2209,372 @@ public:
 
 	size_t getColumnsCount() const { return numOfColumns; }
 
+	bool isUsingTableSpace() const { return usesTableSpace; }
+
+	IndexType getPrimaryIndexType() const { return primaryIndexType; }
+
+	const vector<SecondaryIndex>& getSecondaryIndexes() const { return secondaryIndexes; }
+
 private:
+	/**
+	 * @brief Pages changed since the last checkpoint, shared by the copies of the table
+	*/
+	struct DirtyPages
+	{
+		mutex fLock;
+		unordered_map<int, Page> fPages;
+	};
+
 	/**
 	 *	@brief Table instance controls pages that contain the stored records on the hard disk.
 	 *	All read and write operations are done in this class.
 	 */
 	long bytes;
+	size_t recordsCount;
 	int maxRecordsPerPage, curPageIndex, numOfColumns;
 	string path, tableName, tableHeader, primaryKey;
 	unordered_map<string, string> colTypes;
 	unordered_map<string, size_t> colIndex;
 	BPTree indexedColumnRecords;
+	vector<SecondaryIndex> secondaryIndexes;
+	IndexType primaryIndexType;
+	HashIndex hashedColumnRecords;
+	ArtIndex radixColumnRecords;
+	bool usesTableSpace;
+	shared_ptr<TableSpace> tableSpace;
+	unsigned long long checkpointLsn;
+	shared_ptr<WriteAheadLog> wal;
+	shared_ptr<DirtyPages> dirtyPages;
+	shared_ptr<TableSpace> indexSpace;
+	bool isPrimaryIndexStale;
+
+	/**
+	 * @brief Get a page to be changed in place, it is kept in memory until the next checkpoint
+	 * @param index - index of the page
+	 * @return reference to the page in memory
+	*/
+	Page& getDirtyPage(int index)
+	{
+		lock_guard<mutex> lock(dirtyPages->fLock);
+		auto it = dirtyPages->fPages.find(index);
+		if (it == dirtyPages->fPages.end())
+			it = dirtyPages->fPages.insert({ index, readPage(index) }).first;
+
+		return it->second;
+	}
+
+	/**
+	 * @brief Opens the table's log on first use. Copies of the table share the same log
+	*/
+	WriteAheadLog& getLog()
+	{
+		if (!wal)
+		{
+			wal = std::make_shared<WriteAheadLog>(path + tableName + ".wal");
+			if (wal->getLastLsn() < checkpointLsn)
+				wal->setLastLsn(checkpointLsn);
+		}
+
+		return *wal;
+	}
+
+	/**
+	 * @brief Append a change of a record to the log
+	*/
+	void logChange(LogRecordType type, const RecordPtr& ptr, const Record* before, const Record* after)
+	{
+		getLog().append(type, ptr, before, after);
+	}
+
+	/**
+	 * @brief Add a record to the primary and the secondary indexes
+	*/
+	void indexRecord(const Record& record, const RecordPtr& ptr)
+	{
+		if (!primaryKey.empty())
+			insertPrimary(record.get(colIndex.at(primaryKey)), ptr);
+
+		for (SecondaryIndex& index : secondaryIndexes)
+			index.insert(index.makeKey(record, colIndex), ptr, index.makeIncluded(record, colIndex));
+	}
+
+	/**
+	 * @brief Redo the changes logged after the last checkpoint, then make a checkpoint so the log starts empty.
+	 * The pages may already hold some of the changes (a crash in the middle of a checkpoint), so a change is applied to its page
+	 * by setting the record at its position. The indexes and the counters in the metadata hold exactly the state of the checkpoint,
+	 * every logged change is applied to them once. A primary index that has to be rebuilt is built from the pages after the redo
+	*/
+	void recover()
+	{
+		bool hasLog = fs::exists(path + tableName + ".wal") && fs::file_size(path + tableName + ".wal") > 0;
+		if (hasLog)
+			getLog().replay(checkpointLsn, [&](LogRecordType type, const RecordPtr& ptr, const Record& before, const Record& after)
+				{
+					Page& page = getRecoveredPage(ptr.getPage());
+					size_t slot = ptr.getIndexInPage();
+					if (type == LogRecordType::INSERT)
+					{
+						if (slot < page.size())
+							page.replaceRecord(slot, after);
+						else
+							page.addRecord(after);
+
+						bytes += after.getKiloBytesData();
+						recordsCount++;
+						indexRecord(after, ptr);
+					}
+					else if (type == LogRecordType::REMOVE)
+					{
+						if (slot < page.size())
+							page.removeRecord(slot);
+
+						bytes -= before.getKiloBytesData();
+						recordsCount--;
+						if (!primaryKey.empty())
+							removePrimary({ before.get(colIndex.at(primaryKey)) });
+
+						for (SecondaryIndex& index : secondaryIndexes)
+							index.remove(index.makeKey(before, colIndex), ptr);
+					}
+					else
+					{
+						if (slot < page.size())
+							page.replaceRecord(slot, after);
+
+						bytes += (long)after.getKiloBytesData() - (long)before.getKiloBytesData();
+						reindex(before, ptr, after, ptr);
+					}
+				});
+
+		if (isPrimaryIndexStale)
+		{
+			isPrimaryIndexStale = false;
+			createIndex(primaryKey);
+		}
+		else if (hasLog)
+			checkpoint();
+	}
+
+	/**
+	 * @brief Open the primary B+ tree kept in its index file, its nodes are read when needed. A tree that can't be read or doesn't hold exactly the changes
+	 * of the last checkpoint (a crash while it was written) is rebuilt by recover, meanwhile the redo skips it
+	*/
+	void loadPrimaryIndex()
+	{
+		try
+		{
+			unsigned long long indexLsn = 0;
+			indexedColumnRecords = BPTree(getIndexSpace(), indexLsn);
+			isPrimaryIndexStale = indexLsn != checkpointLsn;
+		}
+		catch (const std::exception&)
+		{
+			isPrimaryIndexStale = true;
+		}
+
+		if (isPrimaryIndexStale)
+			indexedColumnRecords = BPTree();
+	}
+
+	/**
+	 * @return whether the primary index is a B+ tree kept in its own index file
+	*/
+	bool hasIndexFile() const
+	{
+		return !primaryKey.empty() && primaryIndexType == IndexType::BPTREE;
+	}
+
+	/**
+	 * @brief Opens the index file of the primary B+ tree on first use
+	*/
+	const shared_ptr<TableSpace>& getIndexSpace()
+	{
+		if (!indexSpace)
+			indexSpace = std::make_shared<TableSpace>(path + tableName + ".idx", INDEX_FRAME_SIZE);
+
+		return indexSpace;
+	}
+
+	/**
+	 * @brief Get a page for redo. Pages created after the last checkpoint may not be on the disk yet, they start empty
+	 * @param index - index of the page
+	 * @return reference to the page in memory
+	*/
+	Page& getRecoveredPage(int index)
+	{
+		if (index > curPageIndex)
+		{
+			for (int created = curPageIndex + 1; created <= index; created++)
+			{
+				Page p(maxRecordsPerPage, getPagePath(created));
+				try
+				{
+					p = readPage(created);
+				}
+				catch (const std::exception&)
+				{
+				}
+
+				savePage(created, p);
+			}
+
+			curPageIndex = index;
+		}
+
+		return getDirtyPage(index);
+	}
+
+	/**
+	 * @brief A record changed by an update: its values before and after the change, and its position before the change
+	*/
+	struct RecordUpdate
+	{
+		Record fOld;
+		Record fNew;
+		RecordPtr fPtr;
+	};
+
+	/**
+	 * @brief Make sure that an update keeps the primary key unique. A new primary key may be given to a single record only,
+	 * and no other record may already have it
+	 * @param query - WHERE clause of the update
+	 * @param values - new value of every updated column
+	*/
+	void checkPrimaryKeyUpdate(Query& query, const unordered_map<string, TypeWrapper>& values)
+	{
+		auto it = values.find(primaryKey);
+		if (primaryKey.empty() || it == values.end())
+			return;
+
+		if (it->second.getContent() == nullptr)
+			throw invalid_argument("Primary key is not allowed to be empty");
+
+		// Only whether a single record matches is needed, so the search stops at the second match
+		Record matched;
+		size_t matches = 0;
+		auto isSecondMatch = [&](const Record& r)
+		{
+			if (!r.isInvalid() && query.checkRecordAgainstQuery(r, colIndex) && ++matches == 1)
+				matched = r;
+
+			return matches > 1;
+		};
+
+		vector<RecordPtr> candidates;
+		if (query.getShuntingOutput().empty())
+		{
+			// Without WHERE all records are updated
+			matches = recordsCount;
+			if (matches == 1)
+				matched = scanPages([](const Record&) { return true; }).front();
+		}
+		else if (getMostSelectiveCandidates(query, candidates))
+		{
+			for (RecordPtr& ptr : candidates)
+				if (isSecondMatch(fetchRecordByReference(ptr)))
+					break;
+		}
+		else
+		{
+			for (int index = 0; index <= curPageIndex && matches < 2; index++)
+			{
+				Page p = loadPage(index);
+				for (size_t i = 0; i < p.size(); i++)
+					if (isSecondMatch(p.at(i)))
+						break;
+			}
+		}
+
+		if (matches > 1)
+			throw invalid_argument("Cannot set primary key " + primaryKey + " of more than one record to the same value");
+
+		if (matches == 1 && primaryKeyExists(it->second) && !(matched.get(colIndex.at(primaryKey)) == it->second))
+			throw invalid_argument("Primary key " + primaryKey + " is already used before");
+	}
+
+	/**
+	 * @brief Bring the indexes up to date with an updated record. An index is changed only if the record's key in it
+	 * (or its included values) changed, or the record was moved
+	 * @param oldRecord - the record before the update
+	 * @param oldPtr - position of the record before the update
+	 * @param newRecord - the record after the update
+	 * @param newPtr - position of the record after the update
+	*/
+	void reindex(const Record& oldRecord, const RecordPtr& oldPtr, const Record& newRecord, const RecordPtr& newPtr)
+	{
+		bool moved = !(oldPtr == newPtr);
+		if (!primaryKey.empty())
+		{
+			const TypeWrapper& oldKey = oldRecord.get(colIndex.at(primaryKey));
+			const TypeWrapper& newKey = newRecord.get(colIndex.at(primaryKey));
+			if (moved || !(oldKey == newKey))
+			{
+				removePrimary({ oldKey });
+				insertPrimary(newKey, newPtr);
+			}
+		}
+
+		for (SecondaryIndex& index : secondaryIndexes)
+		{
+			TypeWrapper oldKey = index.makeKey(oldRecord, colIndex), newKey = index.makeKey(newRecord, colIndex);
+			Record oldIncluded = index.makeIncluded(oldRecord, colIndex), newIncluded = index.makeIncluded(newRecord, colIndex);
+			if (moved || !(oldKey == newKey) || !(oldIncluded == newIncluded))
+			{
+				index.remove(oldKey, oldPtr);
+				index.insert(newKey, newPtr, newIncluded);
+			}
+		}
+	}
+
+	/**
+	 * @return the number of bytes the record or page takes when written to a file
+	*/
+	template<typename T>
+	static size_t getEncodedSize(const T& item)
+	{
+		stringstream buffer;
+		item.write(buffer);
+		return (size_t)buffer.tellp();
+	}
+
+	/**
+	 * @brief Count the valid records of all pages
+	*/
+	size_t countRecords()
+	{
+		std::atomic<size_t> count(0);
+		scanPages([&](const Record&) { count++; return false; });
+		return count;
+	}
+
+	/**
+	 * @brief Concatenate per-page results in page order, moving the records
+	 * @param perPage - the records gathered from every page
+	 * @return all of the records in a single vector
+	*/
+	static vector<Record> mergePages(vector<vector<Record>>& perPage)
+	{
+		size_t total = 0;
+		for (const vector<Record>& records : perPage)
+			total += records.size();
+
+		vector<Record> answer;
+		answer.reserve(total);
+		for (vector<Record>& records : perPage)
+			for (Record& r : records)
+				answer.push_back(std::move(r));
+
+		return answer;
+	}
+
+	/**
+	 * @brief Opens the table's data file on first use. Copies of the table share the same open file
+	*/
+	TableSpace& getTableSpace()
+	{
+		if (!tableSpace)
+			tableSpace = std::make_shared<TableSpace>(getPagePath(0));
+
+		return *tableSpace;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,258 @@
+#pragma once
+#include<fstream>
+#include<sstream>
+#include<mutex>
+#include<string>
+#include "Page.hpp"
+
+using std::fstream;
+using std::string;
+using std::stringstream;
+using std::streamoff;
+using std::mutex;
+using std::lock_guard;
+
+#define DEFAULT_FRAME_SIZE 65536
+#define PREALLOCATED_FRAMES 16
+
+/**
+ * @brief Descriptor of a single-file page store. Instead of keeping every page of a table in its own
+ * file, all pages live in one data file made of fixed-size frames, so page number N is found at
+ * offset HEADER + N * frameSize and reading/writing it is a seek on an already open file.
+ *
+ * File layout: [frameSize][number of frames][frame 0][frame 1]...
+ * Frame layout: [number of used bytes][serialized page][unused space]
+ *
+ * Frames are preallocated in batches of PREALLOCATED_FRAMES. When a page outgrows its frame,
+ * the frame size is doubled and the frames are relocated once, so writes stay positioned afterwards.
+ *
+ * The frames can hold any bytes too (see readFrame and writeFrame), the nodes of a primary B+ tree are stored this way.
+ *
+ * All file accesses are serialized by a mutex. Reads only copy the frame's bytes while holding it,
+ * the page itself is parsed afterwards, so several threads can load pages at the same time.
+*/
+class TableSpace
+{
+public:
+	/**
+	 * @brief Opens the data file at the given path, creating it if it doesn't exist
+	 * @param path - path of the data file
+	 * @param frameSize - size in bytes of a single page frame, used only when the file is created
+	*/
+	TableSpace(const string& path, size_t frameSize = DEFAULT_FRAME_SIZE) : fPath(path), fFrameSize(frameSize), fFrames(0)
+	{
+		ifstream in(fPath, std::ios::binary);
+		if (in.is_open())
+		{
+			in.read((char*)&fFrameSize, sizeof(fFrameSize));
+			in.read((char*)&fFrames, sizeof(fFrames));
+			in.close();
+		}
+		else
+		{
+			ofstream out(fPath, std::ios::binary);
+			if (!out.is_open())
+				throw std::logic_error("Couldn't create tablespace file " + fPath);
+
+			out.close();
+			open();
+			writeHeader();
+		}
+	}
+
+	TableSpace(const TableSpace& other) = delete;
+	TableSpace& operator=(const TableSpace& other) = delete;
+
+	~TableSpace() { close(); }
+
+	/**
+	 * @brief Read the page stored in the given frame
+	 * @param index - number of the page
+	 * @return the page read from the frame
+	*/
+	Page readPage(int index)
+	{
+		stringstream buffer(readFrame(index));
+		return Page(buffer);
+	}
+
+	/**
+	 * @brief Write the page in the given frame, growing the file or the frames if needed
+	 * @param index - number of the page
+	 * @param page - page to be written
+	*/
+	void writePage(int index, const Page& page)
+	{
+		stringstream buffer;
+		page.write(buffer);
+		writeFrame(index, buffer.str());
+	}
+
+	/**
+	 * @brief Read the bytes stored in the given frame
+	 * @param index - number of the frame
+	 * @return the used bytes of the frame
+	*/
+	string readFrame(int index)
+	{
+		lock_guard<mutex> lock(fLock);
+		if (index < 0 || index >= fFrames)
+			throw std::out_of_range("Frame " + to_string(index) + " is not part of tablespace " + fPath);
+
+		open();
+		fFile.seekg(frameOffset(index));
+
+		size_t used = 0;
+		fFile.read((char*)&used, sizeof(used));
+		if (!fFile || used == 0 || used + sizeof(used) > fFrameSize)
+			throw std::logic_error("Frame " + to_string(index) + " in tablespace " + fPath + " is empty or corrupted");
+
+		string bytes(used, '\0');
+		fFile.read(&bytes[0], used);
+		return bytes;
+	}
+
+	/**
+	 * @brief Write bytes in the given frame, growing the file or the frames if needed
+	 * @param index - number of the frame
+	 * @param bytes - bytes to be written
+	*/
+	void writeFrame(int index, const string& bytes)
+	{
+		lock_guard<mutex> lock(fLock);
+		open();
+		if (bytes.size() + sizeof(size_t) > fFrameSize)
+			growFrames(bytes.size() + sizeof(size_t));
+
+		if (index >= fFrames)
+			reserveFrames(index + 1);
+
+		size_t used = bytes.size();
+		fFile.seekp(frameOffset(index));
+		fFile.write((char*)&used, sizeof(used));
+		fFile.write(bytes.data(), bytes.size());
+		fFile.flush();
+	}
+
+	/**
+	 * @brief Make sure the file has room for at least {frames} frames,
+	 * allocating them in batches of PREALLOCATED_FRAMES
+	 * @param frames - minimum number of frames
+	*/
+	void reserve(int frames)
+	{
+		lock_guard<mutex> lock(fLock);
+		reserveFrames(frames);
+	}
+
+	/**
+	 * @brief Wait until every written frame is on the disk
+	*/
+	void sync()
+	{
+		lock_guard<mutex> lock(fLock);
+		if (fFile.is_open())
+			fFile.flush();
+
+		fh::syncFile(fPath);
+	}
+
+	/**
+	 * @brief Releases the file handle, it is reopened on the next access
+	*/
+	void close()
+	{
+		lock_guard<mutex> lock(fLock);
+		if (fFile.is_open())
+			fFile.close();
+	}
+
+	size_t getFrameSize() const { return fFrameSize; }
+
+	int getFramesCount() const { return fFrames; }
+
+	const string& getPath() const { return fPath; }
+
+private:
+	string fPath;
+	size_t fFrameSize;
+	int fFrames;
+	fstream fFile;
+	mutex fLock;
+
+	static constexpr streamoff HEADER_SIZE = sizeof(size_t) + sizeof(int);
+
+	streamoff frameOffset(int index) const
+	{
+		return HEADER_SIZE + (streamoff)index * (streamoff)fFrameSize;
+	}
+
+	void open()
+	{
+		if (!fFile.is_open())
+		{
+			fFile.open(fPath, std::ios::binary | std::ios::in | std::ios::out);
+			if (!fFile.is_open())
+				throw std::logic_error("Couldn't open tablespace file " + fPath);
+		}
+
+		fFile.clear();
+	}
+
+	void reserveFrames(int frames)
+	{
+		if (frames <= fFrames)
+			return;
+
+		open();
+		fFrames = ((frames + PREALLOCATED_FRAMES - 1) / PREALLOCATED_FRAMES) * PREALLOCATED_FRAMES;
+
+		// Writing the last byte of the last frame extends the file up to it
+		char zero = 0;
+		fFile.seekp(frameOffset(fFrames) - 1);
+		fFile.write(&zero, sizeof(zero));
+		writeHeader();
+	}
+
+	void writeHeader()
+	{
+		fFile.seekp(0);
+		fFile.write((char*)&fFrameSize, sizeof(fFrameSize));
+		fFile.write((char*)&fFrames, sizeof(fFrames));
+		fFile.flush();
+	}
+
+	/**
+	 * @brief Double the frame size until {minSize} bytes fit in a frame and move every frame to its new offset.
+	 * Frames are moved from the last to the first, since new offsets are never smaller than the old ones
+	 * @param minSize - number of bytes that have to fit in a single frame
+	*/
+	void growFrames(size_t minSize)
+	{
+		size_t oldFrameSize = fFrameSize;
+		size_t newFrameSize = fFrameSize;
+		while (newFrameSize < minSize)
+			newFrameSize *= 2;
+
+		string frame(oldFrameSize, '\0');
+		for (int i = fFrames - 1; i >= 0; i--)
+		{
+			fFile.seekg(frameOffset(i));
+			fFile.read(&frame[0], oldFrameSize);
+
+			fFrameSize = newFrameSize;
+			fFile.seekp(frameOffset(i));
+			fFile.write(frame.data(), oldFrameSize);
+			fFrameSize = oldFrameSize;
+		}
+
+		fFrameSize = newFrameSize;
+		if (fFrames > 0)
+		{
+			char zero = 0;
+			fFile.seekp(frameOffset(fFrames) - 1);
+			fFile.write(&zero, sizeof(zero));
+		}
+		writeHeader();
+	}
+};
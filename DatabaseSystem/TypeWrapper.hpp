@@ -3,6 +3,7 @@
 #include "IntegerObject.hpp"
 #include "StringObject.hpp"
 #include "DoubleObject.hpp"
+#include "CompositeObject.hpp"
 
 using std::string;
 
@@ -12,7 +13,7 @@ public:
 	/// Object lifetime
 	TypeWrapper() :fContent(nullptr) {}
 
-	TypeWrapper(ifstream& in)
+	TypeWrapper(istream& in)
 	{
 		ObjectType t = ObjectType::INT;
 		in.read((char*)&t, sizeof(t));
@@ -33,6 +34,20 @@ public:
 			in.read((char*)&value, sizeof(value));
 			fContent = new DoubleObject(value);
 		}
+		else if (t == ObjectType::COMPOSITE)
+		{
+			size_t count = 0;
+			in.read((char*)&count, sizeof(count));
+
+			vector<Object*> parts;
+			for (size_t i = 0; i < count; i++)
+			{
+				TypeWrapper part(in);
+				parts.push_back(part.fContent);
+				part.fContent = nullptr;
+			}
+			fContent = new CompositeObject(parts);
+		}
 		else
 		{
 			fContent = nullptr;
@@ -45,6 +60,20 @@ public:
 
 	TypeWrapper(double content) :fContent(new DoubleObject(content)) {}
 
+	/**
+	 * @brief Composite key made of the given values, compared lexicographically
+	 * @param parts - values of the key's columns
+	*/
+	TypeWrapper(const vector<TypeWrapper>& parts)
+	{
+		vector<Object*> contents;
+		contents.reserve(parts.size());
+		for (const TypeWrapper& part : parts)
+			contents.push_back(part.fContent->clone());
+
+		fContent = new CompositeObject(contents);
+	}
+
 	/**
 	*	@brief Copy constructor
 	*
@@ -115,11 +144,24 @@ public:
 
 	string toString() const { return fContent->toString(); }
 
+	size_t hash() const { return fContent->hash(); }
+
+	/**
+	 * @param index - position of a column in a composite key
+	 * @return the value of that column
+	*/
+	TypeWrapper getPart(size_t index) const
+	{
+		TypeWrapper part;
+		part.fContent = static_cast<const CompositeObject*>(fContent)->getPart(index).clone();
+		return part;
+	}
+
 	/**
 	 * @brief Used for writing information of fContent to a file
 	 * @param out - output stream
 	*/
-	void write(ofstream& out) const
+	void write(ostream& out) const
 	{
 		fContent->write(out);
 	}
@@ -128,7 +170,7 @@ public:
 	bool operator==(const TypeWrapper& other) const { return fContent->operator==(*other.fContent); }
 	bool operator<(const TypeWrapper& other) const { return fContent->operator<(*other.fContent); }
 	bool operator<=(const TypeWrapper& other) const { return (fContent->operator<(*other.fContent) || fContent->operator==(*other.fContent)); }
-	bool operator>=(const TypeWrapper& other) const { return (fContent->operator<(*other.fContent) || fContent->operator==(*other.fContent)); }
+	bool operator>=(const TypeWrapper& other) const { return (fContent->operator>(*other.fContent) || fContent->operator==(*other.fContent)); }
 	bool operator!=(const TypeWrapper& other) const { return (fContent->operator<(*other.fContent) || fContent->operator>(*other.fContent)); }
 
 
@@ -0,0 +1,271 @@
+#pragma once
+#include<condition_variable>
+#include<functional>
+#include<mutex>
+#include<sstream>
+#include<string>
+#include "Record.hpp"
+#include "RecordPtr.hpp"
+#include "LogRecordType.h"
+#include "FileHelper.hpp"
+
+using std::string;
+using std::stringstream;
+using std::mutex;
+using std::unique_lock;
+using std::condition_variable;
+using fh = FileHelper;
+
+#define WAL_CHECKPOINT_BYTES (16 * 1024 * 1024)
+#define WAL_MAX_DIRTY_PAGES 256
+
+/**
+ * @brief Descriptor of the write-ahead log of a table. Every change of a record is appended to the log as a compact
+ * log record, and a statement is durable once its log records are on the disk - the changed pages and the indexes are
+ * written later by a checkpoint, after which the log is emptied. On startup the log records written after the last
+ * checkpoint are redone.
+ *
+ * Log record layout: [payload size][LSN][checksum][payload]
+ * Payload layout: [type][record pointer][record before the change, REMOVE and UPDATE][record after the change, INSERT and UPDATE]
+ *
+ * Appending only copies the log record to a buffer. Commits use group commit: the first committer writes the whole buffer
+ * and forces it to the disk with a single sync, committers arriving meanwhile wait for it and are done if it covered
+ * their log records. A torn log record at the end of the log (i.e. after a crash in the middle of a write) fails its checksum
+ * and ends the redo. A failed write may have left such a torn log record, so after it every commit fails until a checkpoint
+ * empties the log.
+*/
+class WriteAheadLog
+{
+public:
+	/**
+	 * @brief Opens the log file at the given path, creating it if it doesn't exist
+	 * @param path - path of the log file
+	*/
+	WriteAheadLog(const string& path) : fPath(path), fFile(nullptr), fLastLsn(0), fDurableLsn(0), fFileBytes(0), fIsFlushing(false), fHasFailed(false)
+	{
+		open("ab");
+		fseek(fFile, 0, SEEK_END);
+		fFileBytes = (size_t)ftell(fFile);
+	}
+
+	WriteAheadLog(const WriteAheadLog& other) = delete;
+	WriteAheadLog& operator=(const WriteAheadLog& other) = delete;
+
+	~WriteAheadLog() { close(); }
+
+	/**
+	 * @brief Append a log record to the buffer, it isn't durable until committed
+	 * @param type - the change
+	 * @param ptr - position of the changed record
+	 * @param before - the record before the change, nullptr for INSERT
+	 * @param after - the record after the change, nullptr for REMOVE
+	 * @return the LSN of the log record
+	*/
+	unsigned long long append(LogRecordType type, const RecordPtr& ptr, const Record* before, const Record* after)
+	{
+		stringstream payload;
+		payload.write((char*)&type, sizeof(type));
+		ptr.write(payload);
+		if (before)
+			before->write(payload);
+		if (after)
+			after->write(payload);
+
+		string bytes = payload.str();
+		size_t size = bytes.size();
+
+		unique_lock<mutex> lock(fLock);
+		unsigned long long lsn = ++fLastLsn;
+		unsigned int checksum = getChecksum(lsn, bytes);
+		fBuffer.append((char*)&size, sizeof(size));
+		fBuffer.append((char*)&lsn, sizeof(lsn));
+		fBuffer.append((char*)&checksum, sizeof(checksum));
+		fBuffer += bytes;
+		return lsn;
+	}
+
+	/**
+	 * @brief Make every log record appended so far durable (group commit)
+	 * @throw logic_error if the log couldn't be written, now or by an earlier commit
+	*/
+	void commit()
+	{
+		unique_lock<mutex> lock(fLock);
+		unsigned long long lsn = fLastLsn;
+		while (fDurableLsn < lsn)
+		{
+			if (fHasFailed)
+				throw std::logic_error("Couldn't write the log " + fPath + " to the disk");
+
+			// Somebody else is writing, its sync may cover our log records too
+			if (fIsFlushing)
+			{
+				fFlushed.wait(lock);
+				continue;
+			}
+
+			string buffer;
+			buffer.swap(fBuffer);
+			unsigned long long target = fLastLsn;
+			fIsFlushing = true;
+			lock.unlock();
+
+			bool written = fwrite(buffer.data(), 1, buffer.size(), fFile) == buffer.size() && fh::syncFile(fFile);
+
+			lock.lock();
+			fIsFlushing = false;
+			fFlushed.notify_all();
+			if (!written)
+			{
+				// The log records stay buffered, a checkpoint writes their changes to the table and empties the log
+				fBuffer.insert(0, buffer);
+				fHasFailed = true;
+				throw std::logic_error("Couldn't write the log " + fPath + " to the disk");
+			}
+
+			fFileBytes += buffer.size();
+			fDurableLsn = target;
+		}
+	}
+
+	/**
+	 * @brief Redo: read the log records of the file in order
+	 * @param after - LSN of the last change already part of the table, older log records are skipped
+	 * @param redo - called with every newer log record: its type, the pointer and the records before and after the change
+	 * @return the LSN of the last valid log record, {after} if there is none
+	*/
+	unsigned long long replay(unsigned long long after, const std::function<void(LogRecordType, const RecordPtr&, const Record&, const Record&)>& redo)
+	{
+		unique_lock<mutex> lock(fLock);
+		ifstream in(fPath, std::ios::binary);
+		unsigned long long last = after;
+		size_t size = 0;
+		unsigned long long lsn = 0;
+		unsigned int checksum = 0;
+		while (in.read((char*)&size, sizeof(size)) && in.read((char*)&lsn, sizeof(lsn)) && in.read((char*)&checksum, sizeof(checksum)))
+		{
+			if (size > fFileBytes)
+				break;
+
+			string bytes(size, '\0');
+			if (!in.read(&bytes[0], size) || getChecksum(lsn, bytes) != checksum)
+				break;
+
+			if (lsn <= last)
+				continue;
+
+			stringstream payload(bytes);
+			LogRecordType type;
+			payload.read((char*)&type, sizeof(type));
+			RecordPtr ptr(payload);
+			Record before = type == LogRecordType::INSERT ? Record() : Record(payload);
+			Record changed = type == LogRecordType::REMOVE ? Record() : Record(payload);
+			redo(type, ptr, before, changed);
+			last = lsn;
+		}
+
+		fLastLsn = fDurableLsn = last;
+		return last;
+	}
+
+	/**
+	 * @brief Empty the log, after a checkpoint has written every change it holds to the table's files
+	*/
+	void truncate()
+	{
+		unique_lock<mutex> lock(fLock);
+		fBuffer.clear();
+		fclose(fFile);
+		open("wb");
+		fh::syncFile(fFile);
+		fFileBytes = 0;
+		fDurableLsn = fLastLsn;
+		fHasFailed = false;
+	}
+
+	/**
+	 * @brief Set the LSN the next log record follows, i.e. the LSN of the last checkpoint of an empty log
+	*/
+	void setLastLsn(unsigned long long lsn)
+	{
+		unique_lock<mutex> lock(fLock);
+		fLastLsn = fDurableLsn = lsn;
+	}
+
+	/**
+	 * @return True if a write of the log failed since it was last emptied
+	*/
+	bool hasFailed()
+	{
+		unique_lock<mutex> lock(fLock);
+		return fHasFailed;
+	}
+
+	unsigned long long getLastLsn()
+	{
+		unique_lock<mutex> lock(fLock);
+		return fLastLsn;
+	}
+
+	/**
+	 * @return the size of the log in bytes, written and buffered
+	*/
+	size_t size()
+	{
+		unique_lock<mutex> lock(fLock);
+		return fFileBytes + fBuffer.size();
+	}
+
+	/**
+	 * @brief Releases the file handle, the log can't be used afterwards
+	*/
+	void close()
+	{
+		unique_lock<mutex> lock(fLock);
+		if (fFile)
+		{
+			fclose(fFile);
+			fFile = nullptr;
+		}
+	}
+
+	const string& getPath() const { return fPath; }
+
+private:
+	string fPath;
+	FILE* fFile;
+	string fBuffer;
+	unsigned long long fLastLsn, fDurableLsn;
+	size_t fFileBytes;
+	bool fIsFlushing;
+	bool fHasFailed; // a write failed, nothing is durable until the log is emptied
+	mutex fLock;
+	condition_variable fFlushed;
+
+	void open(const char* mode)
+	{
+		fFile = fh::openFile(fPath, mode);
+		if (fFile == nullptr)
+			throw std::logic_error("Couldn't open log file " + fPath);
+	}
+
+	/**
+	 * @brief FNV-1a hash of the LSN and the payload of a log record
+	*/
+	static unsigned int getChecksum(unsigned long long lsn, const string& bytes)
+	{
+		unsigned int hash = 2166136261u;
+		auto mix = [&](const char* data, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= (unsigned char)data[i];
+				hash *= 16777619u;
+			}
+		};
+
+		mix((const char*)&lsn, sizeof(lsn));
+		mix(bytes.data(), bytes.size());
+		return hash;
+	}
+};